@@ -31,8 +31,13 @@
 
 #include "enc28j60.h"
 
+#include <string.h>
+
 #define EXIT_IF_ERR(s) if((s) != ENC28_OK) { return (s); }
 
+/* Size of the next packet pointer and the receive status vector preceding each packet */
+#define ENC28_RSV_SIZE (6)
+
 /*
  * Datasheet for ENC28J60, page 12: " (...) The register at address 1Ah in
  * each bank is reserved; read and write operations
@@ -40,17 +45,14 @@
 * */
 #define CHECK_RESERVED_REG(reg_id) if ((reg_id) == 0x1A) { return ENC28_INVALID_REGISTER; }
 
-//TODO refactor : keep bank ID together with register name
-static uint8_t priv_enc28_curr_bank = 0;
-
 static uint8_t priv_enc28_is_phy_reg(uint8_t reg_id)
 {
 	return (reg_id <= 0x03) || (reg_id >= 0x10 && reg_id <= 0x14);
 }
 
-static uint8_t priv_enc28_is_mac_or_mii_reg(uint8_t reg_id)
+static uint8_t priv_enc28_is_mac_or_mii_reg(const ENC28_Device *dev, uint8_t reg_id)
 {
-	if (priv_enc28_curr_bank == 2)
+	if (dev->curr_bank == 2)
 	{
 		return (reg_id == ENC28_CR_MACON1) ||
 				(reg_id == ENC28_CR_MACON3) ||
@@ -69,7 +71,7 @@ static uint8_t priv_enc28_is_mac_or_mii_reg(uint8_t reg_id)
 				(reg_id == ENC28_CR_MIRDL) ||
 				(reg_id == ENC28_CR_MIRDH);
 	}
-	else if (priv_enc28_curr_bank == 3)
+	else if (dev->curr_bank == 3)
 	{
 		return (reg_id == ENC28_CR_MISTAT) ||
 				(reg_id == ENC28_CR_MAC_ADD1) ||
@@ -85,45 +87,45 @@ static uint8_t priv_enc28_is_mac_or_mii_reg(uint8_t reg_id)
 	}
 }
 
-static ENC28_CommandStatus priv_enc28_do_buffer_register_init(ENC28_SPI_Context *ctx)
+static ENC28_CommandStatus priv_enc28_do_buffer_register_init(ENC28_Device *dev)
 {
-	uint8_t addr_lo = ENC28_CONF_RX_ADDRESS_START & 0xFF;
-	uint8_t addr_hi = (ENC28_CONF_RX_ADDRESS_START >> 8) & 0x1F;
+	uint8_t addr_lo = dev->layout.rx_start & 0xFF;
+	uint8_t addr_hi = (dev->layout.rx_start >> 8) & 0x1F;
 
-	ENC28_CommandStatus status = enc28_select_register_bank(ctx, 0);
+	ENC28_CommandStatus status = enc28_select_register_bank(dev, 0);
 
-	status = enc28_do_write_ctl_reg(ctx, ENC28_CR_ERXSTL, addr_lo);
+	status = enc28_do_write_ctl_reg(dev, ENC28_CR_ERXSTL, addr_lo);
 	EXIT_IF_ERR(status);
-	status = enc28_do_write_ctl_reg(ctx, ENC28_CR_ERXSTH, addr_hi);
+	status = enc28_do_write_ctl_reg(dev, ENC28_CR_ERXSTH, addr_hi);
 	EXIT_IF_ERR(status);
 
-	addr_lo = ENC28_CONF_RX_ADDRESS_END & 0xFF;
-	addr_hi = (ENC28_CONF_RX_ADDRESS_END >> 8) & 0x1F;
-	status = enc28_do_write_ctl_reg(ctx, ENC28_CR_ERXNDL, addr_lo);
+	addr_lo = dev->layout.rx_end & 0xFF;
+	addr_hi = (dev->layout.rx_end >> 8) & 0x1F;
+	status = enc28_do_write_ctl_reg(dev, ENC28_CR_ERXNDL, addr_lo);
 	EXIT_IF_ERR(status);
-	status = enc28_do_write_ctl_reg(ctx, ENC28_CR_ERXNDH, addr_hi);
+	status = enc28_do_write_ctl_reg(dev, ENC28_CR_ERXNDH, addr_hi);
 	EXIT_IF_ERR(status);
 
-	status = enc28_do_write_ctl_reg(ctx, ENC28_CR_ERXRDPTL, addr_lo);
+	status = enc28_do_write_ctl_reg(dev, ENC28_CR_ERXRDPTL, addr_lo);
 	EXIT_IF_ERR(status);
-	status = enc28_do_write_ctl_reg(ctx, ENC28_CR_ERXRDPTH, addr_hi);
+	status = enc28_do_write_ctl_reg(dev, ENC28_CR_ERXRDPTH, addr_hi);
 	EXIT_IF_ERR(status);
 
 	return ENC28_OK;
 }
 
-static ENC28_CommandStatus priv_enc28_do_receive_filter_init(ENC28_SPI_Context *ctx)
+static ENC28_CommandStatus priv_enc28_do_receive_filter_init(ENC28_Device *dev)
 {
-	ENC28_CommandStatus status = enc28_select_register_bank(ctx, 1);
+	ENC28_CommandStatus status = enc28_select_register_bank(dev, 1);
 	EXIT_IF_ERR(status);
 
-	return enc28_do_write_ctl_reg(ctx, ENC28_CR_ERXFCON, ENC28_CONF_PACKET_FILTER_MASK);
+	return enc28_do_write_ctl_reg(dev, ENC28_CR_ERXFCON, ENC28_CONF_PACKET_FILTER_MASK);
 }
 
-static ENC28_CommandStatus priv_enc28_do_poll_estat_clk(ENC28_SPI_Context *ctx)
+static ENC28_CommandStatus priv_enc28_do_poll_estat_clk(ENC28_Device *dev)
 {
 	uint8_t reg_value = 0;
-	ENC28_CommandStatus status = enc28_do_read_ctl_reg(ctx, ENC28_CR_ESTAT, &reg_value);
+	ENC28_CommandStatus status = enc28_do_read_ctl_reg(dev, ENC28_CR_ESTAT, &reg_value);
 
 	while (status == ENC28_OK)
 	{
@@ -131,16 +133,55 @@ static ENC28_CommandStatus priv_enc28_do_poll_estat_clk(ENC28_SPI_Context *ctx)
 		{
 			break;
 		}
-		status = enc28_do_read_ctl_reg(ctx, ENC28_CR_ESTAT, &reg_value);
+		status = enc28_do_read_ctl_reg(dev, ENC28_CR_ESTAT, &reg_value);
+	}
+
+	return ENC28_OK;
+}
+
+static ENC28_CommandStatus priv_enc28_apply_duplex(ENC28_Device *dev, uint8_t full_duplex)
+{
+	ENC28_CommandStatus status = enc28_select_register_bank(dev, 2);
+	EXIT_IF_ERR(status);
+
+	{
+		uint8_t macon3_value = 0;
+		status = enc28_do_read_ctl_reg(dev, ENC28_CR_MACON3, &macon3_value);
+		EXIT_IF_ERR(status);
+		if (full_duplex)
+		{
+			macon3_value |= (1 << ENC28_MACON3_FULLDPX);
+		}
+		else
+		{
+			macon3_value &= ~(1 << ENC28_MACON3_FULLDPX);
+		}
+		status = enc28_do_write_ctl_reg(dev, ENC28_CR_MACON3, macon3_value);
+		EXIT_IF_ERR(status);
+	}
+
+	{
+		status = enc28_do_write_ctl_reg(dev,
+				ENC28_CR_MAIPGL,
+				full_duplex ? ENC28_CONF_MAIPGL_BITS_FULLDUP : ENC28_CONF_MAIPGL_BITS_HALFDUP);
+		EXIT_IF_ERR(status);
+
+		if (!full_duplex)
+		{
+			status = enc28_do_write_ctl_reg(dev, ENC28_CR_MAIPGH, ENC28_CONF_MAIPGH_BITS);
+			EXIT_IF_ERR(status);
+		}
 	}
 
+	dev->full_duplex = full_duplex;
+
 	return ENC28_OK;
 }
 
-static ENC28_CommandStatus priv_enc28_do_mac_init(const ENC28_MAC_Address mac_add, ENC28_SPI_Context *ctx)
+static ENC28_CommandStatus priv_enc28_do_mac_init(const ENC28_MAC_Address mac_add, ENC28_Device *dev)
 {
 	uint8_t is_full_duplex = 0;
-	ENC28_CommandStatus status = enc28_select_register_bank(ctx, 2); //TODO do not hardcode 2
+	ENC28_CommandStatus status = enc28_select_register_bank(dev, 2); //TODO do not hardcode 2
 	EXIT_IF_ERR(status);
 
 	{
@@ -148,139 +189,314 @@ static ENC28_CommandStatus priv_enc28_do_mac_init(const ENC28_MAC_Address mac_ad
 								| (1 << ENC28_MACON1_RXPAUS)
 								| (1 << ENC28_MACON1_TXPAUS);
 
-		status = enc28_do_set_bits_ctl_reg(ctx, ENC28_CR_MACON1, macon1_mask);
+		status = enc28_do_set_bits_ctl_reg(dev, ENC28_CR_MACON1, macon1_mask);
 		EXIT_IF_ERR(status);
 	}
 
 	{
 		uint16_t phcon1_value = 0;
-		status = enc28_do_read_phy_register(ctx, ENC28_PHYR_PHCON1, &phcon1_value);
+		status = enc28_do_read_phy_register(dev, ENC28_PHYR_PHCON1, &phcon1_value);
 		EXIT_IF_ERR(status);
 		is_full_duplex = (phcon1_value & (1 << ENC28_PHCON1_PDPXMD)) != 0;
 	}
 
 	{
-		uint8_t macon3_mask = ENC28_CONF_MACON3_FRAME_PAD_MASK |
+		const uint8_t macon3_mask = ENC28_CONF_MACON3_FRAME_PAD_MASK |
 					(1 << ENC28_MACON3_TXCRCEN) |
 					(1 << ENC28_MACON3_FRMLNEN);
-		if (is_full_duplex)
-		{
-			macon3_mask |= (1 << ENC28_MACON3_FULLDPX);
-		}
-		status = enc28_do_set_bits_ctl_reg(ctx, ENC28_CR_MACON3, macon3_mask);
+		status = enc28_do_set_bits_ctl_reg(dev, ENC28_CR_MACON3, macon3_mask);
 		EXIT_IF_ERR(status);
 	}
 
 	{
 		const uint8_t macon4_mask = (1 << ENC28_MACON4_DEFER);
-		status = enc28_do_set_bits_ctl_reg(ctx, ENC28_CR_MACON4, macon4_mask);
+		status = enc28_do_set_bits_ctl_reg(dev, ENC28_CR_MACON4, macon4_mask);
 		EXIT_IF_ERR(status);
 	}
 
 	{
 		const uint8_t max_fr_len_lo = ENC28_CONF_MAX_FRAME_LEN & 0xFF;
 		const uint8_t max_fr_len_hi = (ENC28_CONF_MAX_FRAME_LEN >> 8) & 0xFF;
-		status = enc28_do_write_ctl_reg(ctx, ENC28_CR_MAMXFLL, max_fr_len_lo);
+		status = enc28_do_write_ctl_reg(dev, ENC28_CR_MAMXFLL, max_fr_len_lo);
 		EXIT_IF_ERR(status);
-		status = enc28_do_write_ctl_reg(ctx, ENC28_CR_MAMXFLH, max_fr_len_hi);
+		status = enc28_do_write_ctl_reg(dev, ENC28_CR_MAMXFLH, max_fr_len_hi);
 		EXIT_IF_ERR(status);
 	}
 
 	{
-		status = enc28_do_write_ctl_reg(ctx, ENC28_CR_MABBIPG, ENC28_CONF_MABBIPG_BITS);
+		status = enc28_do_write_ctl_reg(dev, ENC28_CR_MABBIPG, ENC28_CONF_MABBIPG_BITS);
 		EXIT_IF_ERR(status);
 	}
 
 	{
-		status = enc28_do_write_ctl_reg(ctx,
-				ENC28_CR_MAIPGL,
-				is_full_duplex ? ENC28_CONF_MAIPGL_BITS_FULLDUP : ENC28_CONF_MAIPGL_BITS_HALFDUP);
+		status = priv_enc28_apply_duplex(dev, is_full_duplex);
 		EXIT_IF_ERR(status);
-
-		if (!is_full_duplex)
-		{
-			status = enc28_do_write_ctl_reg(ctx, ENC28_CR_MAIPGH, ENC28_CONF_MAIPGH_BITS);
-			EXIT_IF_ERR(status);
-		}
 	}
 
 	{
-		status = enc28_select_register_bank(ctx, 3);
+		status = enc28_select_register_bank(dev, 3);
 		EXIT_IF_ERR(status);
-		status = enc28_do_write_ctl_reg(ctx, ENC28_CR_MAC_ADD1, mac_add.addr[0]);
+		status = enc28_do_write_ctl_reg(dev, ENC28_CR_MAC_ADD1, mac_add.addr[0]);
 		EXIT_IF_ERR(status);
-		status = enc28_do_write_ctl_reg(ctx, ENC28_CR_MAC_ADD2, mac_add.addr[1]);
+		status = enc28_do_write_ctl_reg(dev, ENC28_CR_MAC_ADD2, mac_add.addr[1]);
 		EXIT_IF_ERR(status);
-		status = enc28_do_write_ctl_reg(ctx, ENC28_CR_MAC_ADD3, mac_add.addr[2]);
+		status = enc28_do_write_ctl_reg(dev, ENC28_CR_MAC_ADD3, mac_add.addr[2]);
 		EXIT_IF_ERR(status);
-		status = enc28_do_write_ctl_reg(ctx, ENC28_CR_MAC_ADD4, mac_add.addr[3]);
+		status = enc28_do_write_ctl_reg(dev, ENC28_CR_MAC_ADD4, mac_add.addr[3]);
 		EXIT_IF_ERR(status);
-		status = enc28_do_write_ctl_reg(ctx, ENC28_CR_MAC_ADD5, mac_add.addr[4]);
+		status = enc28_do_write_ctl_reg(dev, ENC28_CR_MAC_ADD5, mac_add.addr[4]);
 		EXIT_IF_ERR(status);
-		status = enc28_do_write_ctl_reg(ctx, ENC28_CR_MAC_ADD6, mac_add.addr[5]);
+		status = enc28_do_write_ctl_reg(dev, ENC28_CR_MAC_ADD6, mac_add.addr[5]);
+		EXIT_IF_ERR(status);
+	}
+
+	{
+		status = enc28_select_register_bank(dev, 0);
 		EXIT_IF_ERR(status);
 	}
 
+	return ENC28_OK;
+}
+
+static ENC28_CommandStatus priv_enc28_do_phy_init(ENC28_Device *dev)
+{
+	// link changes are reported through EIR.LINKIF, EIE.LINKIE is set by enc28_begin_packet_transfer
+	const uint16_t phie_mask = (1 << ENC28_PHIE_PGEIE) | (1 << ENC28_PHIE_PLNKIE);
+	ENC28_CommandStatus status = enc28_do_write_phy_register(dev, ENC28_PHYR_PHIE, phie_mask);
+	EXIT_IF_ERR(status);
+
 	{
-		status = enc28_select_register_bank(ctx, 0);
+		// drop the link change latched before the interrupt was enabled
+		uint16_t phir_value = 0;
+		status = enc28_do_read_phy_register(dev, ENC28_PHYR_PHIR, &phir_value);
 		EXIT_IF_ERR(status);
 	}
 
+	return enc28_select_register_bank(dev, 0);
+}
+
+static void priv_enc28_spi_out(ENC28_Device *dev, const uint8_t *buff, size_t len)
+{
+	dev->stats.spi_bytes += len;
+	dev->spi.spi_out_op(buff, len);
+}
+
+static void priv_enc28_spi_in(ENC28_Device *dev, uint8_t *buff, size_t len)
+{
+	dev->stats.spi_bytes += len;
+	dev->spi.spi_in_op(buff, len);
+}
+
+static void priv_enc28_spi_in_out(ENC28_Device *dev, const uint8_t *tx, uint8_t *rx, size_t len)
+{
+	dev->stats.spi_bytes += len;
+	dev->spi.spi_in_out_op(tx, rx, len);
+}
+
+static void priv_enc28_buffer_out(ENC28_Device *dev, const uint8_t *buff, size_t len)
+{
+	dev->stats.spi_bytes += len;
+	if (dev->spi.spi_out_async_op && (len >= ENC28_CONF_SPI_ASYNC_MIN_LEN))
+	{
+		dev->spi.spi_out_async_op(buff, len);
+		dev->spi.spi_async_wait_op();
+	}
+	else
+	{
+		dev->spi.spi_out_op(buff, len);
+	}
+}
+
+static void priv_enc28_buffer_in(ENC28_Device *dev, uint8_t *buff, size_t len)
+{
+	dev->stats.spi_bytes += len;
+	if (dev->spi.spi_in_async_op && (len >= ENC28_CONF_SPI_ASYNC_MIN_LEN))
+	{
+		dev->spi.spi_in_async_op(buff, len);
+		dev->spi.spi_async_wait_op();
+	}
+	else
+	{
+		dev->spi.spi_in_op(buff, len);
+	}
+}
+
+ENC28_CommandStatus enc28_init_device(ENC28_Device *dev, const ENC28_SPI_Context *ctx)
+{
+	if ((!dev) || (!ctx))
+	{
+		return ENC28_INVALID_PARAM;
+	}
+
+	if ((ctx->spi_out_async_op || ctx->spi_in_async_op) && (!ctx->spi_async_wait_op))
+	{
+		return ENC28_INVALID_PARAM;
+	}
+
+	memset(dev, 0, sizeof(*dev));
+	dev->spi = *ctx;
+	enc28_default_buffer_layout(&dev->layout);
+
 	return ENC28_OK;
 }
 
-static ENC28_CommandStatus priv_enc28_do_phy_init(ENC28_SPI_Context *ctx)
+void enc28_default_buffer_layout(ENC28_Buffer_Layout *layout)
+{
+	if (layout)
+	{
+		layout->rx_start = ENC28_CONF_RX_ADDRESS_START;
+		layout->rx_end = ENC28_CONF_RX_ADDRESS_END;
+		layout->tx_start = ENC28_CONF_TX_ADDRESS_START;
+		layout->tx_slot_count = ENC28_CONF_TX_SLOT_COUNT;
+	}
+}
+
+ENC28_CommandStatus enc28_make_buffer_layout(ENC28_Buffer_Layout *layout, uint8_t tx_slot_count)
+{
+	if ((!layout) || (tx_slot_count == 0) || (tx_slot_count > ENC28_CONF_TX_MAX_SLOTS))
+	{
+		return ENC28_INVALID_PARAM;
+	}
+
+	layout->tx_slot_count = tx_slot_count;
+	layout->tx_start = ENC28_BUFFER_SIZE - tx_slot_count * ENC28_TX_SLOT_SIZE;
+	layout->rx_start = 0;
+	// the ring ends at an odd address, so the ERXRDPT wraparound value stays odd
+	layout->rx_end = (layout->tx_start - 1) | 0x1;
+	if (layout->rx_end >= layout->tx_start)
+	{
+		layout->rx_end -= 2;
+	}
+
+	return enc28_check_buffer_layout(layout);
+}
+
+ENC28_CommandStatus enc28_check_buffer_layout(const ENC28_Buffer_Layout *layout)
 {
+	if (!layout)
+	{
+		return ENC28_INVALID_PARAM;
+	}
+
+	const uint32_t rx_start = layout->rx_start;
+	const uint32_t rx_end = layout->rx_end;
+	const uint32_t tx_start = layout->tx_start;
+	const uint32_t tx_end = tx_start + (uint32_t)layout->tx_slot_count * ENC28_TX_SLOT_SIZE;
+
+	if ((layout->tx_slot_count == 0) || (layout->tx_slot_count > ENC28_CONF_TX_MAX_SLOTS) || (tx_end > ENC28_BUFFER_SIZE))
+	{
+		return ENC28_INVALID_PARAM;
+	}
+
+	// errata: writing ERXST/ERXND can reset the internal write pointer to 0 instead of ERXST, so the ring starts there
+	// packets start at even addresses, ERXRDPT must be odd (errata)
+	if ((rx_start != 0) || !(rx_end & 0x1) || (rx_end >= ENC28_BUFFER_SIZE) || (rx_end <= rx_start))
+	{
+		return ENC28_INVALID_PARAM;
+	}
+
+	// the largest frame has to fit in the ring
+	if ((rx_end - rx_start + 1) <= (ENC28_RSV_SIZE + ENC28_CONF_MAX_FRAME_LEN))
+	{
+		return ENC28_INVALID_PARAM;
+	}
+
+	if ((rx_start < tx_end) && (tx_start <= rx_end))
+	{
+		return ENC28_INVALID_PARAM;
+	}
+
 	return ENC28_OK;
 }
 
-ENC28_CommandStatus enc28_do_init(const ENC28_MAC_Address mac_add, ENC28_SPI_Context *ctx)
+uint16_t enc28_rx_capacity_frames(const ENC28_Buffer_Layout *layout, uint16_t frame_len)
+{
+	if ((!layout) || (layout->rx_end <= layout->rx_start))
+	{
+		return 0;
+	}
+
+	// status vector, frame with the CRC, padding to the even address of the next packet
+	const uint32_t packet_size = ((uint32_t)ENC28_RSV_SIZE + frame_len + 4 + 1) & ~0x1u;
+	// the write pointer cannot catch up with ERXRDPT, one byte of the ring stays unused
+	const uint32_t ring_size = layout->rx_end - layout->rx_start;
+	return (uint16_t)(ring_size / packet_size);
+}
+
+ENC28_CommandStatus enc28_do_init(const ENC28_MAC_Address mac_add, const ENC28_Buffer_Layout *layout, ENC28_Device *dev)
 {
+	if (!dev)
+	{
+		return ENC28_INVALID_PARAM;
+	}
+
+	if (layout)
+	{
+		ENC28_CommandStatus status = enc28_check_buffer_layout(layout);
+		EXIT_IF_ERR(status);
+		dev->layout = *layout;
+	}
+	else
+	{
+		enc28_default_buffer_layout(&dev->layout);
+	}
+	dev->tx_head = 0;
+	dev->tx_count = 0;
+	dev->tx_retry_count = 0;
+	dev->link_up = 0;
+
 	// program the ERXST and ERXND pointers
 	// program the ERXRDPT register
-	ENC28_CommandStatus status = priv_enc28_do_buffer_register_init(ctx);
+	ENC28_CommandStatus status = priv_enc28_do_buffer_register_init(dev);
 	EXIT_IF_ERR(status);
 
 	// program the "receive filters" in ERXFCON
-	status = priv_enc28_do_receive_filter_init(ctx);
+	status = priv_enc28_do_receive_filter_init(dev);
 	EXIT_IF_ERR(status);
 
 	// poll ESTAT.CLKRDY before initialising MAC address
-	status = priv_enc28_do_poll_estat_clk(ctx);
+	status = priv_enc28_do_poll_estat_clk(dev);
 	EXIT_IF_ERR(status);
 
 	// MAC initialization
-	status = priv_enc28_do_mac_init(mac_add, ctx);
+	status = priv_enc28_do_mac_init(mac_add, dev);
 	EXIT_IF_ERR(status);
 
 	// PHY initialization
-	status = priv_enc28_do_phy_init(ctx);
+	status = priv_enc28_do_phy_init(dev);
 
 	return status;
 }
 
-ENC28_CommandStatus enc28_do_soft_reset(ENC28_SPI_Context *ctx)
+ENC28_CommandStatus enc28_do_soft_reset(ENC28_Device *dev)
 {
-	if (!ctx)
+	if (!dev)
 	{
 		return ENC28_INVALID_PARAM;
 	}
 
-	if ((!ctx->nss_pin_op) || (!ctx->spi_in_op) || (!ctx->spi_out_op))
+	if ((!dev->spi.nss_pin_op) || (!dev->spi.spi_in_op) || (!dev->spi.spi_out_op))
 	{
 		return ENC28_INVALID_PARAM;
 	}
 
 	uint8_t cmd_buff = 0xFF;
 
-	ctx->nss_pin_op(0);
-	ctx->spi_out_op(&cmd_buff, 1);
-	ctx->nss_pin_op(1);
+	dev->spi.nss_pin_op(0);
+	priv_enc28_spi_out(dev, &cmd_buff, 1);
+	dev->spi.nss_pin_op(1);
+
+	// the reset clears ECON1, so bank 0 is selected again
+	dev->curr_bank = 0;
+	// frames waiting in the transmit buffer are lost
+	dev->tx_head = 0;
+	dev->tx_count = 0;
+	dev->tx_retry_count = 0;
 
 	return ENC28_OK;
 }
 
-ENC28_CommandStatus enc28_do_read_hw_rev(ENC28_SPI_Context *ctx, ENC28_HW_Rev *hw_rev)
+ENC28_CommandStatus enc28_do_read_hw_rev(ENC28_Device *dev, ENC28_HW_Rev *hw_rev)
 {
 	if (!hw_rev)
 	{
@@ -288,40 +504,40 @@ ENC28_CommandStatus enc28_do_read_hw_rev(ENC28_SPI_Context *ctx, ENC28_HW_Rev *h
 	}
 
 	ENC28_CommandStatus status = enc28_do_read_phy_register(
-			ctx,
+			dev,
 			ENC28_PHYR_PHID1,
 			&hw_rev->phid1);
 	EXIT_IF_ERR(status);
 
 	status = enc28_do_read_phy_register(
-			ctx,
+			dev,
 			ENC28_PHYR_PHID2,
 			&hw_rev->phid2);
 	EXIT_IF_ERR(status);
 
-	status = enc28_select_register_bank(ctx, 3);
+	status = enc28_select_register_bank(dev, 3);
 	EXIT_IF_ERR(status);
 
-	status = enc28_do_read_ctl_reg(ctx, ENC28_CR_EREVID, &hw_rev->ethrev);
+	status = enc28_do_read_ctl_reg(dev, ENC28_CR_EREVID, &hw_rev->ethrev);
 
 	return status;
 }
 
-ENC28_CommandStatus enc28_do_read_mac(ENC28_SPI_Context *ctx, ENC28_MAC_Address *mac)
+ENC28_CommandStatus enc28_do_read_mac(ENC28_Device *dev, ENC28_MAC_Address *mac)
 {
-	ENC28_CommandStatus status = enc28_select_register_bank(ctx, 3);
+	ENC28_CommandStatus status = enc28_select_register_bank(dev, 3);
 	EXIT_IF_ERR(status);
-	status = enc28_do_read_ctl_reg(ctx, ENC28_CR_MAC_ADD1, &mac->addr[0]);
+	status = enc28_do_read_ctl_reg(dev, ENC28_CR_MAC_ADD1, &mac->addr[0]);
 	EXIT_IF_ERR(status);
-	status = enc28_do_read_ctl_reg(ctx, ENC28_CR_MAC_ADD2, &mac->addr[1]);
+	status = enc28_do_read_ctl_reg(dev, ENC28_CR_MAC_ADD2, &mac->addr[1]);
 	EXIT_IF_ERR(status);
-	status = enc28_do_read_ctl_reg(ctx, ENC28_CR_MAC_ADD3, &mac->addr[2]);
+	status = enc28_do_read_ctl_reg(dev, ENC28_CR_MAC_ADD3, &mac->addr[2]);
 	EXIT_IF_ERR(status);
-	status = enc28_do_read_ctl_reg(ctx, ENC28_CR_MAC_ADD4, &mac->addr[3]);
+	status = enc28_do_read_ctl_reg(dev, ENC28_CR_MAC_ADD4, &mac->addr[3]);
 	EXIT_IF_ERR(status);
-	status = enc28_do_read_ctl_reg(ctx, ENC28_CR_MAC_ADD5, &mac->addr[4]);
+	status = enc28_do_read_ctl_reg(dev, ENC28_CR_MAC_ADD5, &mac->addr[4]);
 	EXIT_IF_ERR(status);
-	status = enc28_do_read_ctl_reg(ctx, ENC28_CR_MAC_ADD6, &mac->addr[5]);
+	status = enc28_do_read_ctl_reg(dev, ENC28_CR_MAC_ADD6, &mac->addr[5]);
 
 	return status;
 }
@@ -340,14 +556,14 @@ ENC28_CommandStatus enc28_prepare_read_ctl_reg(uint8_t *out, uint8_t reg_id)
 	return ENC28_OK;
 }
 
-ENC28_CommandStatus enc28_do_read_ctl_reg(ENC28_SPI_Context *ctx, uint8_t reg_id, uint8_t *reg_value)
+ENC28_CommandStatus enc28_do_read_ctl_reg(ENC28_Device *dev, uint8_t reg_id, uint8_t *reg_value)
 {
-	if (!ctx)
+	if (!dev)
 	{
 		return ENC28_INVALID_PARAM;
 	}
 
-	if ((!ctx->nss_pin_op) || (!ctx->spi_in_op) || (!ctx->spi_out_op))
+	if ((!dev->spi.nss_pin_op) || (!dev->spi.spi_in_op) || (!dev->spi.spi_out_op))
 	{
 		return ENC28_INVALID_PARAM;
 	}
@@ -365,21 +581,21 @@ ENC28_CommandStatus enc28_do_read_ctl_reg(ENC28_SPI_Context *ctx, uint8_t reg_id
 			return status;
 		}
 
-		const uint8_t skip_dummy_byte = priv_enc28_is_mac_or_mii_reg(reg_id);
+		const uint8_t skip_dummy_byte = priv_enc28_is_mac_or_mii_reg(dev, reg_id);
 
-		ctx->nss_pin_op(0);
-		ctx->spi_out_op(&cmd_buff, 1);
+		dev->spi.nss_pin_op(0);
+		priv_enc28_spi_out(dev, &cmd_buff, 1);
 		if (skip_dummy_byte)
 		{
 			uint8_t buff[2] = {0, 0};
-			ctx->spi_in_op(buff, 2);
+			priv_enc28_spi_in(dev, buff, 2);
 			*reg_value = buff[1];
 		}
 		else
 		{
-			ctx->spi_in_op(reg_value, 1);
+			priv_enc28_spi_in(dev, reg_value, 1);
 		}
-		ctx->nss_pin_op(1);
+		dev->spi.nss_pin_op(1);
 	}
 
 	return ENC28_OK;
@@ -400,14 +616,14 @@ ENC28_CommandStatus enc28_prepare_write_ctl_reg(uint16_t *out, uint8_t reg_id, u
 	return ENC28_OK;
 }
 
-ENC28_CommandStatus enc28_do_write_ctl_reg(ENC28_SPI_Context *ctx, uint8_t reg_id, uint8_t reg_value)
+ENC28_CommandStatus enc28_do_write_ctl_reg(ENC28_Device *dev, uint8_t reg_id, uint8_t reg_value)
 {
-	if (!ctx)
+	if (!dev)
 	{
 		return ENC28_INVALID_PARAM;
 	}
 
-	if ((!ctx->nss_pin_op) || (!ctx->spi_in_op) || (!ctx->spi_out_op) || (!ctx->wait_nano))
+	if ((!dev->spi.nss_pin_op) || (!dev->spi.spi_in_op) || (!dev->spi.spi_out_op) || (!dev->spi.wait_nano))
 	{
 		return ENC28_INVALID_PARAM;
 	}
@@ -420,12 +636,18 @@ ENC28_CommandStatus enc28_do_write_ctl_reg(ENC28_SPI_Context *ctx, uint8_t reg_i
 			return status;
 		}
 
-		ctx->nss_pin_op(0);
-		ctx->wait_nano(50); // CS setup time
+		dev->spi.nss_pin_op(0);
+		dev->spi.wait_nano(50); // CS setup time
 		uint8_t send_buff[2] = {(cmd_buff >> 8), cmd_buff & 0xFF};
-		ctx->spi_out_op(send_buff, 2);
-		ctx->wait_nano(210); // CS hold time (TODO: MAC and MII registers = 210, ETH registers = 10)
-		ctx->nss_pin_op(1);
+		priv_enc28_spi_out(dev, send_buff, 2);
+		dev->spi.wait_nano(210); // CS hold time (TODO: MAC and MII registers = 210, ETH registers = 10)
+		dev->spi.nss_pin_op(1);
+	}
+
+	// keep the bank cache in sync with a direct write of ECON1
+	if (reg_id == ENC28_CR_ECON1)
+	{
+		dev->curr_bank = reg_value & ENC28_ECON1_BSEL;
 	}
 
 	return ENC28_OK;
@@ -461,14 +683,14 @@ ENC28_CommandStatus enc28_prepare_clear_bits_ctl_reg(uint16_t *out, uint8_t reg_
 	return ENC28_OK;
 }
 
-ENC28_CommandStatus enc28_do_set_bits_ctl_reg(ENC28_SPI_Context *ctx, uint8_t reg_id, uint8_t mask)
+ENC28_CommandStatus enc28_do_set_bits_ctl_reg(ENC28_Device *dev, uint8_t reg_id, uint8_t mask)
 {
-	if (!ctx)
+	if (!dev)
 	{
 		return ENC28_INVALID_PARAM;
 	}
 
-	if ((!ctx->nss_pin_op) || (!ctx->spi_in_op) || (!ctx->spi_out_op))
+	if ((!dev->spi.nss_pin_op) || (!dev->spi.spi_in_op) || (!dev->spi.spi_out_op))
 	{
 		return ENC28_INVALID_PARAM;
 	}
@@ -481,23 +703,28 @@ ENC28_CommandStatus enc28_do_set_bits_ctl_reg(ENC28_SPI_Context *ctx, uint8_t re
 			return status;
 		}
 
-		ctx->nss_pin_op(0);
+		dev->spi.nss_pin_op(0);
 		uint8_t send_buff[2] = {(cmd_buff >> 8), cmd_buff & 0xFF};
-		ctx->spi_out_op(send_buff, 2);
-		ctx->nss_pin_op(1);
+		priv_enc28_spi_out(dev, send_buff, 2);
+		dev->spi.nss_pin_op(1);
+	}
+
+	if (reg_id == ENC28_CR_ECON1)
+	{
+		dev->curr_bank |= (mask & ENC28_ECON1_BSEL);
 	}
 
 	return ENC28_OK;
 }
 
-ENC28_CommandStatus enc28_do_clear_bits_ctl_reg(ENC28_SPI_Context *ctx, uint8_t reg_id, uint8_t mask)
+ENC28_CommandStatus enc28_do_clear_bits_ctl_reg(ENC28_Device *dev, uint8_t reg_id, uint8_t mask)
 {
-	if (!ctx)
+	if (!dev)
 	{
 		return ENC28_INVALID_PARAM;
 	}
 
-	if ((!ctx->nss_pin_op) || (!ctx->spi_in_op) || (!ctx->spi_out_op))
+	if ((!dev->spi.nss_pin_op) || (!dev->spi.spi_in_op) || (!dev->spi.spi_out_op))
 	{
 		return ENC28_INVALID_PARAM;
 	}
@@ -510,102 +737,118 @@ ENC28_CommandStatus enc28_do_clear_bits_ctl_reg(ENC28_SPI_Context *ctx, uint8_t
 			return status;
 		}
 
-		ctx->nss_pin_op(0);
+		dev->spi.nss_pin_op(0);
 		uint8_t send_buff[2] = {(cmd_buff >> 8), cmd_buff & 0xFF};
-		ctx->spi_out_op(send_buff, 2);
-		ctx->nss_pin_op(1);
+		priv_enc28_spi_out(dev, send_buff, 2);
+		dev->spi.nss_pin_op(1);
+	}
+
+	if (reg_id == ENC28_CR_ECON1)
+	{
+		dev->curr_bank &= ~(mask & ENC28_ECON1_BSEL);
 	}
 
 	return ENC28_OK;
 }
 
-ENC28_CommandStatus enc28_select_register_bank(ENC28_SPI_Context *ctx, const uint8_t bank_id)
+ENC28_CommandStatus enc28_select_register_bank(ENC28_Device *dev, const uint8_t bank_id)
 {
-	if (bank_id >= 4)
+	if ((!dev) || (bank_id >= 4))
 	{
 		return ENC28_INVALID_PARAM;
 	}
 
-	uint8_t econ1_reg = 0;
-	ENC28_CommandStatus status = enc28_do_read_ctl_reg(ctx, ENC28_CR_ECON1, &econ1_reg);
-	EXIT_IF_ERR(status);
+	if (bank_id == dev->curr_bank)
+	{
+		return ENC28_OK;
+	}
 
-	econ1_reg &= ~(ENC28_ECON1_BSEL);
-	econ1_reg |= ENC28_ECON1_BANK_SEL(bank_id);
-	status = enc28_do_write_ctl_reg(ctx, ENC28_CR_ECON1, econ1_reg);
+	// ECON1 is a common register, so the bank bits can be toggled with the bit field commands
+	const uint8_t clear_mask = ENC28_ECON1_BANK_SEL(dev->curr_bank) & ~ENC28_ECON1_BANK_SEL(bank_id);
+	const uint8_t set_mask = ENC28_ECON1_BANK_SEL(bank_id) & ~ENC28_ECON1_BANK_SEL(dev->curr_bank);
+	ENC28_CommandStatus status = ENC28_OK;
 
-	if (status == ENC28_OK)
+	if (clear_mask)
 	{
-		priv_enc28_curr_bank = bank_id;
+		status = enc28_do_clear_bits_ctl_reg(dev, ENC28_CR_ECON1, clear_mask);
+		EXIT_IF_ERR(status);
 	}
 
-	return status;
+	if (set_mask)
+	{
+		status = enc28_do_set_bits_ctl_reg(dev, ENC28_CR_ECON1, set_mask);
+		EXIT_IF_ERR(status);
+	}
+
+	dev->curr_bank = bank_id;
+
+	return ENC28_OK;
 }
 
-ENC28_CommandStatus enc28_do_read_phy_register(ENC28_SPI_Context *ctx, uint8_t reg_id, uint16_t *reg_value)
+ENC28_CommandStatus enc28_do_read_phy_register(ENC28_Device *dev, uint8_t reg_id, uint16_t *reg_value)
 {
 	if (!priv_enc28_is_phy_reg(reg_id))
 	{
 		return ENC28_INVALID_PARAM;
 	}
 
-	if (!ctx)
+	if (!dev)
 	{
 		return ENC28_INVALID_PARAM;
 	}
 
-	if ((!ctx->nss_pin_op) || (!ctx->spi_in_op) || (!ctx->spi_out_op) || (!ctx->wait_nano))
+	if ((!dev->spi.nss_pin_op) || (!dev->spi.spi_in_op) || (!dev->spi.spi_out_op) || (!dev->spi.wait_nano))
 	{
 		return ENC28_INVALID_PARAM;
 	}
 
-	ENC28_CommandStatus status = enc28_select_register_bank(ctx, 2);
+	ENC28_CommandStatus status = enc28_select_register_bank(dev, 2);
 	EXIT_IF_ERR(status);
 
-	status = enc28_do_write_ctl_reg(ctx, ENC28_CR_MIREGADR, reg_id);
+	status = enc28_do_write_ctl_reg(dev, ENC28_CR_MIREGADR, reg_id);
 	EXIT_IF_ERR(status);
 
 	{
 		const uint8_t miird_mask = (1 << ENC28_MICMD_MIIRD);
-		status = enc28_do_write_ctl_reg(ctx, ENC28_CR_MICMD, miird_mask);
+		status = enc28_do_write_ctl_reg(dev, ENC28_CR_MICMD, miird_mask);
 		EXIT_IF_ERR(status);
 	}
 
-	ctx->wait_nano(11 * 1000);
+	dev->spi.wait_nano(11 * 1000);
 
 	{
-		status = enc28_select_register_bank(ctx, 3);
+		status = enc28_select_register_bank(dev, 3);
 		EXIT_IF_ERR(status);
 
 		while (status == ENC28_OK)
 		{
 			uint8_t mistat_value = 0xff;
-			status = enc28_do_read_ctl_reg(ctx, ENC28_CR_MISTAT, &mistat_value);
+			status = enc28_do_read_ctl_reg(dev, ENC28_CR_MISTAT, &mistat_value);
 			EXIT_IF_ERR(status);
 			if ((mistat_value & (1 << ENC28_MISTAT_BUSY)) == 0)
 			{
 				break;
 			}
-			ctx->wait_nano(1);
+			dev->spi.wait_nano(1);
 		}
 		EXIT_IF_ERR(status);
 	}
 
 	{
-		status = enc28_select_register_bank(ctx, 2);
+		status = enc28_select_register_bank(dev, 2);
 		EXIT_IF_ERR(status);
 
 		const uint8_t miird_mask = 0;
-		status = enc28_do_write_ctl_reg(ctx, ENC28_CR_MICMD, miird_mask);
+		status = enc28_do_write_ctl_reg(dev, ENC28_CR_MICMD, miird_mask);
 		EXIT_IF_ERR(status);
 	}
 
 	{
 		uint8_t reg_val_lo = 0xff;
 		uint8_t reg_val_hi = 0xff;
-		status = enc28_do_read_ctl_reg(ctx, ENC28_CR_MIRDL, &reg_val_lo);
+		status = enc28_do_read_ctl_reg(dev, ENC28_CR_MIRDL, &reg_val_lo);
 		EXIT_IF_ERR(status);
-		status = enc28_do_read_ctl_reg(ctx, ENC28_CR_MIRDH, &reg_val_hi);
+		status = enc28_do_read_ctl_reg(dev, ENC28_CR_MIRDH, &reg_val_hi);
 		EXIT_IF_ERR(status);
 		*reg_value = (reg_val_hi << 8) | reg_val_lo;
 	}
@@ -613,289 +856,1014 @@ ENC28_CommandStatus enc28_do_read_phy_register(ENC28_SPI_Context *ctx, uint8_t r
 	return ENC28_OK;
 }
 
-ENC28_CommandStatus enc28_begin_packet_transfer(ENC28_SPI_Context *ctx)
+ENC28_CommandStatus enc28_do_write_phy_register(ENC28_Device *dev, uint8_t reg_id, uint16_t reg_value)
 {
-	uint8_t mask;
-	ENC28_CommandStatus status = enc28_select_register_bank(ctx, 0);
-	EXIT_IF_ERR(status);
+	if (!priv_enc28_is_phy_reg(reg_id))
+	{
+		return ENC28_INVALID_PARAM;
+	}
 
-	// update  ERDPT to point to the start of the ETH buffer
-	status = enc28_do_write_ctl_reg(ctx, ENC28_CR_ERDPTL, ENC28_CONF_RX_ADDRESS_START & 0xFF);
-	EXIT_IF_ERR(status);
-	status = enc28_do_write_ctl_reg(ctx, ENC28_CR_ERDPTH, (ENC28_CONF_RX_ADDRESS_START >> 8) & 0x1F);
-	EXIT_IF_ERR(status);
+	if (!dev)
+	{
+		return ENC28_INVALID_PARAM;
+	}
 
-	mask = 0;
-	mask |= (1 << ENC28_EIE_INTIE);
-	mask |= (1 << ENC28_EIE_PKTIE);
-	mask |= (1 << ENC28_EIE_RXERIE);
-	mask |= (1 << ENC28_EIE_TXERIE);
-	status = enc28_do_set_bits_ctl_reg(ctx, ENC28_CR_EIE, mask);
-	EXIT_IF_ERR(status);
+	if ((!dev->spi.nss_pin_op) || (!dev->spi.spi_in_op) || (!dev->spi.spi_out_op) || (!dev->spi.wait_nano))
+	{
+		return ENC28_INVALID_PARAM;
+	}
 
-	mask = (1 << ENC28_EIR_RXERIF);
-	status = enc28_do_clear_bits_ctl_reg(ctx, ENC28_CR_EIR, mask);
+	ENC28_CommandStatus status = enc28_select_register_bank(dev, 2);
 	EXIT_IF_ERR(status);
 
-	mask = (1 << ENC28_ECON2_AUTOINC);
-	status = enc28_do_set_bits_ctl_reg(ctx, ENC28_CR_ECON2, mask);
+	status = enc28_do_write_ctl_reg(dev, ENC28_CR_MIREGADR, reg_id);
 	EXIT_IF_ERR(status);
 
-	mask = 0;
-	mask |= (1 << ENC28_ECON1_RXEN);
-	status = enc28_do_set_bits_ctl_reg(ctx, ENC28_CR_ECON1, mask);
-	return status;
-}
-
-ENC28_CommandStatus enc28_read_packet(ENC28_SPI_Context *ctx, uint8_t *packet_buf, uint16_t buf_size, ENC28_Receive_Status_Vector *opt_status_vec)
-{
-	uint8_t val = 0;
-	ENC28_CommandStatus status = enc28_do_read_ctl_reg(ctx, ENC28_CR_EIR, &val);
+	// writing MIWRH starts the MII transaction
+	status = enc28_do_write_ctl_reg(dev, ENC28_CR_MIWRL, reg_value & 0xFF);
+	EXIT_IF_ERR(status);
+	status = enc28_do_write_ctl_reg(dev, ENC28_CR_MIWRH, (reg_value >> 8) & 0xFF);
 	EXIT_IF_ERR(status);
 
-	if (val & (1 << ENC28_EIR_PKTIF))
-	{
-		uint16_t read_ptr = 0;
+	dev->spi.wait_nano(11 * 1000);
 
-		status = enc28_select_register_bank(ctx, 0);
+	{
+		status = enc28_select_register_bank(dev, 3);
 		EXIT_IF_ERR(status);
-		status = enc28_do_read_ctl_reg(ctx, ENC28_CR_ERDPTL, &val);
-		read_ptr = val;
-		status = enc28_do_read_ctl_reg(ctx, ENC28_CR_ERDPTH, &val);
-		read_ptr |= ((val & 0x1F) << 8);
 
-		if ((read_ptr < ENC28_CONF_RX_ADDRESS_START) || (read_ptr > ENC28_CONF_RX_ADDRESS_END))
+		while (status == ENC28_OK)
 		{
-			return ENC28_READ_PTR_OUT_OF_RANGE;
+			uint8_t mistat_value = 0xff;
+			status = enc28_do_read_ctl_reg(dev, ENC28_CR_MISTAT, &mistat_value);
+			EXIT_IF_ERR(status);
+			if ((mistat_value & (1 << ENC28_MISTAT_BUSY)) == 0)
+			{
+				break;
+			}
+			dev->spi.wait_nano(1);
 		}
+		EXIT_IF_ERR(status);
+	}
 
-		uint8_t command[7] = {0x3A, 0, 0, 0, 0, 0, 0};
-		uint8_t hdr[7] = {0, 0, 0, 0, 0, 0, 0};
+	return ENC28_OK;
+}
 
-		ctx->nss_pin_op(0);
-		ctx->spi_in_out_op(command, hdr, 7);
-		ctx->nss_pin_op(1);
+ENC28_CommandStatus enc28_update_link_status(ENC28_Device *dev, uint8_t *opt_link_up)
+{
+	if (!dev)
+	{
+		return ENC28_INVALID_PARAM;
+	}
 
-		ENC28_Receive_Status_Vector status_vec;
-		status_vec.packet_len_lo = hdr[3];
-		status_vec.packet_len_hi = hdr[4];
-		*((uint8_t*)&status_vec.status_bits_lo) = hdr[5];
-		*((uint8_t*)&status_vec.status_bits_hi) = hdr[6];
+	uint16_t phstat2_value = 0;
+	ENC28_CommandStatus status = enc28_do_read_phy_register(dev, ENC28_PHYR_PHSTAT2, &phstat2_value);
+	EXIT_IF_ERR(status);
 
-		if (opt_status_vec)
+	{
+		// the PHY does not negotiate, DPXSTAT follows PHCON1.PDPXMD and the MAC has to match it
+		const uint8_t full_duplex = (phstat2_value & (1 << ENC28_PHSTAT2_DPXSTAT)) != 0;
+		if (full_duplex != dev->full_duplex)
 		{
-			*opt_status_vec = status_vec;
+			status = priv_enc28_apply_duplex(dev, full_duplex);
+			EXIT_IF_ERR(status);
+			dev->stats.duplex_changes++;
 		}
+	}
 
-		if (!status_vec.status_bits_lo.received_ok)
+	{
+		const uint8_t link_up = (phstat2_value & (1 << ENC28_PHSTAT2_LSTAT)) != 0;
+		if (link_up != dev->link_up)
 		{
-			return ENC28_PACKET_RCV_ERR;
+			dev->stats.link_changes++;
 		}
+		dev->link_up = link_up;
+	}
 
-		{
-			const uint16_t packet_len = (status_vec.packet_len_hi << 8) | status_vec.packet_len_lo;
-			if (packet_len > buf_size)
-			{
-				return ENC28_BUFFER_TOO_SMALL;
-			}
+	if (opt_link_up)
+	{
+		*opt_link_up = dev->link_up;
+	}
 
-			ctx->nss_pin_op(0);
-			ctx->spi_out_op(command, 1);
-			ctx->spi_in_op(packet_buf, packet_len);
-			ctx->nss_pin_op(1);
-		}
+	return enc28_select_register_bank(dev, 0);
+}
 
-		{ // Update ERXDPT according to the errata
-			uint16_t PP = (((hdr[2] & 0x1F) << 8) | hdr[1]);
-			{
-				// update  ERDPT to skip the current packet next time
-				status = enc28_do_write_ctl_reg(ctx, ENC28_CR_ERDPTL, hdr[1]);
-				EXIT_IF_ERR(status);
+static uint16_t priv_enc28_rx_ptr_advance(const ENC28_Device *dev, uint16_t ptr, uint16_t count)
+{
+	const uint16_t rx_size = dev->layout.rx_end - dev->layout.rx_start + 1;
+	return dev->layout.rx_start + ((ptr - dev->layout.rx_start + count) % rx_size);
+}
 
-				status = enc28_do_write_ctl_reg(ctx, ENC28_CR_ERDPTH, hdr[2]);
-				EXIT_IF_ERR(status);
-			}
+/* Programs ERDPT, bank 0 has to be selected */
+static ENC28_CommandStatus priv_enc28_write_read_ptr(ENC28_Device *dev, uint16_t addr)
+{
+	ENC28_CommandStatus status = enc28_do_write_ctl_reg(dev, ENC28_CR_ERDPTL, addr & 0xFF);
+	EXIT_IF_ERR(status);
+	return enc28_do_write_ctl_reg(dev, ENC28_CR_ERDPTH, (addr >> 8) & 0x1F);
+}
 
-			if ((PP -1 > ENC28_CONF_RX_ADDRESS_END) || (PP - 1 < ENC28_CONF_RX_ADDRESS_START) )
-			{
-				PP = ENC28_CONF_RX_ADDRESS_END;
-			}
-			else
-			{
-				PP -= 1;
-			}
+/* Programs ERXRDPT to free the space before @p next_ptr, bank 0 has to be selected */
+static ENC28_CommandStatus priv_enc28_write_rx_read_ptr(ENC28_Device *dev, uint16_t next_ptr)
+{
+	// ERRATA: ERXRDPT must be programmed with an odd address
+	const uint16_t rx_rd_ptr = (next_ptr == dev->layout.rx_start) ? dev->layout.rx_end : (next_ptr - 1);
 
-			status = enc28_do_write_ctl_reg(ctx, ENC28_CR_ERXRDPTL, PP & 0xFF);
-			EXIT_IF_ERR(status);
-			status = enc28_do_write_ctl_reg(ctx, ENC28_CR_ERXRDPTH, (PP >> 8) & 0x1F);
-			EXIT_IF_ERR(status);
-		}
+	ENC28_CommandStatus status = enc28_do_write_ctl_reg(dev, ENC28_CR_ERXRDPTL, rx_rd_ptr & 0xFF);
+	EXIT_IF_ERR(status);
+	return enc28_do_write_ctl_reg(dev, ENC28_CR_ERXRDPTH, (rx_rd_ptr >> 8) & 0x1F);
+}
 
-		status = enc28_do_set_bits_ctl_reg(ctx, ENC28_CR_ECON2, (1 << ENC28_ECON2_PKTDEC));
+/* Frees the space of the packets read so far and decrements EPKTCNT by @p packet_count, bank 0 has to be selected */
+static ENC28_CommandStatus priv_enc28_release_rx_space(ENC28_Device *dev, uint8_t packet_count)
+{
+	ENC28_CommandStatus status = priv_enc28_write_rx_read_ptr(dev, dev->next_packet_ptr);
+	EXIT_IF_ERR(status);
 
-		return status;
-	}
-	else if (val & (1 << ENC28_EIR_RXERIF))
+	for (uint8_t i = 0; i < packet_count; ++i)
 	{
-		status = enc28_select_register_bank(ctx, 0);
-		EXIT_IF_ERR(status);
-
-		status = enc28_do_write_ctl_reg(ctx, ENC28_CR_ERXRDPTL, ENC28_CONF_RX_ADDRESS_END & 0xFF);
-		EXIT_IF_ERR(status);
-		status = enc28_do_write_ctl_reg(ctx, ENC28_CR_ERXRDPTH, (ENC28_CONF_RX_ADDRESS_END >> 8) & 0x1F);
+		status = enc28_do_set_bits_ctl_reg(dev, ENC28_CR_ECON2, (1 << ENC28_ECON2_PKTDEC));
 		EXIT_IF_ERR(status);
+	}
 
-		status = enc28_do_clear_bits_ctl_reg(ctx, ENC28_CR_EIR, (1 << ENC28_EIR_RXERIF));
-		EXIT_IF_ERR(status);
+	return ENC28_OK;
+}
 
-		return ENC28_PACKET_RCV_ERR;
-	}
-	else
+uint8_t enc28_hash_table_index(const uint8_t mac_addr[6])
+{
+	// same CRC-32 as the frame check sequence
+	uint32_t crc = 0xFFFFFFFF;
+	for (uint8_t i = 0; i < 6; ++i)
 	{
-		return ENC28_NO_DATA;
+		crc ^= mac_addr[i];
+		for (uint8_t bit = 0; bit < 8; ++bit)
+		{
+			crc = (crc >> 1) ^ (0xEDB88320 & (-(crc & 1)));
+		}
 	}
+	return (uint8_t)((~crc >> 23) & 0x3F);
 }
 
-ENC28_CommandStatus enc28_write_packet(ENC28_SPI_Context *ctx, const uint8_t *packet_buf, uint16_t buf_size)
+ENC28_CommandStatus enc28_write_hash_table(ENC28_Device *dev, const uint8_t table[ENC28_HASH_TABLE_SIZE])
 {
-	if ((!ctx) || !(packet_buf) || (buf_size < 14))
+	if ((!dev) || (!table))
 	{
 		return ENC28_INVALID_PARAM;
 	}
 
+	ENC28_CommandStatus status = enc28_select_register_bank(dev, 1);
+	EXIT_IF_ERR(status);
+
+	for (uint8_t i = 0; i < ENC28_HASH_TABLE_SIZE; ++i)
+	{
+		status = enc28_do_write_ctl_reg(dev, ENC28_CR_EHT0 + i, table[i]);
+		EXIT_IF_ERR(status);
+	}
+
 	{
-		uint8_t reg_val;
-		ENC28_CommandStatus status = enc28_do_read_ctl_reg(ctx, ENC28_CR_ECON1, &reg_val);
+		uint8_t erxfcon_value = 0;
+		status = enc28_do_read_ctl_reg(dev, ENC28_CR_ERXFCON, &erxfcon_value);
 		EXIT_IF_ERR(status);
+		const uint8_t new_value = (erxfcon_value | ENC28_ERXFCON_HT) & ~ENC28_ERXFCON_MULTI;
+		if (new_value != erxfcon_value)
+		{
+			status = enc28_do_write_ctl_reg(dev, ENC28_CR_ERXFCON, new_value);
+			EXIT_IF_ERR(status);
+		}
+	}
+
+	return enc28_select_register_bank(dev, 0);
+}
 
-		if (reg_val & (1 << ENC28_ECON1_TXRTS))
+ENC28_CommandStatus enc28_build_pattern_match(const uint8_t *template_frame, const uint8_t *byte_mask, uint16_t len, ENC28_Pattern_Match *pm)
+{
+	if ((!template_frame) || (!byte_mask) || (!pm))
+	{
+		return ENC28_INVALID_PARAM;
+	}
+
+	uint16_t first = len;
+	for (uint16_t i = 0; i < len; ++i)
+	{
+		if (byte_mask[i])
 		{
-			return ENC28_PACKET_TX_IN_PROGRESS;
+			first = i;
+			break;
 		}
 	}
+	if (first == len)
+	{
+		return ENC28_INVALID_PARAM;
+	}
+
+	memset(pm, 0, sizeof(*pm));
+	pm->offset = first;
+
+	// selected bytes are summed in order as big-endian words, like the DMA checksum
+	uint32_t sum = 0;
+	uint8_t selected = 0;
+	for (uint16_t i = first; i < len; ++i)
+	{
+		if (!byte_mask[i])
+		{
+			continue;
+		}
+		const uint16_t window_pos = i - first;
+		if (window_pos >= ENC28_PATTERN_WINDOW_SIZE)
+		{
+			return ENC28_INVALID_PARAM;
+		}
+		pm->mask[window_pos >> 3] |= (1 << (window_pos & 0x7));
+		sum += (selected & 0x1) ? template_frame[i] : ((uint32_t)template_frame[i] << 8);
+		++selected;
+	}
+
+	while (sum >> 16)
+	{
+		sum = (sum & 0xFFFF) + (sum >> 16);
+	}
+	pm->checksum = (uint16_t)~sum;
+
+	return ENC28_OK;
+}
+
+ENC28_CommandStatus enc28_write_pattern_match(ENC28_Device *dev, const ENC28_Pattern_Match *pm, uint8_t clear_filters)
+{
+	if ((!dev) || (!pm) || (pm->offset >= ENC28_BUFFER_SIZE))
+	{
+		return ENC28_INVALID_PARAM;
+	}
+
+	ENC28_CommandStatus status = enc28_select_register_bank(dev, 1);
+	EXIT_IF_ERR(status);
+
+	for (uint8_t i = 0; i < sizeof(pm->mask); ++i)
+	{
+		status = enc28_do_write_ctl_reg(dev, ENC28_CR_EPMM0 + i, pm->mask[i]);
+		EXIT_IF_ERR(status);
+	}
+
+	status = enc28_do_write_ctl_reg(dev, ENC28_CR_EPMCSL, pm->checksum & 0xFF);
+	EXIT_IF_ERR(status);
+	status = enc28_do_write_ctl_reg(dev, ENC28_CR_EPMCSH, (pm->checksum >> 8) & 0xFF);
+	EXIT_IF_ERR(status);
+	status = enc28_do_write_ctl_reg(dev, ENC28_CR_EPMOL, pm->offset & 0xFF);
+	EXIT_IF_ERR(status);
+	status = enc28_do_write_ctl_reg(dev, ENC28_CR_EPMOH, (pm->offset >> 8) & 0x1F);
+	EXIT_IF_ERR(status);
+
+	{
+		uint8_t erxfcon_value = 0;
+		status = enc28_do_read_ctl_reg(dev, ENC28_CR_ERXFCON, &erxfcon_value);
+		EXIT_IF_ERR(status);
+		erxfcon_value = (erxfcon_value | ENC28_ERXFCON_PM) & ~clear_filters;
+		status = enc28_do_write_ctl_reg(dev, ENC28_CR_ERXFCON, erxfcon_value);
+		EXIT_IF_ERR(status);
+	}
+
+	return enc28_select_register_bank(dev, 0);
+}
+
+ENC28_CommandStatus enc28_begin_packet_transfer(ENC28_Device *dev)
+{
+	uint8_t mask;
+	ENC28_CommandStatus status = enc28_select_register_bank(dev, 0);
+	EXIT_IF_ERR(status);
+
+	// update  ERDPT to point to the start of the ETH buffer
+	status = priv_enc28_write_read_ptr(dev, dev->layout.rx_start);
+	EXIT_IF_ERR(status);
+	dev->next_packet_ptr = dev->layout.rx_start;
+
+	mask = 0;
+	mask |= (1 << ENC28_EIE_INTIE);
+	mask |= (1 << ENC28_EIE_PKTIE);
+	mask |= (1 << ENC28_EIE_RXERIE);
+	mask |= (1 << ENC28_EIE_TXIE);
+	mask |= (1 << ENC28_EIE_TXERIE);
+	mask |= (1 << ENC28_EIE_LINKIE);
+	status = enc28_do_set_bits_ctl_reg(dev, ENC28_CR_EIE, mask);
+	EXIT_IF_ERR(status);
+
+	mask = (1 << ENC28_EIR_RXERIF);
+	status = enc28_do_clear_bits_ctl_reg(dev, ENC28_CR_EIR, mask);
+	EXIT_IF_ERR(status);
+
+	mask = (1 << ENC28_ECON2_AUTOINC);
+	status = enc28_do_set_bits_ctl_reg(dev, ENC28_CR_ECON2, mask);
+	EXIT_IF_ERR(status);
+
+	mask = 0;
+	mask |= (1 << ENC28_ECON1_RXEN);
+	status = enc28_do_set_bits_ctl_reg(dev, ENC28_CR_ECON1, mask);
+	return status;
+}
+
+/*
+ * Reads the packet at dev->next_packet_ptr and advances the read pointer to the next packet.
+ * The packet goes to @p packet_buf, or to the buffer from @p opt_provider if it is not NULL.
+ * The packet space is not released. Bank 0 has to be selected.
+ * @return ENC28_NO_DATA if @p opt_provider has no buffer, the read pointer is left at the packet
+ * */
+static ENC28_CommandStatus priv_enc28_read_rx_packet(ENC28_Device *dev, uint8_t *packet_buf, uint16_t buf_size,
+		const ENC28_Rx_Buffer_Provider *opt_provider, ENC28_Receive_Status_Vector *status_vec)
+{
+	ENC28_CommandStatus status = ENC28_OK;
+
+	// ERDPT already points at dev->next_packet_ptr
+	uint8_t command[7] = {0x3A, 0, 0, 0, 0, 0, 0};
+	uint8_t hdr[7] = {0, 0, 0, 0, 0, 0, 0};
+
+	dev->spi.nss_pin_op(0);
+	priv_enc28_spi_in_out(dev, command, hdr, 7);
+	dev->spi.nss_pin_op(1);
+
+	const uint16_t next_ptr = (((hdr[2] & 0x1F) << 8) | hdr[1]);
+	if ((next_ptr < dev->layout.rx_start) || (next_ptr > dev->layout.rx_end) || (next_ptr & 0x1))
+	{
+		return ENC28_READ_PTR_OUT_OF_RANGE;
+	}
+
+	status_vec->packet_len_lo = hdr[3];
+	status_vec->packet_len_hi = hdr[4];
+	*((uint8_t*)&status_vec->status_bits_lo) = hdr[5];
+	*((uint8_t*)&status_vec->status_bits_hi) = hdr[6];
+
+	const uint16_t packet_len = (status_vec->packet_len_hi << 8) | status_vec->packet_len_lo;
+	ENC28_CommandStatus read_status = ENC28_OK;
+
+	if (!status_vec->status_bits_lo.received_ok)
+	{
+		read_status = ENC28_PACKET_RCV_ERR;
+	}
+	else if (packet_len > buf_size)
+	{
+		read_status = ENC28_BUFFER_TOO_SMALL;
+	}
+	else if (opt_provider)
+	{
+		packet_buf = opt_provider->alloc(packet_len, opt_provider->user);
+		if (!packet_buf)
+		{
+			// rewind ERDPT to the status vector, the packet is read again on the next call
+			status = priv_enc28_write_read_ptr(dev, dev->next_packet_ptr);
+			EXIT_IF_ERR(status);
+			return ENC28_NO_DATA;
+		}
+	}
+
+	if (read_status == ENC28_OK)
+	{
+		// packets start at even addresses, read the padding byte so ERDPT lands on the next packet
+		const uint16_t pad_len = packet_len & 0x1;
+		uint8_t pad = 0;
+
+		dev->spi.nss_pin_op(0);
+		priv_enc28_spi_out(dev, command, 1);
+		priv_enc28_buffer_in(dev, packet_buf, packet_len);
+		if (pad_len)
+		{
+			priv_enc28_spi_in(dev, &pad, pad_len);
+		}
+		dev->spi.nss_pin_op(1);
+
+		if (priv_enc28_rx_ptr_advance(dev, dev->next_packet_ptr, ENC28_RSV_SIZE + packet_len + pad_len) != next_ptr)
+		{
+			status = priv_enc28_write_read_ptr(dev, next_ptr);
+		}
+
+		dev->stats.rx_packets++;
+		dev->stats.rx_bytes += packet_len;
+	}
+	else
+	{
+		// skip the packet
+		status = priv_enc28_write_read_ptr(dev, next_ptr);
+
+		dev->stats.rx_errors++;
+		if (read_status == ENC28_BUFFER_TOO_SMALL)
+		{
+			dev->stats.rx_too_long++;
+		}
+	}
+
+	dev->next_packet_ptr = next_ptr;
+	EXIT_IF_ERR(status);
+
+	return read_status;
+}
+
+/* Handles EIR.RXERIF when the receive buffer is empty */
+static ENC28_CommandStatus priv_enc28_recover_rx_error(ENC28_Device *dev)
+{
+	ENC28_CommandStatus status = enc28_select_register_bank(dev, 0);
+	EXIT_IF_ERR(status);
+
+	// re-synchronise the hardware pointers with the software copy
+	status = priv_enc28_write_read_ptr(dev, dev->next_packet_ptr);
+	EXIT_IF_ERR(status);
+	status = priv_enc28_write_rx_read_ptr(dev, dev->next_packet_ptr);
+	EXIT_IF_ERR(status);
+
+	status = enc28_do_clear_bits_ctl_reg(dev, ENC28_CR_EIR, (1 << ENC28_EIR_RXERIF));
+	EXIT_IF_ERR(status);
+
+	dev->stats.rx_errors++;
+	return ENC28_PACKET_RCV_ERR;
+}
+
+ENC28_CommandStatus enc28_read_packet(ENC28_Device *dev, uint8_t *packet_buf, uint16_t buf_size, ENC28_Receive_Status_Vector *opt_status_vec)
+{
+	uint8_t val = 0;
+	ENC28_CommandStatus status = enc28_do_read_ctl_reg(dev, ENC28_CR_EIR, &val);
+	EXIT_IF_ERR(status);
+
+	if (val & (1 << ENC28_EIR_PKTIF))
+	{
+		ENC28_Receive_Status_Vector status_vec;
+
+		status = enc28_select_register_bank(dev, 0);
+		EXIT_IF_ERR(status);
+
+		const ENC28_CommandStatus read_status = priv_enc28_read_rx_packet(dev, packet_buf, buf_size, NULL, &status_vec);
+		if (read_status == ENC28_READ_PTR_OUT_OF_RANGE)
+		{
+			return read_status;
+		}
+
+		if (opt_status_vec)
+		{
+			*opt_status_vec = status_vec;
+		}
+
+		status = priv_enc28_release_rx_space(dev, 1);
+		EXIT_IF_ERR(status);
+
+		return read_status;
+	}
+	else if (val & (1 << ENC28_EIR_RXERIF))
+	{
+		return priv_enc28_recover_rx_error(dev);
+	}
+	else
+	{
+		return ENC28_NO_DATA;
+	}
+}
+
+/*
+ * Burst read shared by enc28_read_packets_burst and enc28_read_packets_sized, @p packet_bufs is NULL when @p opt_provider is used
+ * */
+static ENC28_CommandStatus priv_enc28_read_packets(ENC28_Device *dev,
+		uint8_t *const *packet_bufs,
+		uint16_t buf_size,
+		const ENC28_Rx_Buffer_Provider *opt_provider,
+		ENC28_Receive_Status_Vector *status_vecs,
+		uint8_t max_packets,
+		uint8_t *packets_read)
+{
+	*packets_read = 0;
+
+	uint8_t pending = 0;
+	ENC28_CommandStatus status = enc28_select_register_bank(dev, 1);
+	EXIT_IF_ERR(status);
+	status = enc28_do_read_ctl_reg(dev, ENC28_CR_EPKTCNT, &pending);
+	EXIT_IF_ERR(status);
+
+	if (pending == 0)
+	{
+		uint8_t eir = 0;
+		status = enc28_do_read_ctl_reg(dev, ENC28_CR_EIR, &eir);
+		EXIT_IF_ERR(status);
+
+		return (eir & (1 << ENC28_EIR_RXERIF)) ? priv_enc28_recover_rx_error(dev) : ENC28_NO_DATA;
+	}
+
+	if (pending > max_packets)
+	{
+		pending = max_packets;
+	}
+
+	status = enc28_select_register_bank(dev, 0);
+	EXIT_IF_ERR(status);
+
+	uint8_t consumed = 0;
+	ENC28_CommandStatus read_status = ENC28_OK;
+	while (consumed < pending)
+	{
+		const uint8_t slot = *packets_read;
+		read_status = priv_enc28_read_rx_packet(dev, packet_bufs ? packet_bufs[slot] : NULL, buf_size, opt_provider, &status_vecs[slot]);
+		if ((read_status == ENC28_READ_PTR_OUT_OF_RANGE) || (read_status == ENC28_NO_DATA))
+		{
+			break;
+		}
+
+		++consumed;
+		if (read_status == ENC28_OK)
+		{
+			++(*packets_read);
+		}
+	}
+
+	// one ERXRDPT update for the whole burst
+	if (consumed > 0)
+	{
+		status = priv_enc28_release_rx_space(dev, consumed);
+		EXIT_IF_ERR(status);
+	}
+
+	if (read_status == ENC28_READ_PTR_OUT_OF_RANGE)
+	{
+		return read_status;
+	}
+
+	if (*packets_read > 0)
+	{
+		return ENC28_OK;
+	}
+	return (read_status == ENC28_NO_DATA) ? ENC28_NO_DATA : ENC28_PACKET_RCV_ERR;
+}
+
+ENC28_CommandStatus enc28_read_packets_burst(ENC28_Device *dev,
+		uint8_t *const *packet_bufs,
+		uint16_t buf_size,
+		ENC28_Receive_Status_Vector *status_vecs,
+		uint8_t max_packets,
+		uint8_t *packets_read)
+{
+	if ((!dev) || (!packet_bufs) || (!status_vecs) || (!packets_read))
+	{
+		return ENC28_INVALID_PARAM;
+	}
+
+	return priv_enc28_read_packets(dev, packet_bufs, buf_size, NULL, status_vecs, max_packets, packets_read);
+}
+
+ENC28_CommandStatus enc28_read_packets_sized(ENC28_Device *dev,
+		const ENC28_Rx_Buffer_Provider *provider,
+		ENC28_Receive_Status_Vector *status_vecs,
+		uint8_t max_packets,
+		uint8_t *packets_read)
+{
+	if ((!dev) || (!provider) || (!provider->alloc) || (!status_vecs) || (!packets_read))
+	{
+		return ENC28_INVALID_PARAM;
+	}
+
+	return priv_enc28_read_packets(dev, NULL, provider->max_len, provider, status_vecs, max_packets, packets_read);
+}
+
+static ENC28_CommandStatus priv_enc28_fill_tx_checksum(ENC28_Device *dev, uint16_t frame_addr, const ENC28_Tx_Checksum *csum)
+{
+	uint16_t checksum = 0;
+	ENC28_CommandStatus status = enc28_compute_checksum(dev, frame_addr + csum->start, csum->len, &checksum);
+	EXIT_IF_ERR(status);
+
+	// the module returns the complemented sum, the seed is added to the sum itself
+	if (csum->seed)
+	{
+		uint32_t sum = (uint16_t)~checksum + (uint32_t)csum->seed;
+		sum = (sum >> 16) + (sum & 0xFFFF);
+		checksum = ~(uint16_t)(sum + (sum >> 16));
+	}
+
+	// zero is sent as 0xFFFF, a zero UDP checksum means "no checksum"
+	if (checksum == 0)
+	{
+		checksum = 0xFFFF;
+	}
+
+	const uint16_t field_addr = frame_addr + csum->field;
+	status = enc28_do_write_ctl_reg(dev, ENC28_CR_EWRPTL, field_addr & 0xFF);
+	EXIT_IF_ERR(status);
+	status = enc28_do_write_ctl_reg(dev, ENC28_CR_EWRPTH, (field_addr >> 8) & 0x1F);
+	EXIT_IF_ERR(status);
+
+	const uint8_t command[] = {0x7A, (checksum >> 8) & 0xFF, checksum & 0xFF};
+	dev->spi.nss_pin_op(0);
+	priv_enc28_spi_out(dev, command, sizeof(command));
+	dev->spi.nss_pin_op(1);
+
+	return ENC28_OK;
+}
+
+static uint16_t priv_enc28_tx_slot_start(const ENC28_Device *dev, uint8_t slot)
+{
+	return dev->layout.tx_start + slot * ENC28_TX_SLOT_SIZE;
+}
+
+static ENC28_CommandStatus priv_enc28_start_transmit(ENC28_Device *dev, uint8_t slot)
+{
+	const uint16_t start_address = priv_enc28_tx_slot_start(dev, slot);
+	// the control byte is followed by the frame
+	const uint16_t end_address = start_address + dev->tx_len[slot];
 
 	// 1.  program ETXST pointer
-	ENC28_CommandStatus status = enc28_select_register_bank(ctx, 0);
+	ENC28_CommandStatus status = enc28_select_register_bank(dev, 0);
+	EXIT_IF_ERR(status);
+	status = enc28_do_write_ctl_reg(dev, ENC28_CR_ETXSTL, start_address & 0xFF);
+	EXIT_IF_ERR(status);
+	status = enc28_do_write_ctl_reg(dev, ENC28_CR_ETXSTH, (start_address >> 8) & 0x1F);
+	EXIT_IF_ERR(status);
+
+	// 3.  program ETXND to point to the last byte in the packet
+	status = enc28_do_write_ctl_reg(dev, ENC28_CR_ETXNDL, end_address & 0xFF);
 	EXIT_IF_ERR(status);
-	status = enc28_do_write_ctl_reg(ctx, ENC28_CR_ETXSTL, ENC28_CONF_TX_ADDRESS_START & 0xFF);
+	status = enc28_do_write_ctl_reg(dev, ENC28_CR_ETXNDH, (end_address >> 8) & 0x1F);
 	EXIT_IF_ERR(status);
-	status = enc28_do_write_ctl_reg(ctx, ENC28_CR_ETXSTH, (ENC28_CONF_TX_ADDRESS_START >> 8) & 0x1F);
+
+	// 5.0 ERRATA: Point 10: transmit logic force reset
+
+	status = enc28_do_set_bits_ctl_reg(dev, ENC28_CR_ECON1, 1 << ENC28_ECON1_TX_RST);
+	EXIT_IF_ERR(status);
+	status = enc28_do_clear_bits_ctl_reg(dev, ENC28_CR_ECON1, 1 << ENC28_ECON1_TX_RST);
+	EXIT_IF_ERR(status);
+
+	// 4.  clear EIR.TXIF, after the reset: clearing TXRST can set EIR.TXERIF, which must not be taken for an error of this frame
+	status = enc28_do_clear_bits_ctl_reg(dev, ENC28_CR_EIR, (1 << ENC28_EIR_TXIF) | (1 << ENC28_EIR_TXERIF));
 	EXIT_IF_ERR(status);
 
+	// 5.  start the transmission by setting ECON1.TXRTS
+	return enc28_do_set_bits_ctl_reg(dev, ENC28_CR_ECON1, 1 << ENC28_ECON1_TXRTS);
+}
+
+ENC28_CommandStatus enc28_write_packet(ENC28_Device *dev, const uint8_t *packet_buf, uint16_t buf_size)
+{
+	const ENC28_Packet_Segment segment = {packet_buf, buf_size};
+	if (!packet_buf)
+	{
+		return ENC28_INVALID_PARAM;
+	}
+	return enc28_write_packet_chain(dev, &segment, 1, NULL);
+}
+
+ENC28_CommandStatus enc28_write_packet_chain(ENC28_Device *dev,
+		const ENC28_Packet_Segment *segments,
+		uint8_t segment_count,
+		const ENC28_Tx_Checksum *csum)
+{
+	uint32_t buf_size = 0;
+
+	if ((!dev) || (!segments))
+	{
+		return ENC28_INVALID_PARAM;
+	}
+
+	for (uint8_t i = 0; i < segment_count; ++i)
+	{
+		if ((!segments[i].data) && (segments[i].len > 0))
+		{
+			return ENC28_INVALID_PARAM;
+		}
+		buf_size += segments[i].len;
+	}
+
+	if ((buf_size < 14) || (buf_size > ENC28_CONF_MAX_FRAME_LEN))
+	{
+		return ENC28_INVALID_PARAM;
+	}
+
+	if (csum && ((csum->len == 0) || ((uint32_t)csum->start + csum->len > buf_size)
+			|| (csum->field < csum->start) || ((uint32_t)csum->field + 2 > (uint32_t)csum->start + csum->len)))
+	{
+		return ENC28_INVALID_PARAM;
+	}
+
+	if (dev->tx_count >= dev->layout.tx_slot_count)
+	{
+		return ENC28_PACKET_TX_IN_PROGRESS;
+	}
+
+	const uint8_t slot = (dev->tx_head + dev->tx_count) % dev->layout.tx_slot_count;
+	const uint16_t start_address = priv_enc28_tx_slot_start(dev, slot);
+
 	// prepare EWRPT
-	status = enc28_do_write_ctl_reg(ctx, ENC28_CR_EWRPTL, ENC28_CONF_TX_ADDRESS_START & 0xFF);
+	ENC28_CommandStatus status = enc28_select_register_bank(dev, 0);
+	EXIT_IF_ERR(status);
+	status = enc28_do_write_ctl_reg(dev, ENC28_CR_EWRPTL, start_address & 0xFF);
 	EXIT_IF_ERR(status);
-	status = enc28_do_write_ctl_reg(ctx, ENC28_CR_EWRPTH, (ENC28_CONF_TX_ADDRESS_START >> 8) & 0x1F);
+	status = enc28_do_write_ctl_reg(dev, ENC28_CR_EWRPTH, (start_address >> 8) & 0x1F);
 	EXIT_IF_ERR(status);
 
 	// 2.1 write the control byte
 	const uint8_t control_code[] = {0x7A, 0}; // WBM ctrl code, transmission ctrl code
 
 	// 2.2 transfer the data using the "WBM" SPI command
-	ctx->nss_pin_op(0);
-	ctx->spi_out_op(control_code, 2);
-	ctx->spi_out_op(packet_buf, buf_size);
-	ctx->nss_pin_op(1);
+	dev->spi.nss_pin_op(0);
+	priv_enc28_spi_out(dev, control_code, 2);
+	for (uint8_t i = 0; i < segment_count; ++i)
+	{
+		if (segments[i].len > 0)
+		{
+			priv_enc28_buffer_out(dev, segments[i].data, segments[i].len);
+		}
+	}
+	dev->spi.nss_pin_op(1);
 
-	const uint16_t end_address = ENC28_CONF_TX_ADDRESS_START + buf_size + 1;
+	if (csum)
+	{
+		// skip the per-packet control byte
+		status = priv_enc28_fill_tx_checksum(dev, start_address + 1, csum);
+		EXIT_IF_ERR(status);
+	}
 
-	// 3.  program ETXND to point to the last byte in the packet
-	status = enc28_do_write_ctl_reg(ctx, ENC28_CR_ETXNDL, end_address & 0xFF);
-	EXIT_IF_ERR(status);
-	status = enc28_do_write_ctl_reg(ctx, ENC28_CR_ETXNDH, (end_address >> 8) & 0x1F);
-	EXIT_IF_ERR(status);
+	dev->tx_len[slot] = buf_size;
+	dev->tx_count++;
+
+	// a frame uploaded while the MAC is busy is started by enc28_check_outgoing_packet_status
+	if (dev->tx_count == 1)
+	{
+		status = priv_enc28_start_transmit(dev, slot);
+		EXIT_IF_ERR(status);
+	}
 
-	// 4.  clear EIR.TXIF
-	status = enc28_do_clear_bits_ctl_reg(ctx, ENC28_CR_EIR, 1 << ENC28_EIR_TXIF);
+	dev->stats.tx_packets++;
+	dev->stats.tx_bytes += buf_size;
+
+	return ENC28_OK;
+}
+
+/* Reads the transmit status vector of the frame in @p slot, bank 0 has to be selected */
+static ENC28_CommandStatus priv_enc28_read_tx_status_vec(ENC28_Device *dev, uint8_t slot, ENC28_Transmit_Status_Vector *status_vec)
+{
+	// the status vector follows the last byte of the frame (ETXND + 1)
+	const uint16_t tsv_addr = priv_enc28_tx_slot_start(dev, slot) + dev->tx_len[slot] + 1;
+
+	ENC28_CommandStatus status = priv_enc28_write_read_ptr(dev, tsv_addr);
 	EXIT_IF_ERR(status);
 
-	// 5.0 ERRATA: Point 10: transmit logic force reset
+	uint8_t command[1 + ENC28_TSV_SIZE] = {0x3A, 0, 0, 0, 0, 0, 0, 0};
+	uint8_t tsv[1 + ENC28_TSV_SIZE] = {0, 0, 0, 0, 0, 0, 0, 0};
+
+	dev->spi.nss_pin_op(0);
+	priv_enc28_spi_in_out(dev, command, tsv, sizeof(command));
+	dev->spi.nss_pin_op(1);
+
+	memcpy(status_vec, tsv + 1, ENC28_TSV_SIZE);
+
+	// restore RDPT, between the calls it always points at the next packet
+	return priv_enc28_write_read_ptr(dev, dev->next_packet_ptr);
+}
+
+/* Collisions the MAC gave up on, errata: the transmit logic may stall afterwards and has to be reset */
+static uint8_t priv_enc28_is_retryable_abort(const ENC28_Transmit_Status_Vector *status_vec, uint8_t estat)
+{
+	return (estat & (1 << ENC28_ESTAT_LATECOL))
+			|| status_vec->status_bits_hi.late_collision
+			|| status_vec->status_bits_hi.excessive_collision;
+}
 
-	status = enc28_do_set_bits_ctl_reg(ctx, ENC28_CR_ECON1, 1 << ENC28_ECON1_TX_RST);
+/*
+ * Reports the oldest frame in flight once EIR.TXIF is set, releases its slot and starts the next queued frame.
+ * @return ENC28_NO_DATA if the frame was aborted and is being sent again
+ * */
+static ENC28_CommandStatus priv_enc28_complete_transmit(ENC28_Device *dev, ENC28_Transmit_Status_Vector *status_vec)
+{
+	uint8_t estat = 0;
+	const uint8_t slot = dev->tx_head;
+
+	ENC28_CommandStatus status = enc28_do_read_ctl_reg(dev, ENC28_CR_ESTAT, &estat);
 	EXIT_IF_ERR(status);
-	status = enc28_do_clear_bits_ctl_reg(ctx, ENC28_CR_ECON1, 1 << ENC28_ECON1_TX_RST);
+	status = enc28_select_register_bank(dev, 0);
 	EXIT_IF_ERR(status);
 
-	// 5.  start the transmission by setting ECON1.TXRTS
-	status = enc28_do_set_bits_ctl_reg(ctx, ENC28_CR_ECON1, 1 << ENC28_ECON1_TXRTS);
+	// acknowledge the frame, TXIF of the next one must not be confused with this one
+	status = enc28_do_clear_bits_ctl_reg(dev, ENC28_CR_EIR, (1 << ENC28_EIR_TXIF) | (1 << ENC28_EIR_TXERIF));
+	EXIT_IF_ERR(status);
+	if (estat & ((1 << ENC28_ESTAT_TXABRT) | (1 << ENC28_ESTAT_LATECOL)))
+	{
+		status = enc28_do_clear_bits_ctl_reg(dev, ENC28_CR_ESTAT, (1 << ENC28_ESTAT_TXABRT) | (1 << ENC28_ESTAT_LATECOL));
+		EXIT_IF_ERR(status);
+	}
 
-	return status;
+	// read before the slot is reused by the next frame
+	status = priv_enc28_read_tx_status_vec(dev, slot, status_vec);
+	EXIT_IF_ERR(status);
+
+	dev->stats.tx_collisions += status_vec->status_bits_lo.collision_count;
+	if (status_vec->status_bits_hi.late_collision)
+	{
+		dev->stats.tx_late_collisions++;
+	}
+	if (status_vec->status_bits_hi.deferred)
+	{
+		dev->stats.tx_deferred++;
+	}
+
+	const uint8_t aborted = (estat & (1 << ENC28_ESTAT_TXABRT)) ? 1 : 0;
+	if (aborted && priv_enc28_is_retryable_abort(status_vec, estat))
+	{
+		if (dev->tx_retry_count < ENC28_CONF_TX_MAX_RETRIES)
+		{
+			// the frame is still in its slot, start it again after the transmit logic reset
+			dev->tx_retry_count++;
+			dev->stats.tx_retries++;
+			status = priv_enc28_start_transmit(dev, slot);
+			EXIT_IF_ERR(status);
+			return ENC28_NO_DATA;
+		}
+		dev->stats.tx_retries_exhausted++;
+	}
+
+	dev->tx_head = (dev->tx_head + 1) % dev->layout.tx_slot_count;
+	dev->tx_count--;
+	dev->tx_retry_count = 0;
+
+	// the next frame is already in the buffer memory, keep the MAC busy
+	if (dev->tx_count > 0)
+	{
+		status = priv_enc28_start_transmit(dev, dev->tx_head);
+		EXIT_IF_ERR(status);
+	}
+
+	if (aborted)
+	{
+		dev->stats.tx_aborted++;
+		return ENC28_PACKET_TX_ABORTED;
+	}
+	return ENC28_OK;
 }
 
-ENC28_CommandStatus enc28_check_outgoing_packet_status(ENC28_SPI_Context *ctx)
+ENC28_CommandStatus enc28_check_outgoing_packet_status(ENC28_Device *dev, ENC28_Transmit_Status_Vector *opt_status_vec)
 {
+	if (!dev)
+	{
+		return ENC28_INVALID_PARAM;
+	}
+
+	if (dev->tx_count == 0)
+	{
+		return ENC28_NO_DATA;
+	}
+
 	uint8_t reg_val = 0;
-	ENC28_CommandStatus status = enc28_do_read_ctl_reg(ctx, ENC28_CR_EIR, &reg_val);
+	ENC28_CommandStatus status = enc28_do_read_ctl_reg(dev, ENC28_CR_EIR, &reg_val);
 	EXIT_IF_ERR(status);
 
 	if (reg_val & (1 << ENC28_EIR_TXIF))
 	{
-		status = enc28_do_read_ctl_reg(ctx, ENC28_CR_ESTAT, &reg_val);
-		EXIT_IF_ERR(status);
-
+		ENC28_Transmit_Status_Vector status_vec;
+		const ENC28_CommandStatus tx_status = priv_enc28_complete_transmit(dev, &status_vec);
+		if (opt_status_vec && (tx_status != ENC28_NO_DATA))
 		{
-			//TODO read the transmission status vector from ETXND + 1
+			*opt_status_vec = status_vec;
+		}
+		return tx_status;
+	}
 
-			uint8_t rdpt_lo = 0;
-			uint8_t rdpt_hi = 0;
-			uint8_t end_addr_lo = 0;
-			uint8_t end_addr_hi = 0;
-			status = enc28_select_register_bank(ctx, 0);
-			EXIT_IF_ERR(status);
+	return ENC28_NO_DATA;
+}
 
-			// backup RDPT
-			status = enc28_do_read_ctl_reg(ctx, ENC28_CR_ERDPTL, &rdpt_lo);
-			EXIT_IF_ERR(status);
-			status = enc28_do_read_ctl_reg(ctx, ENC28_CR_ERDPTH, &rdpt_hi);
-			EXIT_IF_ERR(status);
+static ENC28_CommandStatus priv_enc28_dispatch_interrupts(ENC28_Device *dev, const ENC28_Interrupt_Handlers *handlers, uint8_t eir)
+{
+	ENC28_CommandStatus status = ENC28_OK;
 
-			status = enc28_do_read_ctl_reg(ctx, ENC28_CR_ETXNDL, &end_addr_lo);
-			EXIT_IF_ERR(status);
-			status = enc28_do_read_ctl_reg(ctx, ENC28_CR_ETXNDH, &end_addr_hi);
-			EXIT_IF_ERR(status);
+	// transmit first, a queued frame is started as soon as the previous one is done
+	// TXIF is set for completed and aborted frames alike, TXERIF alone does not mean the frame has left the MAC
+	if ((eir & (1 << ENC28_EIR_TXIF)) && (dev->tx_count > 0))
+	{
+		ENC28_Transmit_Status_Vector status_vec;
+		const ENC28_CommandStatus tx_status = priv_enc28_complete_transmit(dev, &status_vec);
+		if ((tx_status != ENC28_OK) && (tx_status != ENC28_PACKET_TX_ABORTED) && (tx_status != ENC28_NO_DATA))
+		{
+			return tx_status;
+		}
+		// a retransmitted frame is reported when it is done
+		if ((tx_status != ENC28_NO_DATA) && handlers->transmit_done)
+		{
+			handlers->transmit_done(dev, tx_status, &status_vec, handlers->user);
+		}
+	}
+	else if (eir & ((1 << ENC28_EIR_TXIF) | (1 << ENC28_EIR_TXERIF)))
+	{
+		// nothing in flight, or TXERIF alone: a flag left set would keep INT asserted
+		status = enc28_do_clear_bits_ctl_reg(dev, ENC28_CR_EIR, (1 << ENC28_EIR_TXIF) | (1 << ENC28_EIR_TXERIF));
+		EXIT_IF_ERR(status);
+		dev->stats.tx_stray_errors++;
+	}
 
-			uint16_t ctl_vec_addr = (end_addr_lo) | ((end_addr_hi << 8) & 0x1F);
-			ctl_vec_addr += 1;
+	if (eir & (1 << ENC28_EIR_RXERIF))
+	{
+		status = enc28_do_clear_bits_ctl_reg(dev, ENC28_CR_EIR, (1 << ENC28_EIR_RXERIF));
+		EXIT_IF_ERR(status);
+		dev->stats.rx_errors++;
+		if (handlers->receive_error)
+		{
+			handlers->receive_error(dev, handlers->user);
+		}
+	}
 
-			// start reading Transmit Status Vector at TXND + 1
-			status = enc28_do_write_ctl_reg(ctx, ENC28_CR_ERDPTL, ctl_vec_addr & 0xFF);
-			EXIT_IF_ERR(status);
-			status = enc28_do_write_ctl_reg(ctx, ENC28_CR_ERDPTH, (ctl_vec_addr >> 8) & 0x1F);
-			EXIT_IF_ERR(status);
+	// PKTIF is cleared by the hardware once EPKTCNT drops to zero
+	if ((eir & (1 << ENC28_EIR_PKTIF)) && (handlers->packet_pending))
+	{
+		handlers->packet_pending(dev, handlers->user);
+	}
 
-			uint8_t command[1 + 7] = {0x3A, 0, 0, 0, 0, 0, 0, 0};
-			uint8_t hdr[1 + 7] = {0, 0, 0, 0, 0, 0, 0, 0};
+	if (eir & (1 << ENC28_EIR_LINKIF))
+	{
+		// reading PHIR acknowledges the PHY interrupt
+		uint16_t phir = 0;
+		status = enc28_do_read_phy_register(dev, ENC28_PHYR_PHIR, &phir);
+		EXIT_IF_ERR(status);
+		status = enc28_update_link_status(dev, NULL);
+		EXIT_IF_ERR(status);
+		if (handlers->link_changed)
+		{
+			handlers->link_changed(dev, dev->link_up, handlers->user);
+		}
+	}
 
-			ctx->nss_pin_op(0);
-			ctx->spi_in_out_op(command, hdr, 7);
-			ctx->nss_pin_op(1);
+	return ENC28_OK;
+}
 
-			// TODO copy Transmit Status Vector from hdr + 1
+ENC28_CommandStatus enc28_service_interrupts(ENC28_Device *dev, const ENC28_Interrupt_Handlers *handlers, uint8_t *opt_eir)
+{
+	if ((!dev) || (!handlers))
+	{
+		return ENC28_INVALID_PARAM;
+	}
 
-			// restore RDPT
-			status = enc28_do_write_ctl_reg(ctx, ENC28_CR_ERDPTL, rdpt_lo);
-			EXIT_IF_ERR(status);
-			status = enc28_do_write_ctl_reg(ctx, ENC28_CR_ERDPTH, rdpt_hi);
-			EXIT_IF_ERR(status);
+	// datasheet: clear EIE.INTIE while servicing, setting it again re-asserts INT for the causes left pending
+	ENC28_CommandStatus status = enc28_do_clear_bits_ctl_reg(dev, ENC28_CR_EIE, (1 << ENC28_EIE_INTIE));
+	EXIT_IF_ERR(status);
 
+	uint8_t eir = 0;
+	status = enc28_do_read_ctl_reg(dev, ENC28_CR_EIR, &eir);
+	if (status == ENC28_OK)
+	{
+		if (opt_eir)
+		{
+			*opt_eir = eir;
 		}
+		status = priv_enc28_dispatch_interrupts(dev, handlers, eir);
+	}
+
+	// the interrupt has to be enabled again even if servicing failed
+	const ENC28_CommandStatus intie_status = enc28_do_set_bits_ctl_reg(dev, ENC28_CR_EIE, (1 << ENC28_EIE_INTIE));
+	EXIT_IF_ERR(status);
+	return intie_status;
+}
+
+ENC28_CommandStatus enc28_compute_checksum(ENC28_Device *dev, uint16_t start_addr, uint16_t len, uint16_t *checksum)
+{
+	if ((!dev) || (!checksum) || (len == 0) || (start_addr >= ENC28_BUFFER_SIZE))
+	{
+		return ENC28_INVALID_PARAM;
+	}
 
-		if (reg_val & (1 << ENC28_ESTAT_TXABRT))
+	uint16_t end_addr = start_addr + len - 1;
+	if ((start_addr >= dev->layout.rx_start) && (start_addr <= dev->layout.rx_end))
+	{
+		if (len > dev->layout.rx_end - dev->layout.rx_start + 1)
 		{
-			//TODO check EIR.TXIF -> check ESTAT.TXABRT -> check ESTAT.LATECOL
-			return ENC28_PACKET_TX_ABORTED;
+			return ENC28_INVALID_PARAM;
 		}
-		return ENC28_OK;
+		end_addr = priv_enc28_rx_ptr_advance(dev, start_addr, len - 1);
+	}
+	else if (end_addr >= ENC28_BUFFER_SIZE)
+	{
+		return ENC28_INVALID_PARAM;
 	}
 
-	return ENC28_NO_DATA;
+	ENC28_CommandStatus status = enc28_select_register_bank(dev, 0);
+	EXIT_IF_ERR(status);
+	status = enc28_do_write_ctl_reg(dev, ENC28_CR_EDMASTL, start_addr & 0xFF);
+	EXIT_IF_ERR(status);
+	status = enc28_do_write_ctl_reg(dev, ENC28_CR_EDMASTH, (start_addr >> 8) & 0x1F);
+	EXIT_IF_ERR(status);
+	status = enc28_do_write_ctl_reg(dev, ENC28_CR_EDMANDL, end_addr & 0xFF);
+	EXIT_IF_ERR(status);
+	status = enc28_do_write_ctl_reg(dev, ENC28_CR_EDMANDH, (end_addr >> 8) & 0x1F);
+	EXIT_IF_ERR(status);
+
+	status = enc28_do_set_bits_ctl_reg(dev, ENC28_CR_ECON1, (1 << ENC28_ECON1_CSUM_EN) | (1 << ENC28_ECON1_DMA_BUSY));
+	EXIT_IF_ERR(status);
+
+	// the engine clears ECON1.DMAST when done
+	uint8_t reg_val = (1 << ENC28_ECON1_DMA_BUSY);
+	while (reg_val & (1 << ENC28_ECON1_DMA_BUSY))
+	{
+		status = enc28_do_read_ctl_reg(dev, ENC28_CR_ECON1, &reg_val);
+		EXIT_IF_ERR(status);
+	}
+
+	uint8_t csum_lo = 0;
+	uint8_t csum_hi = 0;
+	status = enc28_do_read_ctl_reg(dev, ENC28_CR_EDMACSL, &csum_lo);
+	EXIT_IF_ERR(status);
+	status = enc28_do_read_ctl_reg(dev, ENC28_CR_EDMACSH, &csum_hi);
+	EXIT_IF_ERR(status);
+
+	status = enc28_do_clear_bits_ctl_reg(dev, ENC28_CR_ECON1, 1 << ENC28_ECON1_CSUM_EN);
+	EXIT_IF_ERR(status);
+
+	*checksum = (csum_hi << 8) | csum_lo;
+	return ENC28_OK;
 }
 
-ENC28_CommandStatus enc28_end_packet_transfer(ENC28_SPI_Context *ctx)
+ENC28_CommandStatus enc28_end_packet_transfer(ENC28_Device *dev)
 {
 	const uint8_t mask = (1 << ENC28_ECON1_RXEN);
-	ENC28_CommandStatus status = enc28_select_register_bank(ctx, 0);
+	ENC28_CommandStatus status = enc28_select_register_bank(dev, 0);
 	EXIT_IF_ERR(status);
-	status = enc28_do_clear_bits_ctl_reg(ctx, ENC28_CR_ECON1, mask);
+	status = enc28_do_clear_bits_ctl_reg(dev, ENC28_CR_ECON1, mask);
 	return status;
 }
@@ -143,6 +143,16 @@
 #define ENC28_CR_ERXNDH		(0x0B)		/* Receive buffer address end, high byte */
 #define ENC28_CR_ERXRDPTL	(0x0C)
 #define ENC28_CR_ERXRDPTH	(0x0D)
+#define ENC28_CR_ERXWRPTL	(0x0E)		/* Receive write pointer address, low byte */
+#define ENC28_CR_ERXWRPTH	(0x0F)		/* Receive write pointer address, high byte */
+#define ENC28_CR_EDMASTL	(0x10)		/* DMA start address, low byte */
+#define ENC28_CR_EDMASTH	(0x11)		/* DMA start address, high byte */
+#define ENC28_CR_EDMANDL	(0x12)		/* DMA end address, low byte */
+#define ENC28_CR_EDMANDH	(0x13)		/* DMA end address, high byte */
+#define ENC28_CR_EDMADSTL	(0x14)		/* DMA destination address, low byte */
+#define ENC28_CR_EDMADSTH	(0x15)		/* DMA destination address, high byte */
+#define ENC28_CR_EDMACSL	(0x16)		/* DMA checksum, low byte */
+#define ENC28_CR_EDMACSH	(0x17)		/* DMA checksum, high byte */
 
 #define ENC28_CR_EREVID		(0x12)		/* Ethernet Revision ID */
 
@@ -151,31 +161,80 @@
 #define ENC28_ESTAT_TXABRT	(1)			/* ESTAT transmission aborted bit */
 #define ENC28_ESTAT_LATECOL	(4)			/* ESTAT Late Collision Error bit*/
 
+#define ENC28_CR_EHT0		(0x00)		/* Hash table bits 0..7, EHT1..EHT7 follow at 0x01..0x07 */
+#define ENC28_HASH_TABLE_SIZE	(8)		/* Size of the hash table filter in bytes */
+
+#define ENC28_CR_EPMM0		(0x08)		/* Pattern match mask bits 0..7, EPMM1..EPMM7 follow at 0x09..0x0F */
+#define ENC28_CR_EPMCSL		(0x10)		/* Pattern match checksum, low byte */
+#define ENC28_CR_EPMCSH		(0x11)		/* Pattern match checksum, high byte */
+#define ENC28_CR_EPMOL		(0x14)		/* Pattern match offset, low byte */
+#define ENC28_CR_EPMOH		(0x15)		/* Pattern match offset, high byte */
+#define ENC28_PATTERN_WINDOW_SIZE	(64)	/* Bytes covered by the pattern match mask */
+
 #define ENC28_CR_ERXFCON	(0x18)		/* Packet filter register */
 #define ENC28_ERXFCON_UNI	(1 << 7)	/* Unicast packet filter bit */
 #define ENC28_ERXFCON_ANDOR	(1 << 6)	/* AND/OR filter selection bit */
 #define ENC28_ERXFCON_CRC	(1 << 5)	/* Post-filter CRC check bit */
+#define ENC28_ERXFCON_PM	(1 << 4)	/* Pattern match filter bit */
+#define ENC28_ERXFCON_MP	(1 << 3)	/* Magic Packet filter bit */
+#define ENC28_ERXFCON_HT	(1 << 2)	/* Hash table filter bit */
 #define ENC28_ERXFCON_MULTI	(1 << 1)	/* Multicast packet filter bit */
 #define ENC28_ERXFCON_BCAST	(1 << 0)	/* Broadcast packet filter bit */
 
 #define ENC28_PHYR_PHCON1	(0x0)		/* PHY register PHCON1 */
 #define ENC28_PHCON1_PDPXMD	(8)			/* PHCON1 Duplex Mode bit */
 
+#define ENC28_PHYR_PHSTAT1	(0x1)		/* PHY status register 1 */
+#define ENC28_PHSTAT1_LLSTAT	(2)		/* PHSTAT1 latching Link Status bit */
+
 #define ENC28_PHYR_PHID1	(0x2)		/* PHY register, partnum1 */
 #define ENC28_PHYR_PHID2	(0x3)		/* PHY register, partnum2 */
+#define ENC28_PHYR_PHSTAT2	(0x11)		/* PHY status register 2 */
+#define ENC28_PHSTAT2_DPXSTAT	(9)		/* PHSTAT2 Duplex Status bit */
+#define ENC28_PHSTAT2_LSTAT	(10)		/* PHSTAT2 Link Status bit */
+
+#define ENC28_PHYR_PHIE		(0x12)		/* PHY interrupt enable register */
+#define ENC28_PHIE_PGEIE	(1)			/* PHIE global PHY interrupt enable bit */
+#define ENC28_PHIE_PLNKIE	(4)			/* PHIE link change interrupt enable bit */
+
+#define ENC28_PHYR_PHIR		(0x13)		/* PHY interrupt request register, cleared by reading */
+#define ENC28_PHIR_PGIF		(2)			/* PHIR global PHY interrupt flag */
+#define ENC28_PHIR_PLNKIF	(4)			/* PHIR link change interrupt flag */
+
 #define ENC28_PHYR_PHLCON	(0x14)		/*  */
 
+/* Size of the buffer memory */
+#define ENC28_BUFFER_SIZE	(0x2000)
+
 /* Customization constants */
-#ifndef ENC28_CONF_RX_ADDRESS_START
-#define ENC28_CONF_RX_ADDRESS_START	(0x7D0)	/* Default start address of the packet receive buffer */
+#ifndef ENC28_CONF_TX_SLOT_COUNT
+#define ENC28_CONF_TX_SLOT_COUNT	(2)		/* Default number of frames held in the transmit buffer at the same time */
 #endif
 
-#ifndef ENC28_CONF_RX_ADDRESS_END
-#define ENC28_CONF_RX_ADDRESS_END	(0x1eff)	/* Default end address of the packet receive buffer */
+#ifndef ENC28_CONF_TX_MAX_SLOTS
+#define ENC28_CONF_TX_MAX_SLOTS	(4)		/* Upper limit of ENC28_Buffer_Layout.tx_slot_count */
 #endif
 
+/* Size of the transmit status vector written after each frame */
+#define ENC28_TSV_SIZE		(7)
+
+/* Size of one transmit slot: per-packet control byte, frame and transmit status vector */
+#define ENC28_TX_SLOT_SIZE	(1 + ENC28_CONF_MAX_FRAME_LEN + ENC28_TSV_SIZE)
+
 #ifndef ENC28_CONF_TX_ADDRESS_START
-#define ENC28_CONF_TX_ADDRESS_START (0x1D)
+#define ENC28_CONF_TX_ADDRESS_START (ENC28_BUFFER_SIZE - ENC28_CONF_TX_SLOT_COUNT * ENC28_TX_SLOT_SIZE)	/* Transmit slots fill the end of the buffer memory */
+#endif
+
+#ifndef ENC28_CONF_RX_ADDRESS_START
+#define ENC28_CONF_RX_ADDRESS_START	(0x0)	/* Default start address of the packet receive buffer */
+#endif
+
+#if ENC28_CONF_RX_ADDRESS_START != 0
+#error "ENC28_CONF_RX_ADDRESS_START must be 0, see enc28_check_buffer_layout"
+#endif
+
+#ifndef ENC28_CONF_RX_ADDRESS_END
+#define ENC28_CONF_RX_ADDRESS_END	(ENC28_CONF_TX_ADDRESS_START - 1)	/* Default end address of the packet receive buffer */
 #endif
 
 #ifndef ENC28_CONF_PACKET_FILTER_MASK
@@ -206,6 +265,14 @@
 #define ENC28_CONF_MAIPGH_BITS (0x0C)
 #endif
 
+#ifndef ENC28_CONF_TX_MAX_RETRIES
+#define ENC28_CONF_TX_MAX_RETRIES (3)	/* Retransmissions of a frame aborted by a late or excessive collision, 0 disables the retry */
+#endif
+
+#ifndef ENC28_CONF_SPI_ASYNC_MIN_LEN
+#define ENC28_CONF_SPI_ASYNC_MIN_LEN (64)	/* Shorter buffer transfers use the blocking SPI callbacks */
+#endif
+
 typedef enum
 {
 	ENC28_OK,
@@ -226,8 +293,68 @@ typedef struct
 	void (*spi_in_op)(uint8_t *buff, size_t len);
 	void (*spi_in_out_op)(const uint8_t *tx, uint8_t *rx, size_t len);
 	void (*wait_nano)(uint32_t);
+
+	/* Optional asynchronous (DMA) buffer transfers, NULL selects the blocking callbacks.
+	 * The op starts the transfer and returns, spi_async_wait_op blocks until the transfer has completed. */
+	void (*spi_out_async_op)(const uint8_t *buff, size_t len);
+	void (*spi_in_async_op)(uint8_t *buff, size_t len);
+	void (*spi_async_wait_op)(void);
 } ENC28_SPI_Context;
 
+/*
+ * Driver statistics, maintained per device
+ * */
+typedef struct
+{
+	uint32_t spi_bytes;		/* Bytes clocked over the SPI bus, commands and register accesses included */
+	uint32_t rx_packets;	/* Packets read from the receive buffer */
+	uint32_t rx_bytes;		/* Bytes read from the receive buffer */
+	uint32_t rx_errors;		/* Receive errors (bad status vector, buffer overflow) */
+	uint32_t rx_too_long;	/* Packets dropped because they did not fit in the output buffer, also counted in rx_errors */
+	uint32_t tx_packets;	/* Packets queued for transmission */
+	uint32_t tx_bytes;		/* Bytes queued for transmission */
+	uint32_t tx_aborted;	/* Transmissions aborted by the MAC */
+	uint32_t tx_collisions;	/* Collisions seen by the transmitted frames, from the transmit status vectors */
+	uint32_t tx_late_collisions;	/* Frames hit by a late collision */
+	uint32_t tx_deferred;	/* Frames deferred because the medium was busy */
+	uint32_t tx_retries;	/* Retransmissions started by the driver after an aborted transmission */
+	uint32_t tx_retries_exhausted;	/* Frames dropped after ENC28_CONF_TX_MAX_RETRIES retransmissions */
+	uint32_t tx_stray_errors;	/* EIR.TXERIF without EIR.TXIF, or EIR.TXIF with no frame in flight, cleared without completing a frame */
+	uint32_t link_changes;	/* Link status changes reported by the PHY */
+	uint32_t duplex_changes;	/* MAC reconfigurations after the PHY duplex mode has changed */
+} ENC28_Device_Stats;
+
+/*
+ * Split of the 8 KB buffer memory between the receive ring and the transmit slots,
+ * see enc28_check_buffer_layout for the constraints
+ * */
+typedef struct
+{
+	uint16_t rx_start;		/* First address of the receive ring */
+	uint16_t rx_end;		/* Last address of the receive ring */
+	uint16_t tx_start;		/* First address of the transmit slots */
+	uint8_t tx_slot_count;	/* Number of transmit slots of ENC28_TX_SLOT_SIZE bytes */
+} ENC28_Buffer_Layout;
+
+/*
+ * Driver state of a single ENC28J60 module. Each module needs its own handle,
+ * handles are independent of each other.
+ * */
+typedef struct
+{
+	ENC28_SPI_Context spi;		/* SPI communication context */
+	uint8_t curr_bank;			/* Shadow copy of ECON1.BSEL, valid after enc28_do_soft_reset and updated by the ECON1 writes */
+	uint16_t next_packet_ptr;	/* Address of the next packet in the receive buffer, ERDPT points here between the calls */
+	ENC28_Buffer_Layout layout;	/* Buffer memory layout, set by enc28_do_init */
+	uint16_t tx_len[ENC28_CONF_TX_MAX_SLOTS];	/* Length of the frame held in each transmit slot */
+	uint8_t tx_head;			/* Transmit slot of the oldest frame, the one being sent */
+	uint8_t tx_count;			/* Frames uploaded and not yet reported by enc28_check_outgoing_packet_status */
+	uint8_t tx_retry_count;		/* Retransmissions of the frame at tx_head */
+	uint8_t link_up;			/* Link status read from PHSTAT2.LSTAT by enc28_update_link_status */
+	uint8_t full_duplex;		/* Duplex mode the MAC is configured for */
+	ENC28_Device_Stats stats;	/* Driver statistics */
+} ENC28_Device;
+
 typedef struct
 {
 	uint8_t addr[6];
@@ -278,36 +405,186 @@ typedef struct
 
 _Static_assert(sizeof(ENC28_Receive_Status_Vector) == 4);
 
+typedef struct
+{
+	uint8_t collision_count: 4;
+	uint8_t crc_err: 1;
+	uint8_t len_check_err: 1;
+	uint8_t len_out_of_range: 1;
+	uint8_t done: 1;
+} ENC28_Transmit_Status_Vec_Bits_16_23;
+
+_Static_assert(sizeof(ENC28_Transmit_Status_Vec_Bits_16_23) == 1);
+
+typedef struct
+{
+	uint8_t multicast: 1;
+	uint8_t broadcast: 1;
+	uint8_t deferred: 1;
+	uint8_t excessive_defer: 1;
+	uint8_t excessive_collision: 1;
+	uint8_t late_collision: 1;
+	uint8_t giant: 1;
+	uint8_t underrun: 1;
+} ENC28_Transmit_Status_Vec_Bits_24_31;
+
+_Static_assert(sizeof(ENC28_Transmit_Status_Vec_Bits_24_31) == 1);
+
+typedef struct
+{
+	uint8_t ctrl_frame: 1;
+	uint8_t pause_ctrl_frame: 1;
+	uint8_t backpressure: 1;
+	uint8_t vlan_type: 1;
+	uint8_t zero: 4;
+} ENC28_Transmit_Status_Vec_Bits_48_55;
+
+_Static_assert(sizeof(ENC28_Transmit_Status_Vec_Bits_48_55) == 1);
+
+/*
+ * Transmit status vector written by the module after the frame.
+ * The byte count excludes the collided attempts, the wire byte count includes them.
+ * */
+typedef struct
+{
+	uint8_t byte_count_lo;
+	uint8_t byte_count_hi;
+	ENC28_Transmit_Status_Vec_Bits_16_23 status_bits_lo;
+	ENC28_Transmit_Status_Vec_Bits_24_31 status_bits_hi;
+	uint8_t wire_byte_count_lo;
+	uint8_t wire_byte_count_hi;
+	ENC28_Transmit_Status_Vec_Bits_48_55 status_bits_ext;
+} ENC28_Transmit_Status_Vector;
+
+_Static_assert(sizeof(ENC28_Transmit_Status_Vector) == ENC28_TSV_SIZE);
+
+/*
+ * Checksum filled in by the DMA checksum engine after the frame has been uploaded, see enc28_write_packet_chain.
+ * Offsets are relative to the first byte of the frame (destination MAC).
+ * */
+typedef struct
+{
+	uint16_t start;		/* First byte of the checksummed range */
+	uint16_t len;		/* Size of the checksummed range */
+	uint16_t field;		/* The 16-bit checksum field, inside the range, has to be 0 in the uploaded frame */
+	uint16_t seed;		/* Ones' complement sum added to the range, e.g. the pseudo header sum, 0 if not used */
+} ENC28_Tx_Checksum;
+
+/*
+ * Pattern match filter configuration, see enc28_build_pattern_match
+ * */
+typedef struct
+{
+	uint16_t offset;		/* EPMO: start of the 64 byte window, counted from the first byte of the frame */
+	uint8_t mask[ENC28_PATTERN_WINDOW_SIZE / 8];	/* EPMM0..EPMM7: bit N selects byte N of the window */
+	uint16_t checksum;		/* EPMCS: checksum of the selected bytes of a matching frame */
+} ENC28_Pattern_Match;
+
+/*
+ * Handlers of the interrupt causes serviced by enc28_service_interrupts, NULL entries are skipped
+ * */
+typedef struct
+{
+	void (*packet_pending)(ENC28_Device *dev, void *user);	/* EIR.PKTIF: frames are waiting in the receive buffer */
+	void (*transmit_done)(ENC28_Device *dev, ENC28_CommandStatus tx_status,
+			const ENC28_Transmit_Status_Vector *status_vec, void *user);	/* EIR.TXIF: the oldest frame in flight is done, ENC28_OK or ENC28_PACKET_TX_ABORTED */
+	void (*receive_error)(ENC28_Device *dev, void *user);	/* EIR.RXERIF: incoming frames were dropped */
+	void (*link_changed)(ENC28_Device *dev, uint8_t link_up, void *user);	/* EIR.LINKIF: the PHY link status has changed, dev->link_up is already updated */
+	void *user;												/* User data passed to the handlers */
+} ENC28_Interrupt_Handlers;
+
+/*
+ * Supplies the receive buffers to enc28_read_packets_sized, sized from the receive status vector
+ * */
+typedef struct
+{
+	uint8_t *(*alloc)(uint16_t packet_len, void *user);	/* Returns a buffer of at least packet_len bytes, NULL leaves the frame in the receive buffer */
+	uint16_t max_len;										/* Longer frames are dropped without calling alloc */
+	void *user;												/* User data passed to alloc */
+} ENC28_Rx_Buffer_Provider;
+
+/*
+ * Part of an outgoing Ethernet packet, see enc28_write_packet_chain
+ * */
+typedef struct
+{
+	const uint8_t *data;	/* Segment payload */
+	uint16_t len;			/* Size of @p data in bytes, may be 0 */
+} ENC28_Packet_Segment;
+
+/**
+ * @brief Initializes the device handle. Does not communicate with the module.
+ * @param dev The device handle
+ * @param ctx The SPI communication context, copied into the handle
+ * @return Status of the operation
+ * @note Buffer memory transfers of at least ENC28_CONF_SPI_ASYNC_MIN_LEN bytes go through the async callbacks when they are set,
+ * spi_async_wait_op is then required.
+ * */
+extern ENC28_CommandStatus enc28_init_device(ENC28_Device *dev, const ENC28_SPI_Context *ctx);
+
+/**
+ * @brief Fills in the default buffer layout, built from the ENC28_CONF_RX_ADDRESS_* and ENC28_CONF_TX_* constants
+ * @param layout The layout to fill in
+ * */
+extern void enc28_default_buffer_layout(ENC28_Buffer_Layout *layout);
+
+/**
+ * @brief Fills in a layout with @p tx_slot_count transmit slots at the end of the buffer memory and the receive ring in the rest
+ * @param layout The layout to fill in
+ * @param tx_slot_count Number of transmit slots [1:ENC28_CONF_TX_MAX_SLOTS]
+ * @return Status of the operation
+ * */
+extern ENC28_CommandStatus enc28_make_buffer_layout(ENC28_Buffer_Layout *layout, uint8_t tx_slot_count);
+
+/**
+ * @brief Validates the buffer layout
+ * @param layout The layout to check
+ * @return ENC28_OK if the layout can be used, ENC28_INVALID_PARAM otherwise
+ * @note The receive ring has to start at address 0 and end at an odd address, hold at least one frame of ENC28_CONF_MAX_FRAME_LEN
+ * bytes and must not overlap the transmit slots. Errata: writing ERXST or ERXND can load 0 into the internal receive write pointer
+ * instead of ERXST, the workaround is a ring at the bottom of the buffer memory. ERXRDPT must be odd, packets start at even addresses.
+ * */
+extern ENC28_CommandStatus enc28_check_buffer_layout(const ENC28_Buffer_Layout *layout);
+
+/**
+ * @brief Computes how many frames of the given size the receive ring holds
+ * @param layout The buffer layout
+ * @param frame_len Size of the frame without the CRC
+ * @return Number of frames
+ * */
+extern uint16_t enc28_rx_capacity_frames(const ENC28_Buffer_Layout *layout, uint16_t frame_len);
+
 /**
  * @brief Performs the initialisation sequence.
  * @param mac_add The MAC address to initialize the interface with
- * @param ctx The SPI communication context
+ * @param layout The buffer memory layout, NULL selects the default layout
+ * @param dev The device handle
  * @return Status of the operation
  * */
-extern ENC28_CommandStatus enc28_do_init(const ENC28_MAC_Address mac_add, ENC28_SPI_Context *ctx);
+extern ENC28_CommandStatus enc28_do_init(const ENC28_MAC_Address mac_add, const ENC28_Buffer_Layout *layout, ENC28_Device *dev);
 
 /**
  * @brief Sends the reset command
- * @param ctx The SPI communication context
+ * @param dev The device handle
  * @return Status of the operation
  * */
-extern ENC28_CommandStatus enc28_do_soft_reset(ENC28_SPI_Context *ctx);
+extern ENC28_CommandStatus enc28_do_soft_reset(ENC28_Device *dev);
 
 /**
  * @brief Reads the PHY hardware ID registers
- * @param ctx The SPI communication context
+ * @param dev The device handle
  * @param hw_rev Pointer to the HW revision struct which is filled with the contents of the PHY registers
  * @return Status of the operation
  * */
-extern ENC28_CommandStatus enc28_do_read_hw_rev(ENC28_SPI_Context *ctx, ENC28_HW_Rev *hw_rev);
+extern ENC28_CommandStatus enc28_do_read_hw_rev(ENC28_Device *dev, ENC28_HW_Rev *hw_rev);
 
 /**
  * @brief Reads the internal MAC address registers
- * @param ctx The SPI communication context
+ * @param dev The device handle
  * @param mac The output mac address
  * @return Status of the operation
  * */
-extern ENC28_CommandStatus enc28_do_read_mac(ENC28_SPI_Context *ctx, ENC28_MAC_Address *mac);
+extern ENC28_CommandStatus enc28_do_read_mac(ENC28_Device *dev, ENC28_MAC_Address *mac);
 
 /**
  *  @brief Prepares the "register read" command for the specified control register.
@@ -319,12 +596,12 @@ extern ENC28_CommandStatus enc28_prepare_read_ctl_reg(uint8_t *out, uint8_t reg_
 
 /**
  * @brief Reads the value of control register
- * @param ctx The SPI communication context
+ * @param dev The device handle
  * @param reg_id The ID of the register to read
  * @param reg_value The value of the register
  * @return Status of the operation
  * */
-extern ENC28_CommandStatus enc28_do_read_ctl_reg(ENC28_SPI_Context *ctx, uint8_t reg_id, uint8_t *reg_value);
+extern ENC28_CommandStatus enc28_do_read_ctl_reg(ENC28_Device *dev, uint8_t reg_id, uint8_t *reg_value);
 
 /**
  * @brief Prepares the "register write" command for the specified control register
@@ -337,12 +614,12 @@ extern ENC28_CommandStatus enc28_prepare_write_ctl_reg(uint16_t *out, uint8_t re
 
 /**
  * @brief Writes the value of the control register
- * @param ctx The SPI communication context
+ * @param dev The device handle
  * @param reg_id The register ID
  * @param reg_value The value to write
  * @return Status of the operation
  * */
-extern ENC28_CommandStatus enc28_do_write_ctl_reg(ENC28_SPI_Context *ctx, uint8_t reg_id, uint8_t reg_value);
+extern ENC28_CommandStatus enc28_do_write_ctl_reg(ENC28_Device *dev, uint8_t reg_id, uint8_t reg_value);
 
 /**
  * @brief Prepares the "Set Bits" command for the specified register
@@ -364,74 +641,216 @@ extern ENC28_CommandStatus enc28_prepare_clear_bits_ctl_reg(uint16_t *out, uint8
 
 /**
  * @brief Sets the bits of the specified register
- * @param ctx The SPI communication context
+ * @param dev The device handle
  * @param reg_id The register ID
  * @param mask The bits to set
  * @return Status of the operation
  * */
-extern ENC28_CommandStatus enc28_do_set_bits_ctl_reg(ENC28_SPI_Context *ctx, uint8_t reg_id, uint8_t mask);
+extern ENC28_CommandStatus enc28_do_set_bits_ctl_reg(ENC28_Device *dev, uint8_t reg_id, uint8_t mask);
 
 /**
  * @brief Clears the bits of the specified register
- * @param ctx The SPI communication context
+ * @param dev The device handle
  * @param reg_id The register ID
  * @param mask The bits to clear
  * @return Status of the operation
  * */
-extern ENC28_CommandStatus enc28_do_clear_bits_ctl_reg(ENC28_SPI_Context *ctx, uint8_t reg_id, uint8_t mask);
+extern ENC28_CommandStatus enc28_do_clear_bits_ctl_reg(ENC28_Device *dev, uint8_t reg_id, uint8_t mask);
 
 /**
  * @brief Selects the specified register bank
- * @param ctx The SPI communication context
+ * @param dev The device handle
  * @param bank_id The register bank ID to activate [0:3]
+ * @note The selected bank is cached by the driver, no SPI transaction is issued if @p bank_id is already active
  * */
-extern ENC28_CommandStatus enc28_select_register_bank(ENC28_SPI_Context *ctx, const uint8_t bank_id);
+extern ENC28_CommandStatus enc28_select_register_bank(ENC28_Device *dev, const uint8_t bank_id);
 
 /**
  * @brief Reads the content of the specified PHY register
- * @param ctx The communication context
+ * @param dev The device handle
  * @param reg_id The PHY register ID
  * @param reg_value The output value
  * @return The status of the operation
  * */
-extern ENC28_CommandStatus enc28_do_read_phy_register(ENC28_SPI_Context *ctx, uint8_t reg_id, uint16_t *reg_value);
+extern ENC28_CommandStatus enc28_do_read_phy_register(ENC28_Device *dev, uint8_t reg_id, uint16_t *reg_value);
+
+/**
+ * @brief Writes the value to the specified PHY register
+ * @param dev The device handle
+ * @param reg_id The PHY register ID
+ * @param reg_value The value to write
+ * @return The status of the operation
+ * */
+extern ENC28_CommandStatus enc28_do_write_phy_register(ENC28_Device *dev, uint8_t reg_id, uint16_t reg_value);
+
+/**
+ * @brief Reads the link status from PHSTAT2 and reconfigures the MAC if the PHY duplex mode has changed
+ * @param dev The device handle
+ * @param opt_link_up Output link status (1 = link up), can be NULL
+ * @return The status of the operation
+ * @note Called by enc28_service_interrupts on EIR.LINKIF, call it once after enc28_begin_packet_transfer to get the initial state
+ * */
+extern ENC28_CommandStatus enc28_update_link_status(ENC28_Device *dev, uint8_t *opt_link_up);
+
+/**
+ * @brief Computes the position of the MAC address in the hash table filter
+ * @param mac_addr The destination MAC address
+ * @return Bit index [0:63], bits 28:23 of the CRC-32 of the address
+ * */
+extern uint8_t enc28_hash_table_index(const uint8_t mac_addr[6]);
+
+/**
+ * @brief Programs the hash table filter (EHT0..EHT7) and switches the multicast reception over to it
+ * @param dev The device handle
+ * @param table The hash table, bit N of the table (byte N / 8, bit N % 8) accepts the addresses with hash index N
+ * @return The status of the operation
+ * @note ERXFCON.HTEN is set and ERXFCON.MCEN is cleared, multicast frames are accepted only if their hash bit is set
+ * */
+extern ENC28_CommandStatus enc28_write_hash_table(ENC28_Device *dev, const uint8_t table[ENC28_HASH_TABLE_SIZE]);
+
+/**
+ * @brief Builds the pattern match configuration accepting the frames equal to @p template_frame on the bytes selected by @p byte_mask.
+ * The window starts at the first selected byte.
+ * @param template_frame Example of a matching frame, starting with the destination MAC address
+ * @param byte_mask One entry per byte of @p template_frame, non-zero entries have to match
+ * @param len The size of @p template_frame and @p byte_mask
+ * @param pm The output configuration
+ * @return ENC28_INVALID_PARAM if no byte is selected or the selected bytes do not fit in a window of ENC28_PATTERN_WINDOW_SIZE bytes
+ * @note The module compares a checksum of the selected bytes, unrelated frames can pass by a checksum collision
+ * */
+extern ENC28_CommandStatus enc28_build_pattern_match(const uint8_t *template_frame, const uint8_t *byte_mask, uint16_t len, ENC28_Pattern_Match *pm);
+
+/**
+ * @brief Programs the pattern match filter (EPMM, EPMCS, EPMO) and enables it with ERXFCON.PMEN
+ * @param dev The device handle
+ * @param pm The filter configuration
+ * @param clear_filters ERXFCON bits to clear, e.g. ENC28_ERXFCON_BCAST to accept only the broadcast frames matching the pattern.
+ * Broadcast frames also pass ERXFCON.MCEN.
+ * @return The status of the operation
+ * */
+extern ENC28_CommandStatus enc28_write_pattern_match(ENC28_Device *dev, const ENC28_Pattern_Match *pm, uint8_t clear_filters);
 
 /**
  * @brief Initializes the ETH packet transfer
- * @param ctx The SPI communication context
+ * @param dev The device handle
  * @return Status of the operation
  * */
-extern ENC28_CommandStatus enc28_begin_packet_transfer(ENC28_SPI_Context *ctx);
+extern ENC28_CommandStatus enc28_begin_packet_transfer(ENC28_Device *dev);
 
 /**
  * @brief Attempts to read one incoming ETH packet
- * @param ctx The SPI communication context
+ * @param dev The device handle
  * @param packet_buf The output buffer
  * @param buf_size The output buffer size
  * @param opt_status_vec The status vector, can be NULL
+ * @note Packets which cannot be read (ENC28_PACKET_RCV_ERR, ENC28_BUFFER_TOO_SMALL) are dropped from the receive buffer
  * */
-extern ENC28_CommandStatus enc28_read_packet(ENC28_SPI_Context *ctx, uint8_t *packet_buf, uint16_t buf_size, ENC28_Receive_Status_Vector *opt_status_vec);
+extern ENC28_CommandStatus enc28_read_packet(ENC28_Device *dev, uint8_t *packet_buf, uint16_t buf_size, ENC28_Receive_Status_Vector *opt_status_vec);
+
+/**
+ * @brief Reads all pending ETH packets, up to @p max_packets, in one call
+ * @param dev The device handle
+ * @param packet_bufs Array of @p max_packets output buffers
+ * @param buf_size The size of each output buffer
+ * @param status_vecs Array of @p max_packets status vectors, filled in for the packets returned
+ * @param max_packets Maximum number of packets to read
+ * @param packets_read Number of packets stored in @p packet_bufs
+ * @return ENC28_OK if at least one packet was read, ENC28_NO_DATA if the receive buffer is empty
+ * @note EPKTCNT is read once and the receive buffer space is released once for the whole burst.
+ * Packets which cannot be read are dropped and do not occupy a slot in @p packet_bufs.
+ * */
+extern ENC28_CommandStatus enc28_read_packets_burst(ENC28_Device *dev,
+		uint8_t *const *packet_bufs,
+		uint16_t buf_size,
+		ENC28_Receive_Status_Vector *status_vecs,
+		uint8_t max_packets,
+		uint8_t *packets_read);
+
+/**
+ * @brief Reads all pending ETH packets, up to @p max_packets, into buffers requested from @p provider.
+ * The length of each frame is taken from its receive status vector before the buffer is requested.
+ * @param dev The device handle
+ * @param provider Source of the output buffers, called once per packet read
+ * @param status_vecs Array of @p max_packets status vectors, filled in for the packets returned
+ * @param max_packets Maximum number of packets to read
+ * @param packets_read Number of packets stored in the buffers returned by @p provider
+ * @return ENC28_OK if at least one packet was read, ENC28_NO_DATA if the receive buffer is empty
+ * or there is no buffer for the first pending frame
+ * @note Reading stops at the first frame @p provider has no buffer for, the frame stays in the receive buffer.
+ * */
+extern ENC28_CommandStatus enc28_read_packets_sized(ENC28_Device *dev,
+		const ENC28_Rx_Buffer_Provider *provider,
+		ENC28_Receive_Status_Vector *status_vecs,
+		uint8_t max_packets,
+		uint8_t *packets_read);
 
 /**
  * @brief Sends the data packet
- * @param ctx The SPI communication context
+ * @param dev The device handle
  * @param packet_buf The Ethernet packet to send (Destination MAC | Source MAC | Type/Length | Payload)
  * @param buf_size The size of @p packet_buf
+ * @return ENC28_PACKET_TX_IN_PROGRESS if all transmit slots are in use
  * @note This is a non-blocking call. @see enc28_check_outgoing_packet_status
  * */
-extern ENC28_CommandStatus enc28_write_packet(ENC28_SPI_Context *ctx, const uint8_t *packet_buf, uint16_t buf_size);
+extern ENC28_CommandStatus enc28_write_packet(ENC28_Device *dev, const uint8_t *packet_buf, uint16_t buf_size);
+
+/**
+ * @brief Sends the data packet assembled from a list of segments
+ * @param dev The device handle
+ * @param segments The parts of the Ethernet packet, in order
+ * @param segment_count Number of entries in @p segments
+ * @param csum Optional checksum computed by the module before the frame is sent, NULL if not used
+ * @return Status of the operation
+ * @note All segments are streamed into the transmit buffer in one WBM transaction, the caller
+ * has to keep the segment data valid only until this call returns.
+ * The frame is uploaded to a free transmit slot while the previous one is still being sent, and queued behind it.
+ * This is a non-blocking call. @see enc28_check_outgoing_packet_status
+ * */
+extern ENC28_CommandStatus enc28_write_packet_chain(ENC28_Device *dev,
+		const ENC28_Packet_Segment *segments,
+		uint8_t segment_count,
+		const ENC28_Tx_Checksum *csum);
+
+/**
+ * @brief Computes the Internet checksum (RFC 1071) of a range of the buffer memory with the DMA checksum engine
+ * @param dev The device handle
+ * @param start_addr Address of the first byte
+ * @param len Number of bytes, the range wraps around the end of the receive ring like the receive buffer reads
+ * @param checksum The one's complement of the one's complement sum, in network byte order representation (first byte in the high bits)
+ * @return Status of the operation
+ * @note Blocks until the engine is done.
+ * */
+extern ENC28_CommandStatus enc28_compute_checksum(ENC28_Device *dev, uint16_t start_addr, uint16_t len, uint16_t *checksum);
 
 /**
  * @brief Query the output packet status
- * @note This function should be used after the application receives the interrupt on the INT pin of ENC28 device
+ * @param dev The device handle
+ * @param opt_status_vec Optional output, the transmit status vector of the reported frame
+ * @return Status of the oldest frame in flight: ENC28_OK or ENC28_PACKET_TX_ABORTED once it is done, ENC28_NO_DATA otherwise
+ * @note This function should be used after the application receives the interrupt on the INT pin of ENC28 device.
+ * A frame aborted by a late or excessive collision is sent again up to ENC28_CONF_TX_MAX_RETRIES times before
+ * it is reported as ENC28_PACKET_TX_ABORTED, ENC28_NO_DATA is returned while the retransmission is in progress.
+ * Each frame is reported once, in the order of the enc28_write_packet calls. The transmit slot is released and the next queued frame is started.
+ * */
+extern ENC28_CommandStatus enc28_check_outgoing_packet_status(ENC28_Device *dev, ENC28_Transmit_Status_Vector *opt_status_vec);
+
+/**
+ * @brief Services the pending interrupt causes of the device
+ * @param dev The device handle
+ * @param handlers Handlers called for the causes found in EIR
+ * @param opt_eir Optional output, the value of EIR read on entry
+ * @return Status of the operation
+ * @note EIR is read once per call. EIE.INTIE is cleared for the duration of the call, causes still pending
+ * when it is set again assert the INT pin once more, so no interrupt edge is lost.
+ * Transmit completion is handled as in enc28_check_outgoing_packet_status, RXERIF is acknowledged.
  * */
-extern ENC28_CommandStatus enc28_check_outgoing_packet_status(ENC28_SPI_Context *ctx);
+extern ENC28_CommandStatus enc28_service_interrupts(ENC28_Device *dev, const ENC28_Interrupt_Handlers *handlers, uint8_t *opt_eir);
 
 /**
  * @brief Stops the ETH packet transfer
- * @param ctx The SPI communication context
+ * @param dev The device handle
  * @return Status of the operation
  * */
-extern ENC28_CommandStatus enc28_end_packet_transfer(ENC28_SPI_Context *ctx);
+extern ENC28_CommandStatus enc28_end_packet_transfer(ENC28_Device *dev);
 
 #endif /* INC_ENC28J60_H_ */
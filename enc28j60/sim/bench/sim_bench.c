@@ -0,0 +1,250 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Sebastian Baginski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * sim_bench.c
+ *
+ * SPI cost of the driver operations, counted by the simulator: transactions
+ * (chip-select assertions) and bytes clocked per frame received, sent and
+ * checksummed, and the frames kept off the bus by the receive filters.
+ * The counts depend only on the driver and the model, not on the host.
+ * */
+
+#include "tests/sim_test.h"
+
+#define TCP_OFFSET		(14 + 20)
+#define TCP_CSUM_OFFSET	(TCP_OFFSET + 16)
+#define MTU_TCP_LEN		(1480)
+#define BURST_FRAMES	(8)
+#define FILTER_FRAMES	(40)
+#define SPI_CLOCK_HZ	(20000000u)
+
+static ENC28_Sim_Device sim;
+static ENC28_SPI_Context ctx;
+static ENC28_Device dev;
+
+static void report_spi(const char *what, uint32_t frames)
+{
+	printf("%-54s %5u transactions %6u bytes", what, (unsigned)sim.stats.spi_transactions, (unsigned)sim.stats.spi_bytes);
+	if (frames > 1)
+	{
+		printf("  (%.1f / %.1f per frame)", (double)sim.stats.spi_transactions / frames, (double)sim.stats.spi_bytes / frames);
+	}
+	printf("\n");
+}
+
+static void report_filter(const char *what, uint32_t sent)
+{
+	printf("%-54s %5u of %u frames stored, %u filtered\n", what,
+			(unsigned)sim.stats.frames_received, (unsigned)sent, (unsigned)sim.stats.frames_filtered);
+}
+
+static void bench_receive(void)
+{
+	uint8_t frame[60];
+	uint8_t buf[64];
+
+	sim_test_setup(&sim, &ctx, &dev, NULL);
+	sim_test_make_frame(frame, sizeof(frame), 1);
+	SIM_REQUIRE(enc28_sim_inject_frame(&sim, frame, sizeof(frame)) == 0);
+	enc28_sim_reset_stats(&sim);
+	SIM_REQUIRE(enc28_read_packet(&dev, buf, sizeof(buf), NULL) == ENC28_OK);
+	report_spi("receive 60 B (enc28_read_packet)", 1);
+}
+
+static void bench_receive_burst(void)
+{
+	static uint8_t bufs[BURST_FRAMES][64];
+	uint8_t *buf_ptrs[BURST_FRAMES];
+	ENC28_Receive_Status_Vector status_vecs[BURST_FRAMES];
+	uint8_t frame[60];
+	uint8_t packets_read = 0;
+
+	sim_test_setup(&sim, &ctx, &dev, NULL);
+	for (uint8_t i = 0; i < BURST_FRAMES; ++i)
+	{
+		buf_ptrs[i] = bufs[i];
+		sim_test_make_frame(frame, sizeof(frame), i);
+		SIM_REQUIRE(enc28_sim_inject_frame(&sim, frame, sizeof(frame)) == 0);
+	}
+	enc28_sim_reset_stats(&sim);
+	SIM_REQUIRE(enc28_read_packets_burst(&dev, buf_ptrs, sizeof(bufs[0]), status_vecs, BURST_FRAMES, &packets_read) == ENC28_OK);
+	SIM_REQUIRE(packets_read == BURST_FRAMES);
+	report_spi("receive 8 x 60 B (enc28_read_packets_burst)", BURST_FRAMES);
+}
+
+static void bench_transmit(void)
+{
+	uint8_t frame[100];
+
+	sim_test_setup(&sim, &ctx, &dev, NULL);
+	sim_test_make_frame(frame, sizeof(frame), 2);
+	enc28_sim_reset_stats(&sim);
+	SIM_REQUIRE(enc28_write_packet(&dev, frame, sizeof(frame)) == ENC28_OK);
+	report_spi("transmit 100 B (enc28_write_packet)", 1);
+
+	enc28_sim_reset_stats(&sim);
+	SIM_REQUIRE(enc28_check_outgoing_packet_status(&dev, NULL) == ENC28_OK);
+	report_spi("transmit status (enc28_check_outgoing_packet_status)", 1);
+}
+
+static void bench_checksum(void)
+{
+	uint8_t frame[TCP_OFFSET + MTU_TCP_LEN];
+	const ENC28_Packet_Segment segment = {frame, sizeof(frame)};
+	const ENC28_Tx_Checksum csum = {TCP_OFFSET, MTU_TCP_LEN, TCP_CSUM_OFFSET, 0};
+
+	sim_test_setup(&sim, &ctx, &dev, NULL);
+	sim_test_make_frame(frame, sizeof(frame), 3);
+	frame[TCP_CSUM_OFFSET] = 0;
+	frame[TCP_CSUM_OFFSET + 1] = 0;
+
+	enc28_sim_reset_stats(&sim);
+	SIM_REQUIRE(enc28_write_packet_chain(&dev, &segment, 1, NULL) == ENC28_OK);
+	const uint32_t plain_transactions = sim.stats.spi_transactions;
+	const uint32_t plain_bytes = sim.stats.spi_bytes;
+	const uint64_t plain_ns = enc28_sim_bus_time_ns(&sim, SPI_CLOCK_HZ);
+	SIM_REQUIRE(enc28_check_outgoing_packet_status(&dev, NULL) == ENC28_OK);
+
+	enc28_sim_reset_stats(&sim);
+	SIM_REQUIRE(enc28_write_packet_chain(&dev, &segment, 1, &csum) == ENC28_OK);
+	SIM_REQUIRE(sim.stats.checksum_bytes == MTU_TCP_LEN);
+	printf("%-54s %5u transactions %6u bytes  (%.1f us bus time at %u MHz)\n", "MTU TCP checksum by the DMA engine, added cost",
+			(unsigned)(sim.stats.spi_transactions - plain_transactions), (unsigned)(sim.stats.spi_bytes - plain_bytes),
+			(double)(enc28_sim_bus_time_ns(&sim, SPI_CLOCK_HZ) - plain_ns) / 1000.0, (unsigned)(SPI_CLOCK_HZ / 1000000u));
+	SIM_REQUIRE(enc28_check_outgoing_packet_status(&dev, NULL) == ENC28_OK);
+
+	enc28_sim_reset_stats(&sim);
+	uint16_t checksum = 0;
+	SIM_REQUIRE(enc28_compute_checksum(&dev, 0, MTU_TCP_LEN, &checksum) == ENC28_OK);
+	report_spi("  of which enc28_compute_checksum", 1);
+}
+
+/* Multicast frames to 224.0.0.251 (mDNS) and 224.0.0.1 in turn, only the latter is joined */
+static void inject_multicast(void)
+{
+	static const uint8_t groups[2][6] = {{0x01, 0x00, 0x5E, 0x00, 0x00, 0xFB}, {0x01, 0x00, 0x5E, 0x00, 0x00, 0x01}};
+	uint8_t frame[60];
+
+	enc28_sim_reset_stats(&sim);
+	for (uint8_t i = 0; i < FILTER_FRAMES; ++i)
+	{
+		sim_test_make_frame(frame, sizeof(frame), i);
+		memcpy(frame, groups[i & 1], 6);
+		enc28_sim_inject_frame(&sim, frame, sizeof(frame));
+	}
+}
+
+static void bench_hash_filter(void)
+{
+	static const uint8_t joined_group[6] = {0x01, 0x00, 0x5E, 0x00, 0x00, 0x01};
+	uint8_t table[ENC28_HASH_TABLE_SIZE] = {0};
+
+	sim_test_setup(&sim, &ctx, &dev, NULL);
+	inject_multicast();
+	report_filter("multicast, 2 groups (default filters)", FILTER_FRAMES);
+
+	sim_test_setup(&sim, &ctx, &dev, NULL);
+	const uint8_t index = enc28_hash_table_index(joined_group);
+	table[index / 8] |= 1 << (index % 8);
+	SIM_REQUIRE(enc28_write_hash_table(&dev, table) == ENC28_OK);
+	inject_multicast();
+	report_filter("multicast, 2 groups (hash table, 1 joined)", FILTER_FRAMES);
+}
+
+/* ARP request for @p target_ip */
+static void make_arp_request(uint8_t *frame, const uint8_t target_ip[4])
+{
+	memset(frame, 0, 60);
+	memset(frame, 0xFF, 6);
+	memcpy(frame + 6, sim_test_mac.addr, 6);
+	frame[12] = 0x08;
+	frame[13] = 0x06;
+	frame[21] = 0x01;
+	memcpy(frame + 38, target_ip, 4);
+}
+
+/* ARP requests for another host and NetBIOS UDP broadcasts in turn, then one ARP request for us */
+static void inject_broadcasts(const uint8_t our_ip[4])
+{
+	static const uint8_t other_ip[4] = {192, 168, 1, 7};
+	uint8_t frame[60];
+
+	enc28_sim_reset_stats(&sim);
+	for (uint8_t i = 0; i < FILTER_FRAMES; ++i)
+	{
+		if (i & 1)
+		{
+			make_arp_request(frame, other_ip);
+		}
+		else
+		{
+			memset(frame, 0, sizeof(frame));
+			memset(frame, 0xFF, 6);
+			frame[12] = 0x08;
+			frame[14] = 0x45;
+			frame[23] = 17;
+			frame[37] = 137;
+		}
+		enc28_sim_inject_frame(&sim, frame, sizeof(frame));
+	}
+	make_arp_request(frame, our_ip);
+	enc28_sim_inject_frame(&sim, frame, sizeof(frame));
+}
+
+static void bench_pattern_filter(void)
+{
+	static const uint8_t our_ip[4] = {192, 168, 1, 100};
+	uint8_t template_frame[60];
+	uint8_t byte_mask[60] = {0};
+	ENC28_Pattern_Match pm;
+
+	sim_test_setup(&sim, &ctx, &dev, NULL);
+	inject_broadcasts(our_ip);
+	report_filter("broadcast + 1 ARP for us (default filters)", FILTER_FRAMES + 1);
+
+	// EtherType, ARP opcode and target address, as the test application does
+	make_arp_request(template_frame, our_ip);
+	memset(&byte_mask[12], 1, 2);
+	memset(&byte_mask[20], 1, 2);
+	memset(&byte_mask[38], 1, 4);
+	SIM_REQUIRE(enc28_build_pattern_match(template_frame, byte_mask, sizeof(template_frame), &pm) == ENC28_OK);
+
+	sim_test_setup(&sim, &ctx, &dev, NULL);
+	SIM_REQUIRE(enc28_write_pattern_match(&dev, &pm, ENC28_ERXFCON_BCAST | ENC28_ERXFCON_MULTI) == ENC28_OK);
+	inject_broadcasts(our_ip);
+	report_filter("broadcast + 1 ARP for us (ARP pattern match)", FILTER_FRAMES + 1);
+}
+
+int main(void)
+{
+	bench_receive();
+	bench_receive_burst();
+	bench_transmit();
+	bench_checksum();
+	bench_hash_filter();
+	bench_pattern_filter();
+	return 0;
+}
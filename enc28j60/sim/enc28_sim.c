@@ -0,0 +1,983 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Sebastian Baginski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * enc28_sim.c
+ *
+ * Implementation of the ENC28J60 software model.
+ * */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "enc28_sim.h"
+
+#include <string.h>
+#include <time.h>
+
+#define PRIV_ADDR_MASK		(ENC28_SIM_BUFFER_SIZE - 1)
+#define PRIV_MIN_FRAME_LEN	(60)
+#define PRIV_CRC_LEN		(4)
+#define PRIV_RSV_SIZE		(6)
+#define PRIV_MAX_PKTCNT		(255)
+
+/* Register values after power-on reset, datasheet table 3-2 */
+#define PRIV_RESET_RX_START	(0x05FA)
+#define PRIV_RESET_RX_END	(0x1FFF)
+#define PRIV_RESET_EREVID	(0x06)
+#define PRIV_RESET_ERXFCON	(ENC28_ERXFCON_UNI | ENC28_ERXFCON_CRC | ENC28_ERXFCON_BCAST)
+#define PRIV_RESET_PHID1	(0x0083)
+#define PRIV_RESET_PHID2	(0x1400)
+#define PRIV_RESET_PHLCON	(0x3422)
+
+static ENC28_Sim_Device *priv_enc28_sim_slots[ENC28_SIM_MAX_DEVICES];
+
+static uint8_t priv_enc28_sim_is_common_reg(uint8_t addr)
+{
+	return addr >= ENC28_CR_EIE;
+}
+
+static uint8_t priv_enc28_sim_curr_bank(const ENC28_Sim_Device *dev)
+{
+	return dev->regs[0][ENC28_CR_ECON1] & ENC28_ECON1_BSEL;
+}
+
+static uint8_t priv_enc28_sim_is_mac_or_mii_reg(uint8_t bank, uint8_t addr)
+{
+	if (priv_enc28_sim_is_common_reg(addr))
+	{
+		return 0;
+	}
+	else if (bank == 2)
+	{
+		return addr <= ENC28_CR_MIRDH;
+	}
+	else if (bank == 3)
+	{
+		return (addr <= ENC28_CR_MAC_ADD2) || (addr == ENC28_CR_MISTAT);
+	}
+	else
+	{
+		return 0;
+	}
+}
+
+static uint8_t *priv_enc28_sim_reg(ENC28_Sim_Device *dev, uint8_t bank, uint8_t addr)
+{
+	return priv_enc28_sim_is_common_reg(addr) ? &dev->regs[0][addr] : &dev->regs[bank][addr];
+}
+
+static uint16_t priv_enc28_sim_get_ptr(const ENC28_Sim_Device *dev, uint8_t bank, uint8_t addr_lo)
+{
+	return dev->regs[bank][addr_lo] | ((dev->regs[bank][addr_lo + 1] & 0x1F) << 8);
+}
+
+static void priv_enc28_sim_set_ptr(ENC28_Sim_Device *dev, uint8_t bank, uint8_t addr_lo, uint16_t value)
+{
+	dev->regs[bank][addr_lo] = value & 0xFF;
+	dev->regs[bank][addr_lo + 1] = (value >> 8) & 0x1F;
+}
+
+static uint16_t priv_enc28_sim_next_rx_addr(const ENC28_Sim_Device *dev, uint16_t addr)
+{
+	if (addr == priv_enc28_sim_get_ptr(dev, 0, ENC28_CR_ERXNDL))
+	{
+		return priv_enc28_sim_get_ptr(dev, 0, ENC28_CR_ERXSTL);
+	}
+	return (addr + 1) & PRIV_ADDR_MASK;
+}
+
+static void priv_enc28_sim_update_link_regs(ENC28_Sim_Device *dev)
+{
+	const uint16_t full_duplex = dev->phy_regs[ENC28_PHYR_PHCON1] & (1 << ENC28_PHCON1_PDPXMD);
+
+	dev->phy_regs[ENC28_PHYR_PHSTAT2] = full_duplex ? (1 << ENC28_PHSTAT2_DPXSTAT) : 0;
+	if (dev->link_up)
+	{
+		dev->phy_regs[ENC28_PHYR_PHSTAT2] |= (1 << ENC28_PHSTAT2_LSTAT);
+	}
+	else
+	{
+		dev->phy_regs[ENC28_PHYR_PHSTAT1] &= ~(1 << ENC28_PHSTAT1_LLSTAT);
+	}
+}
+
+static void priv_enc28_sim_reset_regs(ENC28_Sim_Device *dev)
+{
+	memset(dev->regs, 0, sizeof(dev->regs));
+
+	priv_enc28_sim_set_ptr(dev, 0, ENC28_CR_ERDPTL, PRIV_RESET_RX_START);
+	priv_enc28_sim_set_ptr(dev, 0, ENC28_CR_ERXSTL, PRIV_RESET_RX_START);
+	priv_enc28_sim_set_ptr(dev, 0, ENC28_CR_ERXNDL, PRIV_RESET_RX_END);
+	priv_enc28_sim_set_ptr(dev, 0, ENC28_CR_ERXRDPTL, PRIV_RESET_RX_START);
+	dev->regs[1][ENC28_CR_ERXFCON] = PRIV_RESET_ERXFCON;
+	dev->regs[2][ENC28_CR_MAMXFLL] = 0x00;
+	dev->regs[2][ENC28_CR_MAMXFLH] = 0x06;
+	dev->regs[3][ENC28_CR_EREVID] = PRIV_RESET_EREVID;
+	dev->regs[0][ENC28_CR_ECON2] = (1 << ENC28_ECON2_AUTOINC);
+	dev->regs[0][ENC28_CR_ESTAT] = (1 << ENC28_ESTAT_CLKRDY);
+}
+
+static void priv_enc28_sim_finish_transmit(ENC28_Sim_Device *dev)
+{
+	const uint16_t end_addr = priv_enc28_sim_get_ptr(dev, 0, ENC28_CR_ETXNDL);
+	const uint16_t len = dev->tx_frame_len;
+	const uint8_t collisions = dev->tx_collisions & 0x0F;
+	// each collided attempt is cut off after one slot time
+	const uint16_t wire_len = ((len < PRIV_MIN_FRAME_LEN) ? PRIV_MIN_FRAME_LEN : len) + PRIV_CRC_LEN
+			+ collisions * (PRIV_MIN_FRAME_LEN + PRIV_CRC_LEN);
+	uint8_t tsv[ENC28_SIM_TSV_SIZE] = {0, 0, 0, 0, 0, 0, 0};
+
+	tsv[0] = len & 0xFF;
+	tsv[1] = (len >> 8) & 0xFF;
+	tsv[2] = (1 << 7) | collisions; // transmit done, collision count
+	if ((len > 0) && (dev->tx_frame[0] & 0x1))
+	{
+		const uint8_t is_broadcast = (memcmp(dev->tx_frame, "\xFF\xFF\xFF\xFF\xFF\xFF", 6) == 0);
+		tsv[3] = is_broadcast ? (1 << 1) : (1 << 0);
+	}
+	tsv[4] = wire_len & 0xFF;
+	tsv[5] = (wire_len >> 8) & 0xFF;
+
+	const uint8_t late_collision = (dev->tx_late_collisions > 0);
+	if (late_collision)
+	{
+		dev->tx_late_collisions--;
+		tsv[3] |= (1 << 5); // late collision
+	}
+
+	for (uint16_t i = 0; i < sizeof(tsv); ++i)
+	{
+		dev->mem[(end_addr + 1 + i) & PRIV_ADDR_MASK] = tsv[i];
+	}
+
+	dev->regs[0][ENC28_CR_ECON1] &= ~(1 << ENC28_ECON1_TXRTS);
+	dev->regs[0][ENC28_CR_EIR] |= (1 << ENC28_EIR_TXIF);
+
+	if (late_collision)
+	{
+		dev->regs[0][ENC28_CR_ESTAT] |= (1 << ENC28_ESTAT_TXABRT) | (1 << ENC28_ESTAT_LATECOL);
+		dev->regs[0][ENC28_CR_EIR] |= (1 << ENC28_EIR_TXERIF);
+		dev->stats.frames_aborted++;
+		return;
+	}
+	dev->stats.frames_transmitted++;
+
+	if (dev->on_transmit)
+	{
+		dev->on_transmit(dev, dev->tx_frame, len, dev->user);
+	}
+}
+
+static void priv_enc28_sim_start_transmit(ENC28_Sim_Device *dev)
+{
+	const uint16_t start_addr = priv_enc28_sim_get_ptr(dev, 0, ENC28_CR_ETXSTL);
+	const uint16_t end_addr = priv_enc28_sim_get_ptr(dev, 0, ENC28_CR_ETXNDL);
+	uint16_t len = (end_addr > start_addr) ? (end_addr - start_addr) : 0;
+
+	if (len > sizeof(dev->tx_frame))
+	{
+		len = sizeof(dev->tx_frame);
+	}
+
+	// skip the per-packet control byte at ETXST
+	for (uint16_t i = 0; i < len; ++i)
+	{
+		dev->tx_frame[i] = dev->mem[(start_addr + 1 + i) & PRIV_ADDR_MASK];
+	}
+	dev->tx_frame_len = len;
+
+	if (!dev->hold_transmit)
+	{
+		priv_enc28_sim_finish_transmit(dev);
+	}
+}
+
+static void priv_enc28_sim_reset_rx(ENC28_Sim_Device *dev)
+{
+	dev->regs[1][ENC28_CR_EPKTCNT] = 0;
+	priv_enc28_sim_set_ptr(dev, 0, ENC28_CR_ERXWRPTL, priv_enc28_sim_get_ptr(dev, 0, ENC28_CR_ERXSTL));
+}
+
+static uint8_t priv_enc28_sim_read_reg(ENC28_Sim_Device *dev, uint8_t bank, uint8_t addr)
+{
+	if (addr == ENC28_CR_EIR)
+	{
+		uint8_t eir = dev->regs[0][ENC28_CR_EIR] & ~(1 << ENC28_EIR_PKTIF);
+		if (dev->regs[1][ENC28_CR_EPKTCNT] > 0)
+		{
+			eir |= (1 << ENC28_EIR_PKTIF);
+		}
+		return eir;
+	}
+	return *priv_enc28_sim_reg(dev, bank, addr);
+}
+
+static uint16_t priv_enc28_sim_dma_next(const ENC28_Sim_Device *dev, uint16_t addr)
+{
+	// the DMA wraps around the end of the receive buffer like the read pointer
+	const uint16_t rx_start = priv_enc28_sim_get_ptr(dev, 0, ENC28_CR_ERXSTL);
+	const uint16_t rx_end = priv_enc28_sim_get_ptr(dev, 0, ENC28_CR_ERXNDL);
+	if (addr == rx_end)
+	{
+		return rx_start;
+	}
+	return (addr + 1) & PRIV_ADDR_MASK;
+}
+
+static void priv_enc28_sim_run_dma(ENC28_Sim_Device *dev)
+{
+	const uint16_t end_addr = priv_enc28_sim_get_ptr(dev, 0, ENC28_CR_EDMANDL);
+	uint16_t addr = priv_enc28_sim_get_ptr(dev, 0, ENC28_CR_EDMASTL);
+
+	if (dev->regs[0][ENC28_CR_ECON1] & (1 << ENC28_ECON1_CSUM_EN))
+	{
+		uint32_t sum = 0;
+		uint32_t count = 0;
+		for (;;)
+		{
+			sum += (count & 0x1) ? dev->mem[addr] : (dev->mem[addr] << 8);
+			++count;
+			if ((addr == end_addr) || (count >= ENC28_SIM_BUFFER_SIZE))
+			{
+				break;
+			}
+			addr = priv_enc28_sim_dma_next(dev, addr);
+		}
+		while (sum >> 16)
+		{
+			sum = (sum & 0xFFFF) + (sum >> 16);
+		}
+		sum = ~sum & 0xFFFF;
+		dev->regs[0][ENC28_CR_EDMACSL] = sum & 0xFF;
+		dev->regs[0][ENC28_CR_EDMACSH] = (sum >> 8) & 0xFF;
+		dev->stats.checksum_bytes += count;
+	}
+	else
+	{
+		uint16_t dst = priv_enc28_sim_get_ptr(dev, 0, ENC28_CR_EDMADSTL);
+		uint32_t count = 0;
+		for (;;)
+		{
+			dev->mem[dst] = dev->mem[addr];
+			++count;
+			if ((addr == end_addr) || (count >= ENC28_SIM_BUFFER_SIZE))
+			{
+				break;
+			}
+			addr = priv_enc28_sim_dma_next(dev, addr);
+			dst = priv_enc28_sim_dma_next(dev, dst);
+		}
+	}
+
+	dev->regs[0][ENC28_CR_ECON1] &= ~(1 << ENC28_ECON1_DMA_BUSY);
+	dev->regs[0][ENC28_CR_EIR] |= (1 << ENC28_EIR_DMAIF);
+}
+
+static void priv_enc28_sim_write_econ1(ENC28_Sim_Device *dev, uint8_t value)
+{
+	const uint8_t prev = dev->regs[0][ENC28_CR_ECON1];
+	dev->regs[0][ENC28_CR_ECON1] = value;
+
+	if (value & (1 << ENC28_ECON1_TX_RST))
+	{
+		dev->regs[0][ENC28_CR_ECON1] &= ~(1 << ENC28_ECON1_TXRTS);
+	}
+	else if (prev & (1 << ENC28_ECON1_TX_RST))
+	{
+		// ERRATA: clearing TXRST can set EIR.TXERIF, the model always does
+		dev->regs[0][ENC28_CR_EIR] |= (1 << ENC28_EIR_TXERIF);
+	}
+	else if ((value & (1 << ENC28_ECON1_TXRTS)) && !(prev & (1 << ENC28_ECON1_TXRTS)))
+	{
+		priv_enc28_sim_start_transmit(dev);
+	}
+
+	if (value & (1 << ENC28_ECON1_RX_RST))
+	{
+		dev->regs[0][ENC28_CR_ECON1] &= ~(1 << ENC28_ECON1_RXEN);
+		priv_enc28_sim_reset_rx(dev);
+	}
+
+	// the engine finishes before the next SPI access can observe ECON1.DMAST
+	if ((value & (1 << ENC28_ECON1_DMA_BUSY)) && !(prev & (1 << ENC28_ECON1_DMA_BUSY)))
+	{
+		priv_enc28_sim_run_dma(dev);
+	}
+}
+
+static void priv_enc28_sim_write_reg(ENC28_Sim_Device *dev, uint8_t bank, uint8_t addr, uint8_t value)
+{
+	if (priv_enc28_sim_is_common_reg(addr))
+	{
+		switch (addr)
+		{
+		case ENC28_CR_ECON1:
+			priv_enc28_sim_write_econ1(dev, value);
+			break;
+		case ENC28_CR_ECON2:
+			if ((value & (1 << ENC28_ECON2_PKTDEC)) && (dev->regs[1][ENC28_CR_EPKTCNT] > 0))
+			{
+				dev->regs[1][ENC28_CR_EPKTCNT]--;
+			}
+			dev->regs[0][ENC28_CR_ECON2] = value & ~(1 << ENC28_ECON2_PKTDEC);
+			break;
+		case ENC28_CR_ESTAT:
+			// only the TXABRT and LATECOL bits are writable
+			dev->regs[0][ENC28_CR_ESTAT] = (dev->regs[0][ENC28_CR_ESTAT] & ~((1 << ENC28_ESTAT_TXABRT) | (1 << ENC28_ESTAT_LATECOL)))
+					| (value & ((1 << ENC28_ESTAT_TXABRT) | (1 << ENC28_ESTAT_LATECOL)));
+			break;
+		case ENC28_CR_EIR:
+			dev->regs[0][ENC28_CR_EIR] = value & ~(1 << ENC28_EIR_PKTIF);
+			break;
+		default:
+			dev->regs[0][addr] = value;
+			break;
+		}
+		return;
+	}
+
+	if (bank == 0)
+	{
+		if ((addr == ENC28_CR_ERXWRPTL) || (addr == ENC28_CR_ERXWRPTH))
+		{
+			return;
+		}
+		dev->regs[0][addr] = value;
+		if ((addr == ENC28_CR_ERXSTL) || (addr == ENC28_CR_ERXSTH))
+		{
+			priv_enc28_sim_set_ptr(dev, 0, ENC28_CR_ERXWRPTL, priv_enc28_sim_get_ptr(dev, 0, ENC28_CR_ERXSTL));
+		}
+	}
+	else if (bank == 1)
+	{
+		if (addr != ENC28_CR_EPKTCNT)
+		{
+			dev->regs[1][addr] = value;
+		}
+	}
+	else if (bank == 2)
+	{
+		if ((addr == ENC28_CR_MIRDL) || (addr == ENC28_CR_MIRDH))
+		{
+			return;
+		}
+		dev->regs[2][addr] = value;
+		if ((addr == ENC28_CR_MICMD) && (value & (1 << ENC28_MICMD_MIIRD)))
+		{
+			// PHY reads complete instantly, MISTAT.BUSY is never observed
+			const uint8_t phy_addr = dev->regs[2][ENC28_CR_MIREGADR] & 0x1F;
+			const uint16_t phy_value = dev->phy_regs[phy_addr];
+			dev->regs[2][ENC28_CR_MIRDL] = phy_value & 0xFF;
+			dev->regs[2][ENC28_CR_MIRDH] = (phy_value >> 8) & 0xFF;
+			if ((phy_addr == ENC28_PHYR_PHSTAT1) && dev->link_up)
+			{
+				// latching low bit is re-armed by the read
+				dev->phy_regs[ENC28_PHYR_PHSTAT1] |= (1 << ENC28_PHSTAT1_LLSTAT);
+			}
+			else if (phy_addr == ENC28_PHYR_PHIR)
+			{
+				// reading PHIR acknowledges the PHY interrupt, EIR.LINKIF follows PHIR.PGIF
+				dev->phy_regs[ENC28_PHYR_PHIR] = 0;
+				dev->regs[0][ENC28_CR_EIR] &= ~(1 << ENC28_EIR_LINKIF);
+			}
+		}
+		else if (addr == ENC28_CR_MIWRH)
+		{
+			const uint8_t phy_addr = dev->regs[2][ENC28_CR_MIREGADR] & 0x1F;
+			dev->phy_regs[phy_addr] = dev->regs[2][ENC28_CR_MIWRL] | (value << 8);
+			if (phy_addr == ENC28_PHYR_PHCON1)
+			{
+				priv_enc28_sim_update_link_regs(dev);
+			}
+		}
+	}
+	else
+	{
+		if ((addr != ENC28_CR_MISTAT) && (addr != ENC28_CR_EREVID))
+		{
+			dev->regs[3][addr] = value;
+		}
+	}
+}
+
+static uint8_t priv_enc28_sim_read_buffer(ENC28_Sim_Device *dev)
+{
+	const uint16_t ptr = priv_enc28_sim_get_ptr(dev, 0, ENC28_CR_ERDPTL);
+	const uint8_t value = dev->mem[ptr];
+
+	if (dev->regs[0][ENC28_CR_ECON2] & (1 << ENC28_ECON2_AUTOINC))
+	{
+		priv_enc28_sim_set_ptr(dev, 0, ENC28_CR_ERDPTL, priv_enc28_sim_next_rx_addr(dev, ptr));
+	}
+
+	return value;
+}
+
+static void priv_enc28_sim_write_buffer(ENC28_Sim_Device *dev, uint8_t value)
+{
+	const uint16_t ptr = priv_enc28_sim_get_ptr(dev, 0, ENC28_CR_EWRPTL);
+	dev->mem[ptr] = value;
+
+	if (dev->regs[0][ENC28_CR_ECON2] & (1 << ENC28_ECON2_AUTOINC))
+	{
+		priv_enc28_sim_set_ptr(dev, 0, ENC28_CR_EWRPTL, (ptr + 1) & PRIV_ADDR_MASK);
+	}
+}
+
+static uint8_t priv_enc28_sim_clock_byte(ENC28_Sim_Device *dev, uint8_t tx)
+{
+	dev->stats.spi_bytes++;
+
+	if (!dev->cs_active)
+	{
+		return 0xFF;
+	}
+
+	const uint32_t idx = dev->byte_idx++;
+	if (idx == 0)
+	{
+		dev->opcode = (tx >> ENC28_SPI_ARG_BITS) & 0x7;
+		dev->arg = tx & ENC28_SPI_ARG_MASK;
+		dev->stats.op_count[dev->opcode]++;
+		if (dev->opcode == ENC28_OP_SRC)
+		{
+			priv_enc28_sim_reset_regs(dev);
+		}
+		return 0;
+	}
+
+	const uint8_t bank = priv_enc28_sim_curr_bank(dev);
+	switch (dev->opcode)
+	{
+	case ENC28_OP_RCR:
+		if (priv_enc28_sim_is_mac_or_mii_reg(bank, dev->arg) && (idx == 1))
+		{
+			return 0; // dummy byte
+		}
+		return priv_enc28_sim_read_reg(dev, bank, dev->arg);
+	case ENC28_OP_WCR:
+		if (idx == 1)
+		{
+			priv_enc28_sim_write_reg(dev, bank, dev->arg, tx);
+		}
+		break;
+	case ENC28_OP_BFS:
+		if ((idx == 1) && !priv_enc28_sim_is_mac_or_mii_reg(bank, dev->arg))
+		{
+			priv_enc28_sim_write_reg(dev, bank, dev->arg, *priv_enc28_sim_reg(dev, bank, dev->arg) | tx);
+		}
+		break;
+	case ENC28_OP_BFC:
+		if ((idx == 1) && !priv_enc28_sim_is_mac_or_mii_reg(bank, dev->arg))
+		{
+			priv_enc28_sim_write_reg(dev, bank, dev->arg, *priv_enc28_sim_reg(dev, bank, dev->arg) & ~tx);
+		}
+		break;
+	case ENC28_OP_RBM:
+		return priv_enc28_sim_read_buffer(dev);
+	case ENC28_OP_WBM:
+		priv_enc28_sim_write_buffer(dev, tx);
+		break;
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+static uint8_t priv_enc28_sim_dma_busy(ENC28_Sim_Device *dev)
+{
+	pthread_mutex_lock(&dev->dma.lock);
+	const uint8_t busy = dev->dma.busy;
+	pthread_mutex_unlock(&dev->dma.lock);
+	return busy;
+}
+
+static void priv_enc28_sim_check_overlap(ENC28_Sim_Device *dev)
+{
+	if (priv_enc28_sim_dma_busy(dev))
+	{
+		dev->stats.dma_overlaps++;
+	}
+}
+
+static void priv_enc28_sim_nss(ENC28_Sim_Device *dev, uint8_t value)
+{
+	priv_enc28_sim_check_overlap(dev);
+	if ((value == 0) && !dev->cs_active)
+	{
+		dev->cs_active = 1;
+		dev->byte_idx = 0;
+		dev->stats.spi_transactions++;
+	}
+	else if (value != 0)
+	{
+		dev->cs_active = 0;
+	}
+}
+
+static void priv_enc28_sim_spi_out(ENC28_Sim_Device *dev, const uint8_t *buff, size_t len)
+{
+	priv_enc28_sim_check_overlap(dev);
+	for (size_t i = 0; i < len; ++i)
+	{
+		(void)priv_enc28_sim_clock_byte(dev, buff[i]);
+	}
+}
+
+static void priv_enc28_sim_spi_in(ENC28_Sim_Device *dev, uint8_t *buff, size_t len)
+{
+	priv_enc28_sim_check_overlap(dev);
+	for (size_t i = 0; i < len; ++i)
+	{
+		buff[i] = priv_enc28_sim_clock_byte(dev, 0);
+	}
+}
+
+static void priv_enc28_sim_spi_in_out(ENC28_Sim_Device *dev, const uint8_t *tx, uint8_t *rx, size_t len)
+{
+	priv_enc28_sim_check_overlap(dev);
+	for (size_t i = 0; i < len; ++i)
+	{
+		rx[i] = priv_enc28_sim_clock_byte(dev, tx[i]);
+	}
+}
+
+static void priv_enc28_sim_wait(ENC28_Sim_Device *dev, uint32_t ns)
+{
+	dev->stats.wait_ns += ns;
+}
+
+static void *priv_enc28_sim_dma_thread(void *arg)
+{
+	ENC28_Sim_Device *dev = (ENC28_Sim_Device*)arg;
+
+	if (dev->dma.byte_time_ns > 0)
+	{
+		const uint64_t ns = (uint64_t)dev->dma.byte_time_ns * dev->dma.len;
+		const struct timespec delay = {(time_t)(ns / 1000000000u), (long)(ns % 1000000000u)};
+		nanosleep(&delay, NULL);
+	}
+
+	for (size_t i = 0; i < dev->dma.len; ++i)
+	{
+		const uint8_t value = priv_enc28_sim_clock_byte(dev, dev->dma.tx ? dev->dma.tx[i] : 0);
+		if (dev->dma.rx)
+		{
+			dev->dma.rx[i] = value;
+		}
+	}
+	dev->stats.dma_transfers++;
+	dev->stats.dma_bytes += dev->dma.len;
+
+	// the completion interrupt runs before the waiting side is released
+	if (dev->dma.on_complete)
+	{
+		dev->dma.on_complete(dev, dev->dma.user);
+	}
+
+	pthread_mutex_lock(&dev->dma.lock);
+	dev->dma.busy = 0;
+	pthread_cond_broadcast(&dev->dma.done);
+	pthread_mutex_unlock(&dev->dma.lock);
+	return NULL;
+}
+
+static void priv_enc28_sim_dma_join(ENC28_Sim_Device *dev)
+{
+	if (dev->dma.joinable)
+	{
+		pthread_join(dev->dma.thread, NULL);
+		dev->dma.joinable = 0;
+	}
+}
+
+static void priv_enc28_sim_dma_start(ENC28_Sim_Device *dev, const uint8_t *tx, uint8_t *rx, size_t len)
+{
+	priv_enc28_sim_check_overlap(dev);
+	priv_enc28_sim_dma_join(dev);
+
+	dev->dma.tx = tx;
+	dev->dma.rx = rx;
+	dev->dma.len = len;
+	dev->dma.busy = 1;
+	// an instant transfer is done in the caller, the completion hook runs before the start returns
+	if ((dev->dma.byte_time_ns > 0) && (pthread_create(&dev->dma.thread, NULL, priv_enc28_sim_dma_thread, dev) == 0))
+	{
+		dev->dma.joinable = 1;
+	}
+	else
+	{
+		(void)priv_enc28_sim_dma_thread(dev);
+	}
+}
+
+static void priv_enc28_sim_spi_out_async(ENC28_Sim_Device *dev, const uint8_t *buff, size_t len)
+{
+	priv_enc28_sim_dma_start(dev, buff, NULL, len);
+}
+
+static void priv_enc28_sim_spi_in_async(ENC28_Sim_Device *dev, uint8_t *buff, size_t len)
+{
+	priv_enc28_sim_dma_start(dev, NULL, buff, len);
+}
+
+static void priv_enc28_sim_async_wait(ENC28_Sim_Device *dev)
+{
+	pthread_mutex_lock(&dev->dma.lock);
+	while (dev->dma.busy)
+	{
+		pthread_cond_wait(&dev->dma.done, &dev->dma.lock);
+	}
+	pthread_mutex_unlock(&dev->dma.lock);
+	priv_enc28_sim_dma_join(dev);
+}
+
+/*
+ * The SPI context callbacks do not carry a user pointer, so each slot gets its own set of trampolines
+ * */
+#define PRIV_DEFINE_SLOT_CALLBACKS(n) \
+	static void priv_enc28_sim_nss_##n(uint8_t v) { priv_enc28_sim_nss(priv_enc28_sim_slots[n], v); } \
+	static void priv_enc28_sim_spi_out_##n(const uint8_t *b, size_t l) { priv_enc28_sim_spi_out(priv_enc28_sim_slots[n], b, l); } \
+	static void priv_enc28_sim_spi_in_##n(uint8_t *b, size_t l) { priv_enc28_sim_spi_in(priv_enc28_sim_slots[n], b, l); } \
+	static void priv_enc28_sim_spi_in_out_##n(const uint8_t *t, uint8_t *r, size_t l) { priv_enc28_sim_spi_in_out(priv_enc28_sim_slots[n], t, r, l); } \
+	static void priv_enc28_sim_wait_##n(uint32_t ns) { priv_enc28_sim_wait(priv_enc28_sim_slots[n], ns); } \
+	static void priv_enc28_sim_spi_out_async_##n(const uint8_t *b, size_t l) { priv_enc28_sim_spi_out_async(priv_enc28_sim_slots[n], b, l); } \
+	static void priv_enc28_sim_spi_in_async_##n(uint8_t *b, size_t l) { priv_enc28_sim_spi_in_async(priv_enc28_sim_slots[n], b, l); } \
+	static void priv_enc28_sim_async_wait_##n(void) { priv_enc28_sim_async_wait(priv_enc28_sim_slots[n]); }
+
+#define PRIV_SLOT_CALLBACKS(n) \
+	{ priv_enc28_sim_nss_##n, priv_enc28_sim_spi_out_##n, priv_enc28_sim_spi_in_##n, priv_enc28_sim_spi_in_out_##n, priv_enc28_sim_wait_##n, NULL, NULL, NULL }
+
+#define PRIV_SLOT_DMA_CALLBACKS(n) \
+	{ priv_enc28_sim_nss_##n, priv_enc28_sim_spi_out_##n, priv_enc28_sim_spi_in_##n, priv_enc28_sim_spi_in_out_##n, priv_enc28_sim_wait_##n, \
+	  priv_enc28_sim_spi_out_async_##n, priv_enc28_sim_spi_in_async_##n, priv_enc28_sim_async_wait_##n }
+
+PRIV_DEFINE_SLOT_CALLBACKS(0)
+PRIV_DEFINE_SLOT_CALLBACKS(1)
+
+_Static_assert(ENC28_SIM_MAX_DEVICES == 2, "Update the callback slot table");
+
+static const ENC28_SPI_Context priv_enc28_sim_slot_ctx[ENC28_SIM_MAX_DEVICES] = {
+	PRIV_SLOT_CALLBACKS(0),
+	PRIV_SLOT_CALLBACKS(1)
+};
+
+static const ENC28_SPI_Context priv_enc28_sim_slot_dma_ctx[ENC28_SIM_MAX_DEVICES] = {
+	PRIV_SLOT_DMA_CALLBACKS(0),
+	PRIV_SLOT_DMA_CALLBACKS(1)
+};
+
+static uint32_t priv_enc28_sim_crc32(const uint8_t *data, uint16_t len)
+{
+	uint32_t crc = 0xFFFFFFFF;
+	for (uint16_t i = 0; i < len; ++i)
+	{
+		crc ^= data[i];
+		for (uint8_t bit = 0; bit < 8; ++bit)
+		{
+			crc = (crc >> 1) ^ (0xEDB88320 & (-(crc & 1)));
+		}
+	}
+	return ~crc;
+}
+
+static uint8_t priv_enc28_sim_pattern_match(const ENC28_Sim_Device *dev, const uint8_t *frame, uint16_t len)
+{
+	const uint16_t offset = priv_enc28_sim_get_ptr(dev, 1, ENC28_CR_EPMOL);
+	const uint16_t expected = dev->regs[1][ENC28_CR_EPMCSL] | (dev->regs[1][ENC28_CR_EPMCSH] << 8);
+	uint32_t sum = 0;
+	uint8_t selected = 0;
+
+	// the selected bytes of the window are summed in order as big-endian words
+	for (uint16_t i = 0; i < 64; ++i)
+	{
+		if (!(dev->regs[1][ENC28_CR_EPMM0 + (i >> 3)] & (1 << (i & 0x7))))
+		{
+			continue;
+		}
+		if (offset + i >= len)
+		{
+			return 0;
+		}
+		sum += (selected & 0x1) ? frame[offset + i] : ((uint32_t)frame[offset + i] << 8);
+		++selected;
+	}
+	while (sum >> 16)
+	{
+		sum = (sum & 0xFFFF) + (sum >> 16);
+	}
+	return (uint16_t)~sum == expected;
+}
+
+static uint8_t priv_enc28_sim_accept_frame(const ENC28_Sim_Device *dev, const uint8_t *frame, uint16_t len)
+{
+	const uint8_t filter = dev->regs[1][ENC28_CR_ERXFCON];
+	const uint8_t match_mask = ENC28_ERXFCON_UNI | ENC28_ERXFCON_PM | ENC28_ERXFCON_MULTI | ENC28_ERXFCON_HT | ENC28_ERXFCON_BCAST;
+	const uint8_t enabled = filter & match_mask;
+	uint8_t matched = 0;
+
+	if (enabled == 0)
+	{
+		return 1; // promiscuous mode
+	}
+
+	{
+		uint8_t is_unicast = 1;
+		for (uint8_t i = 0; i < 6; ++i)
+		{
+			// ENC28_CR_MAC_ADD1 .. ENC28_CR_MAC_ADD6 hold MAC address bytes 0..5
+			static const uint8_t mac_regs[6] = {
+					ENC28_CR_MAC_ADD1, ENC28_CR_MAC_ADD2, ENC28_CR_MAC_ADD3,
+					ENC28_CR_MAC_ADD4, ENC28_CR_MAC_ADD5, ENC28_CR_MAC_ADD6 };
+			if (frame[i] != dev->regs[3][mac_regs[i]])
+			{
+				is_unicast = 0;
+				break;
+			}
+		}
+		if (is_unicast)
+		{
+			matched |= ENC28_ERXFCON_UNI;
+		}
+	}
+
+	if (memcmp(frame, "\xFF\xFF\xFF\xFF\xFF\xFF", 6) == 0)
+	{
+		matched |= ENC28_ERXFCON_BCAST;
+	}
+
+	if (frame[0] & 0x1)
+	{
+		matched |= ENC28_ERXFCON_MULTI;
+	}
+
+	if ((filter & ENC28_ERXFCON_PM) && priv_enc28_sim_pattern_match(dev, frame, len))
+	{
+		matched |= ENC28_ERXFCON_PM;
+	}
+
+	if (filter & ENC28_ERXFCON_HT)
+	{
+		// bits 28:23 of the CRC over the destination address select a bit in EHT0..EHT7
+		const uint8_t index = (priv_enc28_sim_crc32(frame, 6) >> 23) & 0x3F;
+		if (dev->regs[1][ENC28_CR_EHT0 + (index >> 3)] & (1 << (index & 0x7)))
+		{
+			matched |= ENC28_ERXFCON_HT;
+		}
+	}
+
+	if (filter & ENC28_ERXFCON_ANDOR)
+	{
+		return (matched & enabled) == enabled;
+	}
+	return (matched & enabled) != 0;
+}
+
+static uint16_t priv_enc28_sim_rx_free_space(const ENC28_Sim_Device *dev)
+{
+	const uint16_t rx_start = priv_enc28_sim_get_ptr(dev, 0, ENC28_CR_ERXSTL);
+	const uint16_t rx_end = priv_enc28_sim_get_ptr(dev, 0, ENC28_CR_ERXNDL);
+	const uint16_t rd_ptr = priv_enc28_sim_get_ptr(dev, 0, ENC28_CR_ERXRDPTL);
+	const uint16_t wr_ptr = priv_enc28_sim_get_ptr(dev, 0, ENC28_CR_ERXWRPTL);
+
+	// datasheet, equation 7-1
+	if (wr_ptr > rd_ptr)
+	{
+		return (rx_end - rx_start) - (wr_ptr - rd_ptr);
+	}
+	else if (wr_ptr == rd_ptr)
+	{
+		return rx_end - rx_start;
+	}
+	return rd_ptr - wr_ptr - 1;
+}
+
+void enc28_sim_init(ENC28_Sim_Device *dev)
+{
+	memset(dev, 0, sizeof(*dev));
+	memset(dev->mem, 0xFF, sizeof(dev->mem));
+
+	priv_enc28_sim_reset_regs(dev);
+
+	dev->phy_regs[ENC28_PHYR_PHID1] = PRIV_RESET_PHID1;
+	dev->phy_regs[ENC28_PHYR_PHID2] = PRIV_RESET_PHID2;
+	dev->phy_regs[ENC28_PHYR_PHLCON] = PRIV_RESET_PHLCON;
+	pthread_mutex_init(&dev->dma.lock, NULL);
+	pthread_cond_init(&dev->dma.done, NULL);
+
+	dev->link_up = 1;
+	dev->phy_regs[ENC28_PHYR_PHSTAT1] = (1 << ENC28_PHSTAT1_LLSTAT);
+	priv_enc28_sim_update_link_regs(dev);
+}
+
+int32_t enc28_sim_attach(ENC28_Sim_Device *dev, uint8_t slot, ENC28_SPI_Context *ctx)
+{
+	if ((!dev) || (!ctx) || (slot >= ENC28_SIM_MAX_DEVICES))
+	{
+		return -1;
+	}
+
+	priv_enc28_sim_slots[slot] = dev;
+	*ctx = priv_enc28_sim_slot_ctx[slot];
+
+	return 0;
+}
+
+int32_t enc28_sim_attach_dma(ENC28_Sim_Device *dev, uint8_t slot, ENC28_SPI_Context *ctx,
+		uint32_t byte_time_ns, ENC28_Sim_Dma_Hook on_complete, void *user)
+{
+	if ((!dev) || (!ctx) || (slot >= ENC28_SIM_MAX_DEVICES))
+	{
+		return -1;
+	}
+
+	priv_enc28_sim_slots[slot] = dev;
+	*ctx = priv_enc28_sim_slot_dma_ctx[slot];
+
+	dev->dma.byte_time_ns = byte_time_ns;
+	dev->dma.on_complete = on_complete;
+	dev->dma.user = user;
+
+	return 0;
+}
+
+int32_t enc28_sim_inject_frame(ENC28_Sim_Device *dev, const uint8_t *frame, uint16_t len)
+{
+	if (!(dev->regs[0][ENC28_CR_ECON1] & (1 << ENC28_ECON1_RXEN)) || (len < 14) || !priv_enc28_sim_accept_frame(dev, frame, len))
+	{
+		dev->stats.frames_filtered++;
+		return -1;
+	}
+
+	const uint16_t byte_count = len + PRIV_CRC_LEN;
+	const uint16_t required = (PRIV_RSV_SIZE + byte_count + 1) & ~1;
+
+	if ((dev->regs[1][ENC28_CR_EPKTCNT] == PRIV_MAX_PKTCNT) || (required > priv_enc28_sim_rx_free_space(dev)))
+	{
+		dev->regs[0][ENC28_CR_EIR] |= (1 << ENC28_EIR_RXERIF);
+		dev->stats.frames_dropped++;
+		return -2;
+	}
+
+	uint16_t wr_ptr = priv_enc28_sim_get_ptr(dev, 0, ENC28_CR_ERXWRPTL);
+	uint16_t next_ptr = wr_ptr;
+	for (uint16_t i = 0; i < required; ++i)
+	{
+		next_ptr = priv_enc28_sim_next_rx_addr(dev, next_ptr);
+	}
+
+	{
+		const uint32_t crc = priv_enc28_sim_crc32(frame, len);
+		uint8_t rsv[PRIV_RSV_SIZE];
+
+		rsv[0] = next_ptr & 0xFF;
+		rsv[1] = (next_ptr >> 8) & 0xFF;
+		rsv[2] = byte_count & 0xFF;
+		rsv[3] = (byte_count >> 8) & 0xFF;
+		rsv[4] = (1 << 7); // received ok
+		rsv[5] = 0;
+		if (frame[0] & 0x1)
+		{
+			rsv[5] = (memcmp(frame, "\xFF\xFF\xFF\xFF\xFF\xFF", 6) == 0) ? (1 << 1) : (1 << 0);
+		}
+
+		for (uint16_t i = 0; i < sizeof(rsv); ++i)
+		{
+			dev->mem[wr_ptr] = rsv[i];
+			wr_ptr = priv_enc28_sim_next_rx_addr(dev, wr_ptr);
+		}
+		for (uint16_t i = 0; i < len; ++i)
+		{
+			dev->mem[wr_ptr] = frame[i];
+			wr_ptr = priv_enc28_sim_next_rx_addr(dev, wr_ptr);
+		}
+		for (uint16_t i = 0; i < PRIV_CRC_LEN; ++i)
+		{
+			dev->mem[wr_ptr] = (crc >> (8 * i)) & 0xFF;
+			wr_ptr = priv_enc28_sim_next_rx_addr(dev, wr_ptr);
+		}
+	}
+
+	priv_enc28_sim_set_ptr(dev, 0, ENC28_CR_ERXWRPTL, next_ptr);
+	dev->regs[1][ENC28_CR_EPKTCNT]++;
+	dev->stats.frames_received++;
+
+	return 0;
+}
+
+int32_t enc28_sim_complete_transmit(ENC28_Sim_Device *dev)
+{
+	if (!(dev->regs[0][ENC28_CR_ECON1] & (1 << ENC28_ECON1_TXRTS)))
+	{
+		return -1;
+	}
+
+	priv_enc28_sim_finish_transmit(dev);
+
+	return 0;
+}
+
+uint8_t enc28_sim_irq_pending(const ENC28_Sim_Device *dev)
+{
+	const uint8_t eie = dev->regs[0][ENC28_CR_EIE];
+	uint8_t eir = dev->regs[0][ENC28_CR_EIR];
+
+	if (dev->regs[1][ENC28_CR_EPKTCNT] > 0)
+	{
+		eir |= (1 << ENC28_EIR_PKTIF);
+	}
+
+	return (eie & (1 << ENC28_EIE_INTIE)) && (eir & eie & ~(1 << ENC28_EIE_INTIE));
+}
+
+void enc28_sim_set_link(ENC28_Sim_Device *dev, uint8_t link_up)
+{
+	const uint16_t phie_mask = (1 << ENC28_PHIE_PGEIE) | (1 << ENC28_PHIE_PLNKIE);
+	const uint8_t changed = (dev->link_up != (link_up ? 1 : 0));
+
+	dev->link_up = link_up ? 1 : 0;
+	priv_enc28_sim_update_link_regs(dev);
+
+	if (changed && ((dev->phy_regs[ENC28_PHYR_PHIE] & phie_mask) == phie_mask))
+	{
+		dev->phy_regs[ENC28_PHYR_PHIR] |= (1 << ENC28_PHIR_PGIF) | (1 << ENC28_PHIR_PLNKIF);
+		dev->regs[0][ENC28_CR_EIR] |= (1 << ENC28_EIR_LINKIF);
+	}
+}
+
+void enc28_sim_reset_stats(ENC28_Sim_Device *dev)
+{
+	memset(&dev->stats, 0, sizeof(dev->stats));
+}
+
+uint64_t enc28_sim_bus_time_ns(const ENC28_Sim_Device *dev, uint32_t spi_clock_hz)
+{
+	if (spi_clock_hz == 0)
+	{
+		return dev->stats.wait_ns;
+	}
+	return ((uint64_t)dev->stats.spi_bytes * 8 * 1000000000ULL) / spi_clock_hz + dev->stats.wait_ns;
+}
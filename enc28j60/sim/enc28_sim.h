@@ -0,0 +1,190 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Sebastian Baginski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * enc28_sim.h
+ *
+ * Host-side software model of the ENC28J60 Ethernet module. The model is
+ * driven through the ENC28_SPI_Context callbacks, so the unmodified driver
+ * can be benchmarked and regression-tested on a Linux build machine.
+ * */
+
+#ifndef ENC28_SIM_H_
+#define ENC28_SIM_H_
+
+#include "enc28j60.h"
+
+#include <pthread.h>
+#include <stdint.h>
+
+/* Size of the ENC28J60 buffer memory */
+#define ENC28_SIM_BUFFER_SIZE (0x2000)
+
+/* Maximum number of simulated devices attached at the same time */
+#ifndef ENC28_SIM_MAX_DEVICES
+#define ENC28_SIM_MAX_DEVICES (2)
+#endif
+
+/* Largest frame captured by the transmit path */
+#define ENC28_SIM_MAX_FRAME_LEN (1536)
+
+/* Size of the transmit status vector written after the frame */
+#define ENC28_SIM_TSV_SIZE (7)
+
+/*
+ * Bus activity counters
+ * */
+typedef struct
+{
+	uint32_t spi_transactions;		/* Number of chip-select assertions */
+	uint32_t spi_bytes;				/* Number of bytes clocked over the SPI bus */
+	uint32_t op_count[8];			/* Number of transactions per SPI opcode (ENC28_OP_*) */
+	uint64_t wait_ns;				/* Nanoseconds requested through wait_nano */
+	uint32_t frames_received;		/* Frames stored in the receive buffer */
+	uint32_t frames_filtered;		/* Frames rejected by the receive filters */
+	uint32_t frames_dropped;		/* Frames dropped due to lack of space */
+	uint32_t frames_transmitted;	/* Frames sent out by the MAC */
+	uint32_t frames_aborted;		/* Transmissions aborted by a simulated late collision */
+	uint32_t dma_transfers;			/* Transfers done by the fake DMA engine */
+	uint32_t dma_bytes;				/* Bytes clocked by the fake DMA engine */
+	uint32_t dma_overlaps;			/* Bus accesses while a DMA transfer was still running */
+	uint32_t checksum_bytes;		/* Bytes summed by the DMA checksum engine */
+} ENC28_Sim_Stats;
+
+typedef struct ENC28_Sim_Device ENC28_Sim_Device;
+
+/*
+ * Called after the simulated MAC has sent a frame
+ * */
+typedef void (*ENC28_Sim_Transmit_Hook)(ENC28_Sim_Device *dev, const uint8_t *frame, uint16_t len, void *user);
+
+/*
+ * Called from the DMA thread when a transfer has completed, the equivalent of the DMA interrupt
+ * */
+typedef void (*ENC28_Sim_Dma_Hook)(ENC28_Sim_Device *dev, void *user);
+
+/*
+ * Thread-backed fake DMA engine, see enc28_sim_attach_dma
+ * */
+typedef struct
+{
+	pthread_t thread;				/* Thread running the current transfer */
+	pthread_mutex_t lock;
+	pthread_cond_t done;
+	uint8_t busy;					/* A transfer has been started and has not completed yet */
+	uint8_t joinable;				/* @p thread has to be joined */
+	const uint8_t *tx;				/* Source of the current transfer, NULL for reads */
+	uint8_t *rx;					/* Destination of the current transfer, NULL for writes */
+	size_t len;
+	uint32_t byte_time_ns;			/* Time the engine takes per byte, 0 completes the transfer immediately */
+	ENC28_Sim_Dma_Hook on_complete;	/* Optional completion notification */
+	void *user;						/* User data passed to on_complete */
+} ENC28_Sim_Dma;
+
+struct ENC28_Sim_Device
+{
+	uint8_t mem[ENC28_SIM_BUFFER_SIZE];		/* Buffer memory */
+	uint8_t regs[4][32];					/* Control registers, common registers live in bank 0 */
+	uint16_t phy_regs[32];					/* PHY registers */
+
+	uint8_t cs_active;						/* Chip-select is asserted */
+	uint8_t opcode;							/* Opcode of the current transaction */
+	uint8_t arg;							/* Argument of the current transaction */
+	uint32_t byte_idx;						/* Bytes clocked in the current transaction */
+
+	uint8_t link_up;						/* State of the link reported by the PHY */
+	uint8_t hold_transmit;					/* Keep TXRTS set until enc28_sim_complete_transmit is called */
+	uint8_t tx_collisions;					/* Collisions reported in the status vector of each transmitted frame [0:15] */
+	uint8_t tx_late_collisions;				/* Number of upcoming transmissions aborted by a late collision */
+	uint8_t tx_frame[ENC28_SIM_MAX_FRAME_LEN];	/* Last transmitted frame */
+	uint16_t tx_frame_len;					/* Length of the last transmitted frame */
+	ENC28_Sim_Transmit_Hook on_transmit;	/* Optional transmit notification */
+	void *user;								/* User data passed to on_transmit */
+
+	ENC28_Sim_Dma dma;						/* Fake DMA engine */
+	ENC28_Sim_Stats stats;
+};
+
+/*
+ * @brief Puts the simulated device in the power-on state and clears the statistics
+ * */
+extern void enc28_sim_init(ENC28_Sim_Device *dev);
+
+/*
+ * @brief Connects the device to the SPI context callbacks
+ * @param dev The simulated device
+ * @param slot Callback slot [0:ENC28_SIM_MAX_DEVICES), each attached device needs its own slot
+ * @param ctx The SPI context to fill in
+ * @return 0 on success, -1 on invalid parameters
+ * */
+extern int32_t enc28_sim_attach(ENC28_Sim_Device *dev, uint8_t slot, ENC28_SPI_Context *ctx);
+
+/*
+ * @brief Connects the device like enc28_sim_attach and enables the asynchronous buffer transfers.
+ * Transfers run on a separate thread, spi_async_wait_op blocks until the transfer has completed.
+ * @param byte_time_ns Time the fake DMA engine takes per byte, 0 completes the transfer before the start call returns
+ * @param on_complete Optional hook called from the DMA thread after each transfer
+ * @param user User data passed to @p on_complete
+ * @return 0 on success, -1 on invalid parameters
+ * */
+extern int32_t enc28_sim_attach_dma(ENC28_Sim_Device *dev, uint8_t slot, ENC28_SPI_Context *ctx,
+		uint32_t byte_time_ns, ENC28_Sim_Dma_Hook on_complete, void *user);
+
+/*
+ * @brief Delivers the frame from the wire to the receive buffer
+ * @param frame The Ethernet frame without the CRC
+ * @param len The size of @p frame
+ * @return 0 if the frame was stored, -1 if the receiver is disabled or the frame was filtered out, -2 if the receive buffer is full
+ * */
+extern int32_t enc28_sim_inject_frame(ENC28_Sim_Device *dev, const uint8_t *frame, uint16_t len);
+
+/*
+ * @brief Finishes the pending transmission when hold_transmit is set
+ * @return 0 on success, -1 if there is no pending transmission
+ * */
+extern int32_t enc28_sim_complete_transmit(ENC28_Sim_Device *dev);
+
+/*
+ * @brief Returns the state of the INT pin (1 = interrupt pending)
+ * */
+extern uint8_t enc28_sim_irq_pending(const ENC28_Sim_Device *dev);
+
+/*
+ * @brief Sets the state of the link reported by the PHY, a change raises EIR.LINKIF when PHIE.PGEIE and PHIE.PLNKIE are set
+ * */
+extern void enc28_sim_set_link(ENC28_Sim_Device *dev, uint8_t link_up);
+
+/*
+ * @brief Clears the bus activity counters
+ * */
+extern void enc28_sim_reset_stats(ENC28_Sim_Device *dev);
+
+/*
+ * @brief Estimates the time spent on the bus: SPI clocking plus the requested waits
+ * @param spi_clock_hz SPI clock frequency
+ * */
+extern uint64_t enc28_sim_bus_time_ns(const ENC28_Sim_Device *dev, uint32_t spi_clock_hz);
+
+#endif /* ENC28_SIM_H_ */
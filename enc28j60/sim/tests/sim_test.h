@@ -0,0 +1,111 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Sebastian Baginski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * sim_test.h
+ *
+ * Helpers shared by the simulator tests. Each test is a separate program,
+ * it prints the failed checks and exits with a non-zero status.
+ * */
+
+#ifndef SIM_TEST_H_
+#define SIM_TEST_H_
+
+#include "enc28_sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int sim_test_failures = 0;
+
+#define SIM_CHECK(cond) \
+	do \
+	{ \
+		if (!(cond)) \
+		{ \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			++sim_test_failures; \
+		} \
+	} while (0)
+
+/* Stops the test when a step fails, the following checks would only report its consequences */
+#define SIM_REQUIRE(cond) \
+	do \
+	{ \
+		if (!(cond)) \
+		{ \
+			fprintf(stderr, "%s:%d: requirement failed: %s\n", __FILE__, __LINE__, #cond); \
+			exit(1); \
+		} \
+	} while (0)
+
+static const ENC28_MAC_Address sim_test_mac = {{0xDE, 0xAD, 0xBE, 0xEF, 0xCC, 0xAA}};
+
+/*
+ * @brief Resets the simulated device, initializes the driver with @p layout (NULL = default) and enables the reception
+ * */
+static inline void sim_test_setup(ENC28_Sim_Device *sim, ENC28_SPI_Context *ctx, ENC28_Device *dev, const ENC28_Buffer_Layout *layout)
+{
+	enc28_sim_init(sim);
+	SIM_REQUIRE(enc28_sim_attach(sim, 0, ctx) == 0);
+	enc28_init_device(dev, ctx);
+	SIM_REQUIRE(enc28_do_soft_reset(dev) == ENC28_OK);
+	SIM_REQUIRE(enc28_do_init(sim_test_mac, layout, dev) == ENC28_OK);
+	SIM_REQUIRE(enc28_begin_packet_transfer(dev) == ENC28_OK);
+}
+
+/*
+ * @brief Fills @p frame with a unicast frame to sim_test_mac, the payload depends on @p seed
+ * */
+static inline void sim_test_make_frame(uint8_t *frame, uint16_t len, uint8_t seed)
+{
+	memcpy(frame, sim_test_mac.addr, 6);
+	for (uint16_t i = 6; i < len; ++i)
+	{
+		frame[i] = (uint8_t)(i * 7 + seed);
+	}
+}
+
+/*
+ * @brief Reads the 13-bit register pair of the simulated device
+ * */
+static inline uint16_t sim_test_reg16(const ENC28_Sim_Device *sim, uint8_t bank, uint8_t addr_lo)
+{
+	return sim->regs[bank][addr_lo] | ((sim->regs[bank][addr_lo + 1] & 0x1F) << 8);
+}
+
+static inline int sim_test_result(const char *name)
+{
+	if (sim_test_failures)
+	{
+		fprintf(stderr, "%s: %d check(s) failed\n", name, sim_test_failures);
+		return 1;
+	}
+	printf("%s: OK\n", name);
+	return 0;
+}
+
+#endif /* SIM_TEST_H_ */
@@ -0,0 +1,223 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Sebastian Baginski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * test_async_dma.c
+ *
+ * Runs buffer transfers at and above ENC28_CONF_SPI_ASYNC_MIN_LEN through the
+ * threaded fake DMA engine. Each transfer has to complete before the next one
+ * starts and before any other bus access, the data has to arrive in order.
+ * */
+
+#include "sim_test.h"
+
+#include <stdatomic.h>
+
+#define DMA_BYTE_TIME_NS	(100)
+#define LOG_SIZE			(64)
+#define RX_BUF_SIZE			(ENC28_CONF_MAX_FRAME_LEN + 4)
+
+static ENC28_Sim_Device sim;
+static ENC28_SPI_Context ctx;
+static ENC28_SPI_Context sim_ctx;
+static ENC28_Device dev;
+
+/* Transfer lengths in the order of the events, negative for a completion */
+static long event_log[LOG_SIZE];
+static atomic_uint event_count;
+static atomic_uint in_flight;
+static atomic_uint max_in_flight;
+
+static void log_event(long value)
+{
+	const unsigned idx = atomic_fetch_add(&event_count, 1);
+	if (idx < LOG_SIZE)
+	{
+		event_log[idx] = value;
+	}
+}
+
+static void on_dma_complete(ENC28_Sim_Device *d, void *user)
+{
+	(void)user;
+	log_event(-(long)d->dma.len);
+	atomic_fetch_sub(&in_flight, 1);
+}
+
+static void start_transfer(size_t len)
+{
+	const unsigned now = atomic_fetch_add(&in_flight, 1) + 1;
+	if (now > atomic_load(&max_in_flight))
+	{
+		atomic_store(&max_in_flight, now);
+	}
+	log_event((long)len);
+}
+
+static void wrap_out_async(const uint8_t *buff, size_t len)
+{
+	start_transfer(len);
+	sim_ctx.spi_out_async_op(buff, len);
+}
+
+static void wrap_in_async(uint8_t *buff, size_t len)
+{
+	start_transfer(len);
+	sim_ctx.spi_in_async_op(buff, len);
+}
+
+static void reset_log(void)
+{
+	atomic_store(&event_count, 0);
+	atomic_store(&max_in_flight, 0);
+}
+
+/* Every start is followed by its own completion before anything else happens */
+static void check_log(const long *expected_lens, unsigned count)
+{
+	SIM_CHECK(atomic_load(&event_count) == 2 * count);
+	for (unsigned i = 0; (i < count) && (2 * i + 1 < LOG_SIZE); ++i)
+	{
+		SIM_CHECK(event_log[2 * i] == expected_lens[i]);
+		SIM_CHECK(event_log[2 * i + 1] == -expected_lens[i]);
+	}
+	SIM_CHECK(atomic_load(&in_flight) == 0);
+	SIM_CHECK(atomic_load(&max_in_flight) <= 1);
+}
+
+static void setup(void)
+{
+	enc28_sim_init(&sim);
+	SIM_REQUIRE(enc28_sim_attach_dma(&sim, 0, &sim_ctx, DMA_BYTE_TIME_NS, on_dma_complete, NULL) == 0);
+	ctx = sim_ctx;
+	ctx.spi_out_async_op = wrap_out_async;
+	ctx.spi_in_async_op = wrap_in_async;
+	SIM_REQUIRE(enc28_init_device(&dev, &ctx) == ENC28_OK);
+	SIM_REQUIRE(enc28_do_soft_reset(&dev) == ENC28_OK);
+	SIM_REQUIRE(enc28_do_init(sim_test_mac, NULL, &dev) == ENC28_OK);
+	SIM_REQUIRE(enc28_begin_packet_transfer(&dev) == ENC28_OK);
+}
+
+static void test_overlap_detection(void)
+{
+	// the counter itself: a register access while the engine is busy is an overlap (a deliberate race on the model)
+	uint8_t buff[256];
+	uint8_t eir = 0;
+	memset(buff, 0, sizeof(buff));
+	sim.dma.byte_time_ns = 20 * 1000;
+	wrap_in_async(buff, sizeof(buff));
+	SIM_CHECK(enc28_do_read_ctl_reg(&dev, ENC28_CR_EIR, &eir) == ENC28_OK);
+	sim_ctx.spi_async_wait_op();
+	sim.dma.byte_time_ns = DMA_BYTE_TIME_NS;
+	SIM_CHECK(sim.stats.dma_overlaps > 0);
+	enc28_sim_reset_stats(&sim);
+}
+
+static void test_writes(void)
+{
+	static const uint16_t lens[] = {ENC28_CONF_SPI_ASYNC_MIN_LEN, ENC28_CONF_SPI_ASYNC_MIN_LEN + 1, 333, 1000, 1514};
+	uint8_t frame[RX_BUF_SIZE];
+
+	for (size_t i = 0; i < sizeof(lens) / sizeof(lens[0]); ++i)
+	{
+		reset_log();
+		sim_test_make_frame(frame, lens[i], (uint8_t)i);
+		SIM_CHECK(enc28_write_packet(&dev, frame, lens[i]) == ENC28_OK);
+
+		const long expected = lens[i];
+		check_log(&expected, 1);
+		SIM_CHECK(sim.tx_frame_len == lens[i]);
+		SIM_CHECK(memcmp(sim.tx_frame, frame, lens[i]) == 0);
+		SIM_CHECK(enc28_check_outgoing_packet_status(&dev, NULL) == ENC28_OK);
+	}
+
+	// below the threshold the blocking callbacks are used
+	reset_log();
+	const uint32_t dma_before = sim.stats.dma_transfers;
+	sim_test_make_frame(frame, ENC28_CONF_SPI_ASYNC_MIN_LEN - 1, 7);
+	SIM_CHECK(enc28_write_packet(&dev, frame, ENC28_CONF_SPI_ASYNC_MIN_LEN - 1) == ENC28_OK);
+	SIM_CHECK(atomic_load(&event_count) == 0);
+	SIM_CHECK(sim.stats.dma_transfers == dma_before);
+	SIM_CHECK(memcmp(sim.tx_frame, frame, ENC28_CONF_SPI_ASYNC_MIN_LEN - 1) == 0);
+	SIM_CHECK(enc28_check_outgoing_packet_status(&dev, NULL) == ENC28_OK);
+}
+
+static void test_reads(void)
+{
+	// lengths without the CRC, the transfers include it
+	static const uint16_t lens[] = {ENC28_CONF_SPI_ASYNC_MIN_LEN - 4, ENC28_CONF_SPI_ASYNC_MIN_LEN, 201, 1514};
+	enum { COUNT = sizeof(lens) / sizeof(lens[0]) };
+	static uint8_t bufs[COUNT][RX_BUF_SIZE];
+	uint8_t frame[RX_BUF_SIZE];
+	long expected[COUNT];
+
+	// one packet per call
+	reset_log();
+	for (size_t i = 0; i < COUNT; ++i)
+	{
+		sim_test_make_frame(frame, lens[i], (uint8_t)(0x40 + i));
+		SIM_REQUIRE(enc28_sim_inject_frame(&sim, frame, lens[i]) == 0);
+		SIM_CHECK(enc28_read_packet(&dev, bufs[0], RX_BUF_SIZE, NULL) == ENC28_OK);
+		SIM_CHECK(memcmp(bufs[0], frame, lens[i]) == 0);
+		expected[i] = lens[i] + 4;
+	}
+	check_log(expected, COUNT);
+
+	// a burst: the transfers of the frames follow each other without an overlap
+	reset_log();
+	uint8_t *buf_ptrs[COUNT];
+	ENC28_Receive_Status_Vector status_vecs[COUNT];
+	uint8_t packets_read = 0;
+	for (size_t i = 0; i < COUNT; ++i)
+	{
+		sim_test_make_frame(frame, lens[COUNT - 1 - i], (uint8_t)(0x60 + i));
+		SIM_REQUIRE(enc28_sim_inject_frame(&sim, frame, lens[COUNT - 1 - i]) == 0);
+		buf_ptrs[i] = bufs[i];
+		expected[i] = lens[COUNT - 1 - i] + 4;
+	}
+	SIM_CHECK(enc28_read_packets_burst(&dev, buf_ptrs, RX_BUF_SIZE, status_vecs, COUNT, &packets_read) == ENC28_OK);
+	SIM_CHECK(packets_read == COUNT);
+	check_log(expected, COUNT);
+	for (size_t i = 0; i < COUNT; ++i)
+	{
+		sim_test_make_frame(frame, lens[COUNT - 1 - i], (uint8_t)(0x60 + i));
+		SIM_CHECK(memcmp(bufs[i], frame, lens[COUNT - 1 - i]) == 0);
+	}
+}
+
+int main(void)
+{
+	setup();
+	test_overlap_detection();
+	const uint32_t spi_bytes_before = dev.stats.spi_bytes;
+	test_writes();
+	test_reads();
+
+	// the driver counts the asynchronous transfers like the blocking ones
+	SIM_CHECK(dev.stats.spi_bytes - spi_bytes_before == sim.stats.spi_bytes);
+	SIM_CHECK(sim.stats.dma_overlaps == 0);
+	SIM_CHECK(sim.stats.dma_transfers > 0);
+	return sim_test_result("test_async_dma");
+}
@@ -0,0 +1,145 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Sebastian Baginski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * test_bank_cache.c
+ *
+ * Checks that the cached register bank (ENC28_Device.curr_bank) always matches
+ * ECON1.BSEL of the device, whichever way ECON1 has been changed.
+ * */
+
+#include "sim_test.h"
+
+static ENC28_Sim_Device sim;
+static ENC28_SPI_Context ctx;
+static ENC28_Device dev;
+
+static uint8_t sim_bank(void)
+{
+	return sim.regs[0][ENC28_CR_ECON1] & ENC28_ECON1_BSEL;
+}
+
+static void test_soft_reset(void)
+{
+	for (uint8_t bank = 0; bank < 4; ++bank)
+	{
+		SIM_CHECK(enc28_select_register_bank(&dev, bank) == ENC28_OK);
+		SIM_CHECK(dev.curr_bank == bank);
+		SIM_CHECK(sim_bank() == bank);
+
+		SIM_CHECK(enc28_do_soft_reset(&dev) == ENC28_OK);
+		SIM_CHECK(dev.curr_bank == 0);
+		SIM_CHECK(sim_bank() == 0);
+	}
+	SIM_REQUIRE(enc28_do_init(sim_test_mac, NULL, &dev) == ENC28_OK);
+	SIM_REQUIRE(enc28_begin_packet_transfer(&dev) == ENC28_OK);
+	SIM_CHECK(dev.curr_bank == sim_bank());
+}
+
+static void test_direct_econ1_writes(void)
+{
+	// write the whole register, the other ECON1 bits must be kept
+	const uint8_t econ1 = sim.regs[0][ENC28_CR_ECON1] & ~ENC28_ECON1_BSEL;
+	SIM_CHECK(enc28_do_write_ctl_reg(&dev, ENC28_CR_ECON1, econ1 | ENC28_ECON1_BANK_SEL(2)) == ENC28_OK);
+	SIM_CHECK(dev.curr_bank == 2);
+	SIM_CHECK(sim_bank() == 2);
+
+	// bit field commands on the bank bits
+	SIM_CHECK(enc28_do_set_bits_ctl_reg(&dev, ENC28_CR_ECON1, ENC28_ECON1_BANK_SEL(1)) == ENC28_OK);
+	SIM_CHECK(dev.curr_bank == 3);
+	SIM_CHECK(sim_bank() == 3);
+	SIM_CHECK(enc28_do_clear_bits_ctl_reg(&dev, ENC28_CR_ECON1, ENC28_ECON1_BANK_SEL(2)) == ENC28_OK);
+	SIM_CHECK(dev.curr_bank == 1);
+	SIM_CHECK(sim_bank() == 1);
+
+	// bit field commands on the other bits leave the bank alone
+	SIM_CHECK(enc28_do_set_bits_ctl_reg(&dev, ENC28_CR_ECON1, 1 << ENC28_ECON1_CSUM_EN) == ENC28_OK);
+	SIM_CHECK(enc28_do_clear_bits_ctl_reg(&dev, ENC28_CR_ECON1, 1 << ENC28_ECON1_CSUM_EN) == ENC28_OK);
+	SIM_CHECK(dev.curr_bank == 1);
+	SIM_CHECK(sim_bank() == 1);
+
+	// the cache is used right after a direct write
+	uint8_t erxfcon = 0;
+	SIM_CHECK(enc28_do_read_ctl_reg(&dev, ENC28_CR_ERXFCON, &erxfcon) == ENC28_OK);
+	SIM_CHECK(erxfcon == sim.regs[1][ENC28_CR_ERXFCON]);
+
+	SIM_CHECK(enc28_do_write_ctl_reg(&dev, ENC28_CR_ECON1, econ1) == ENC28_OK);
+	SIM_CHECK(dev.curr_bank == 0);
+	SIM_CHECK(sim_bank() == 0);
+	SIM_CHECK(enc28_select_register_bank(&dev, 3) == ENC28_OK);
+	SIM_CHECK(sim_bank() == 3);
+
+	uint8_t erevid = 0;
+	SIM_CHECK(enc28_do_read_ctl_reg(&dev, ENC28_CR_EREVID, &erevid) == ENC28_OK);
+	SIM_CHECK(erevid == sim.regs[3][ENC28_CR_EREVID]);
+}
+
+static void test_common_registers(void)
+{
+	for (uint8_t bank = 0; bank < 4; ++bank)
+	{
+		SIM_CHECK(enc28_select_register_bank(&dev, bank) == ENC28_OK);
+
+		const uint32_t bfs_before = sim.stats.op_count[ENC28_OP_BFS];
+		const uint32_t bfc_before = sim.stats.op_count[ENC28_OP_BFC];
+		uint8_t eir = 0xFF;
+		uint8_t estat = 0;
+		SIM_CHECK(enc28_do_read_ctl_reg(&dev, ENC28_CR_EIR, &eir) == ENC28_OK);
+		SIM_CHECK(enc28_do_read_ctl_reg(&dev, ENC28_CR_ESTAT, &estat) == ENC28_OK);
+		SIM_CHECK(enc28_do_write_ctl_reg(&dev, ENC28_CR_EIE, sim.regs[0][ENC28_CR_EIE]) == ENC28_OK);
+		SIM_CHECK(enc28_do_set_bits_ctl_reg(&dev, ENC28_CR_ECON2, 1 << ENC28_ECON2_AUTOINC) == ENC28_OK);
+
+		// common registers need no bank switch and leave the selected bank alone
+		SIM_CHECK(sim.stats.op_count[ENC28_OP_BFS] == bfs_before + 1);
+		SIM_CHECK(sim.stats.op_count[ENC28_OP_BFC] == bfc_before);
+		SIM_CHECK(eir == sim.regs[0][ENC28_CR_EIR]);
+		SIM_CHECK(estat == sim.regs[0][ENC28_CR_ESTAT]);
+		SIM_CHECK(dev.curr_bank == bank);
+		SIM_CHECK(sim_bank() == bank);
+	}
+
+	// a frame round trip switches banks all over the place
+	uint8_t frame[128];
+	uint8_t rx_buf[sizeof(frame) + 4];	// the CRC is stored with the frame
+	sim_test_make_frame(frame, sizeof(frame), 3);
+	SIM_CHECK(enc28_write_packet(&dev, frame, sizeof(frame)) == ENC28_OK);
+	SIM_CHECK(dev.curr_bank == sim_bank());
+	SIM_CHECK(enc28_check_outgoing_packet_status(&dev, NULL) == ENC28_OK);
+	SIM_CHECK(dev.curr_bank == sim_bank());
+	SIM_CHECK(enc28_sim_inject_frame(&sim, frame, sizeof(frame)) == 0);
+	SIM_CHECK(enc28_read_packet(&dev, rx_buf, sizeof(rx_buf), NULL) == ENC28_OK);
+	SIM_CHECK(memcmp(rx_buf, frame, sizeof(frame)) == 0);
+	SIM_CHECK(dev.curr_bank == sim_bank());
+}
+
+int main(void)
+{
+	sim_test_setup(&sim, &ctx, &dev, NULL);
+	test_soft_reset();
+	test_direct_econ1_writes();
+	test_common_registers();
+	SIM_CHECK(dev.stats.spi_bytes == sim.stats.spi_bytes);
+	return sim_test_result("test_bank_cache");
+}
@@ -0,0 +1,336 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Sebastian Baginski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * test_rx_wrap.c
+ *
+ * Drives the receive ring across the ERXND -> ERXST wraparound for the default
+ * layout, every enc28_make_buffer_layout layout and a few custom ones, with the
+ * single packet, burst and sized read paths. Checks the frame contents and that
+ * ERXRDPT is always odd and inside the ring.
+ * */
+
+#include "sim_test.h"
+
+#define RX_BUF_SIZE		(ENC28_CONF_MAX_FRAME_LEN + 4)
+#define BATCH_MAX		(8)
+#define MIN_WRAPS		(3)
+#define PACKET_HDR_SIZE	(6)		/* Next packet pointer and receive status vector in front of each frame */
+
+typedef enum
+{
+	READ_SINGLE,
+	READ_BURST,
+	READ_SIZED,
+	READ_MODE_COUNT
+} read_mode_t;
+
+static const char *const read_mode_names[READ_MODE_COUNT] = {"single", "burst", "sized"};
+
+static ENC28_Sim_Device sim;
+static ENC28_SPI_Context ctx;
+static ENC28_Device dev;
+
+static uint8_t rx_bufs[BATCH_MAX][RX_BUF_SIZE];
+static uint8_t sized_next = 0;
+
+static uint8_t *sized_alloc(uint16_t packet_len, void *user)
+{
+	(void)user;
+	if ((packet_len > RX_BUF_SIZE) || (sized_next >= BATCH_MAX))
+	{
+		return NULL;
+	}
+	return rx_bufs[sized_next++];
+}
+
+/* Frame lengths without the CRC, odd and even, small and full size */
+static uint16_t frame_len_at(uint32_t i)
+{
+	static const uint16_t lens[] = {60, 1514, 61, 333, 1001, 64, 1500, 127, 590, 1513, 75, 768};
+	return lens[i % (sizeof(lens) / sizeof(lens[0]))];
+}
+
+static uint16_t packet_size_of(uint16_t len)
+{
+	// status vector, frame with the CRC, padding to the even address of the next packet
+	return (PACKET_HDR_SIZE + len + 4 + 1) & ~0x1;
+}
+
+static void check_rx_read_ptr(const ENC28_Buffer_Layout *layout)
+{
+	const uint16_t erxrdpt = sim_test_reg16(&sim, 0, ENC28_CR_ERXRDPTL);
+	const uint16_t expected = (dev.next_packet_ptr == layout->rx_start) ? layout->rx_end : (dev.next_packet_ptr - 1);
+
+	SIM_CHECK(erxrdpt & 0x1);
+	SIM_CHECK((erxrdpt >= layout->rx_start) && (erxrdpt <= layout->rx_end));
+	SIM_CHECK(erxrdpt == expected);
+}
+
+static void check_frame(const uint8_t *buf, uint16_t packet_len, uint16_t len, uint8_t seed)
+{
+	uint8_t expected[RX_BUF_SIZE];
+	sim_test_make_frame(expected, len, seed);
+	SIM_CHECK(packet_len == len + 4);
+	SIM_CHECK(memcmp(buf, expected, len) == 0);
+}
+
+static void run_layout(const char *name, const ENC28_Buffer_Layout *layout)
+{
+	SIM_REQUIRE(enc28_check_buffer_layout(layout) == ENC28_OK);
+
+	for (int mode = 0; mode < READ_MODE_COUNT; ++mode)
+	{
+		sim_test_setup(&sim, &ctx, &dev, layout);
+		SIM_CHECK(sim_test_reg16(&sim, 0, ENC28_CR_ERXSTL) == layout->rx_start);
+		SIM_CHECK(sim_test_reg16(&sim, 0, ENC28_CR_ERXNDL) == layout->rx_end);
+		check_rx_read_ptr(layout);
+
+		const int failures_before = sim_test_failures;
+		uint32_t frame_idx = 0;
+		uint32_t wraps = 0;
+		uint32_t split_frames = 0;
+
+		for (uint32_t round = 0; (wraps < MIN_WRAPS) && (round < 200); ++round)
+		{
+			uint16_t lens[BATCH_MAX];
+			uint8_t seeds[BATCH_MAX];
+			uint16_t starts[BATCH_MAX];
+			uint8_t count = 0;
+
+			// fill the ring as far as it goes, the frames end up on both sides of the wraparound
+			const uint8_t batch = (mode == READ_SINGLE) ? 1 + (round % BATCH_MAX) : BATCH_MAX;
+			while (count < batch)
+			{
+				uint8_t frame[RX_BUF_SIZE];
+				const uint16_t len = frame_len_at(frame_idx);
+				const uint8_t seed = (uint8_t)frame_idx;
+				sim_test_make_frame(frame, len, seed);
+				if (enc28_sim_inject_frame(&sim, frame, len) != 0)
+				{
+					break;
+				}
+				lens[count] = len;
+				seeds[count] = seed;
+				++count;
+				++frame_idx;
+			}
+			SIM_REQUIRE(count > 0);
+
+			ENC28_Receive_Status_Vector status_vecs[BATCH_MAX];
+			uint8_t *bufs[BATCH_MAX];
+			uint8_t packets_read = 0;
+			for (uint8_t i = 0; i < BATCH_MAX; ++i)
+			{
+				bufs[i] = rx_bufs[i];
+			}
+
+			const uint16_t first_ptr = dev.next_packet_ptr;
+			if (mode == READ_SINGLE)
+			{
+				for (uint8_t i = 0; i < count; ++i)
+				{
+					starts[i] = dev.next_packet_ptr;
+					SIM_CHECK(enc28_read_packet(&dev, rx_bufs[i], RX_BUF_SIZE, &status_vecs[i]) == ENC28_OK);
+					check_rx_read_ptr(layout);
+					if (dev.next_packet_ptr < starts[i])
+					{
+						++wraps;
+					}
+				}
+				packets_read = count;
+			}
+			else if (mode == READ_BURST)
+			{
+				SIM_CHECK(enc28_read_packets_burst(&dev, bufs, RX_BUF_SIZE, status_vecs, count, &packets_read) == ENC28_OK);
+			}
+			else
+			{
+				const ENC28_Rx_Buffer_Provider provider = {sized_alloc, RX_BUF_SIZE, NULL};
+				sized_next = 0;
+				SIM_CHECK(enc28_read_packets_sized(&dev, &provider, status_vecs, count, &packets_read) == ENC28_OK);
+			}
+			SIM_CHECK(packets_read == count);
+			check_rx_read_ptr(layout);
+
+			if (mode != READ_SINGLE)
+			{
+				// the packet positions follow from the lengths: status vector, frame with the CRC, even padding
+				uint16_t ptr = first_ptr;
+				for (uint8_t i = 0; i < count; ++i)
+				{
+					starts[i] = ptr;
+					ptr = layout->rx_start + ((ptr - layout->rx_start + packet_size_of(lens[i])) % (layout->rx_end - layout->rx_start + 1));
+					if (ptr < starts[i])
+					{
+						++wraps;
+					}
+				}
+				SIM_CHECK(ptr == dev.next_packet_ptr);
+			}
+
+			for (uint8_t i = 0; i < packets_read; ++i)
+			{
+				const uint16_t packet_len = (status_vecs[i].packet_len_hi << 8) | status_vecs[i].packet_len_lo;
+				check_frame(rx_bufs[i], packet_len, lens[i], seeds[i]);
+				if ((uint32_t)starts[i] + PACKET_HDR_SIZE + packet_len > (uint32_t)layout->rx_end + 1)
+				{
+					++split_frames;
+				}
+			}
+
+			SIM_CHECK(sim.regs[1][ENC28_CR_EPKTCNT] == 0);
+			if (sim_test_failures != failures_before)
+			{
+				break;
+			}
+		}
+
+		SIM_CHECK(wraps >= MIN_WRAPS);
+		SIM_CHECK(split_frames > 0);
+		SIM_CHECK(sim.stats.frames_received == frame_idx);
+		if (sim_test_failures != failures_before)
+		{
+			fprintf(stderr, "layout %s [0x%04X:0x%04X], %s reads failed\n", name, layout->rx_start, layout->rx_end, read_mode_names[mode]);
+		}
+	}
+}
+
+static void inject_and_read(uint16_t len, uint8_t seed, read_mode_t mode)
+{
+	uint8_t frame[RX_BUF_SIZE];
+	ENC28_Receive_Status_Vector status_vec;
+	uint8_t packets_read = 0;
+
+	sim_test_make_frame(frame, len, seed);
+	SIM_REQUIRE(enc28_sim_inject_frame(&sim, frame, len) == 0);
+	if (mode == READ_BURST)
+	{
+		uint8_t *bufs[1] = {rx_bufs[0]};
+		SIM_CHECK(enc28_read_packets_burst(&dev, bufs, RX_BUF_SIZE, &status_vec, 1, &packets_read) == ENC28_OK);
+	}
+	else if (mode == READ_SIZED)
+	{
+		const ENC28_Rx_Buffer_Provider provider = {sized_alloc, RX_BUF_SIZE, NULL};
+		sized_next = 0;
+		SIM_CHECK(enc28_read_packets_sized(&dev, &provider, &status_vec, 1, &packets_read) == ENC28_OK);
+	}
+	else
+	{
+		SIM_CHECK(enc28_read_packet(&dev, rx_bufs[0], RX_BUF_SIZE, &status_vec) == ENC28_OK);
+		packets_read = 1;
+	}
+	SIM_CHECK(packets_read == 1);
+	check_frame(rx_bufs[0], (status_vec.packet_len_hi << 8) | status_vec.packet_len_lo, len, seed);
+}
+
+/*
+ * A packet ending on ERXND puts the next one at ERXST, ERXRDPT then has to be ERXND instead of ERXST - 1
+ * */
+static void run_exact_wrap(const char *name, const ENC28_Buffer_Layout *layout)
+{
+	for (int mode = 0; mode < READ_MODE_COUNT; ++mode)
+	{
+		sim_test_setup(&sim, &ctx, &dev, layout);
+		const int failures_before = sim_test_failures;
+
+		for (uint8_t pass = 0; pass < 2; ++pass)
+		{
+			uint16_t room = layout->rx_end + 1 - dev.next_packet_ptr;
+			while ((room < packet_size_of(60)) || (room > packet_size_of(1514)))
+			{
+				inject_and_read((room < packet_size_of(60)) ? 60 : 1000, pass, (read_mode_t)mode);
+				room = layout->rx_end + 1 - dev.next_packet_ptr;
+			}
+
+			inject_and_read(room - packet_size_of(0), 0x80 + pass, (read_mode_t)mode);
+			SIM_CHECK(dev.next_packet_ptr == layout->rx_start);
+			check_rx_read_ptr(layout);
+		}
+
+		if (sim_test_failures != failures_before)
+		{
+			fprintf(stderr, "layout %s [0x%04X:0x%04X], %s reads up to ERXND failed\n", name, layout->rx_start, layout->rx_end, read_mode_names[mode]);
+		}
+	}
+}
+
+static void test_rejected_layouts(void)
+{
+	ENC28_Buffer_Layout layout;
+	SIM_REQUIRE(enc28_make_buffer_layout(&layout, 1) == ENC28_OK);
+
+	// errata: the ring has to start at address 0
+	layout.rx_start = 2;
+	SIM_CHECK(enc28_check_buffer_layout(&layout) == ENC28_INVALID_PARAM);
+	layout.rx_start = 0x05FA;
+	SIM_CHECK(enc28_check_buffer_layout(&layout) == ENC28_INVALID_PARAM);
+
+	// ERXRDPT must be odd, so does the end of the ring
+	layout.rx_start = 0;
+	layout.rx_end -= 1;
+	SIM_CHECK(enc28_check_buffer_layout(&layout) == ENC28_INVALID_PARAM);
+
+	// too short for a full-size frame
+	layout.rx_end = PACKET_HDR_SIZE + ENC28_CONF_MAX_FRAME_LEN - 1;
+	SIM_CHECK(enc28_check_buffer_layout(&layout) == ENC28_INVALID_PARAM);
+}
+
+int main(void)
+{
+	ENC28_Buffer_Layout layout;
+
+	enc28_default_buffer_layout(&layout);
+	run_layout("default", &layout);
+	run_exact_wrap("default", &layout);
+
+	for (uint8_t slots = 1; slots <= ENC28_CONF_TX_MAX_SLOTS; ++slots)
+	{
+		char name[32];
+		SIM_REQUIRE(enc28_make_buffer_layout(&layout, slots) == ENC28_OK);
+		snprintf(name, sizeof(name), "make(%u)", slots);
+		run_layout(name, &layout);
+		run_exact_wrap(name, &layout);
+	}
+
+	// custom rings: smallest one allowed, odd ends away from the transmit slots
+	static const ENC28_Buffer_Layout custom[] = {
+		{0x0000, PACKET_HDR_SIZE + ENC28_CONF_MAX_FRAME_LEN + 3, 0x1000, 2},
+		{0x0000, 0x07FF, 0x0800, 3},
+		{0x0000, 0x0A01, 0x0A02, 3},
+		{0x0000, 0x0D33, 0x1000, 2},
+		{0x0000, 0x1235, 0x1800, 1},
+	};
+	for (size_t i = 0; i < sizeof(custom) / sizeof(custom[0]); ++i)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "custom(%u)", (unsigned)i);
+		run_layout(name, &custom[i]);
+		run_exact_wrap(name, &custom[i]);
+	}
+
+	test_rejected_layouts();
+	return sim_test_result("test_rx_wrap");
+}
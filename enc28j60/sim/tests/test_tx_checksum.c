@@ -0,0 +1,133 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Sebastian Baginski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * test_tx_checksum.c
+ *
+ * Checks the checksum filled in by the DMA engine after the upload, with and
+ * without a seed, against a checksum computed on the host. The segments passed
+ * to the driver must not be modified.
+ * */
+
+#include "sim_test.h"
+
+#define IP_HDR_LEN		(20)
+#define TCP_OFFSET		(14 + IP_HDR_LEN)
+#define TCP_CSUM_OFFSET	(TCP_OFFSET + 16)
+
+static ENC28_Sim_Device sim;
+static ENC28_SPI_Context ctx;
+static ENC28_Device dev;
+
+static uint32_t sum_words(const uint8_t *data, uint16_t len, uint32_t sum)
+{
+	for (uint16_t i = 0; i + 1 < len; i += 2)
+	{
+		sum += ((uint32_t)data[i] << 8) | data[i + 1];
+	}
+	if (len & 0x1)
+	{
+		sum += (uint32_t)data[len - 1] << 8;
+	}
+	return sum;
+}
+
+static uint16_t fold(uint32_t sum)
+{
+	while (sum >> 16)
+	{
+		sum = (sum >> 16) + (sum & 0xFFFF);
+	}
+	return (uint16_t)sum;
+}
+
+/* IPv4 frame carrying a TCP segment of @p tcp_len bytes with a zero checksum field */
+static void make_tcp_frame(uint8_t *frame, uint16_t tcp_len)
+{
+	sim_test_make_frame(frame, TCP_OFFSET + tcp_len, (uint8_t)tcp_len);
+	frame[12] = 0x08;
+	frame[13] = 0x00;
+	frame[14] = 0x45;
+	frame[23] = 6;
+	frame[TCP_CSUM_OFFSET] = 0;
+	frame[TCP_CSUM_OFFSET + 1] = 0;
+}
+
+static uint16_t pseudo_header_sum(const uint8_t *frame, uint16_t tcp_len)
+{
+	// source and destination addresses, protocol, TCP length
+	return fold(sum_words(frame + 26, 8, 6u + tcp_len));
+}
+
+static void send_and_check(uint16_t tcp_len, uint8_t use_seed)
+{
+	uint8_t frame[ENC28_SIM_MAX_FRAME_LEN];
+	uint8_t copy[ENC28_SIM_MAX_FRAME_LEN];
+	const uint16_t frame_len = TCP_OFFSET + tcp_len;
+	make_tcp_frame(frame, tcp_len);
+	memcpy(copy, frame, frame_len);
+
+	const uint16_t seed = use_seed ? pseudo_header_sum(frame, tcp_len) : 0;
+	uint16_t expected = ~fold(sum_words(frame + TCP_OFFSET, tcp_len, seed));
+	if (expected == 0)
+	{
+		expected = 0xFFFF;
+	}
+
+	// split the headers from the payload, like a pbuf chain
+	const ENC28_Packet_Segment segments[2] = {
+		{frame, TCP_OFFSET + 20},
+		{frame + TCP_OFFSET + 20, tcp_len - 20},
+	};
+	const ENC28_Tx_Checksum csum = {TCP_OFFSET, tcp_len, TCP_CSUM_OFFSET, seed};
+	SIM_CHECK(enc28_write_packet_chain(&dev, segments, 2, &csum) == ENC28_OK);
+	SIM_CHECK(enc28_check_outgoing_packet_status(&dev, NULL) == ENC28_OK);
+
+	SIM_CHECK(memcmp(frame, copy, frame_len) == 0);
+	SIM_CHECK(sim.tx_frame_len == frame_len);
+	SIM_CHECK(((sim.tx_frame[TCP_CSUM_OFFSET] << 8) | sim.tx_frame[TCP_CSUM_OFFSET + 1]) == expected);
+	// the rest of the frame goes out as uploaded
+	SIM_CHECK(memcmp(sim.tx_frame, frame, TCP_CSUM_OFFSET) == 0);
+	SIM_CHECK(memcmp(sim.tx_frame + TCP_CSUM_OFFSET + 2, frame + TCP_CSUM_OFFSET + 2, frame_len - TCP_CSUM_OFFSET - 2) == 0);
+
+	if (use_seed)
+	{
+		// the receiver's check: pseudo header plus the segment with its checksum folds to 0xFFFF
+		SIM_CHECK(fold(sum_words(sim.tx_frame + TCP_OFFSET, tcp_len, pseudo_header_sum(sim.tx_frame, tcp_len))) == 0xFFFF);
+	}
+}
+
+int main(void)
+{
+	static const uint16_t tcp_lens[] = {20, 21, 100, 1001, 1024, 1480};
+
+	sim_test_setup(&sim, &ctx, &dev, NULL);
+	for (size_t i = 0; i < sizeof(tcp_lens) / sizeof(tcp_lens[0]); ++i)
+	{
+		send_and_check(tcp_lens[i], 0);
+		send_and_check(tcp_lens[i], 1);
+	}
+	return sim_test_result("test_tx_checksum");
+}
@@ -0,0 +1,180 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Sebastian Baginski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * test_tx_errors.c
+ *
+ * Checks that a frame is only completed once EIR.TXIF is set. The model sets
+ * EIR.TXERIF when ECON1.TXRST is cleared, like the silicon described in the
+ * errata, so every transmission start produces a flag that is not a real error.
+ * Flags that do not belong to a frame in flight must still be cleared.
+ * */
+
+#include "sim_test.h"
+
+static ENC28_Sim_Device sim;
+static ENC28_SPI_Context ctx;
+static ENC28_Device dev;
+
+static uint32_t tx_done_count = 0;
+static ENC28_CommandStatus last_tx_status = ENC28_OK;
+
+static void on_transmit_done(ENC28_Device *d, ENC28_CommandStatus tx_status, const ENC28_Transmit_Status_Vector *status_vec, void *user)
+{
+	(void)d;
+	(void)status_vec;
+	(void)user;
+	tx_done_count++;
+	last_tx_status = tx_status;
+}
+
+static const ENC28_Interrupt_Handlers handlers = {
+	.transmit_done = on_transmit_done,
+};
+
+static uint8_t sim_eir(void)
+{
+	return sim.regs[0][ENC28_CR_EIR];
+}
+
+static uint8_t sim_tx_busy(void)
+{
+	return (sim.regs[0][ENC28_CR_ECON1] & (1 << ENC28_ECON1_TXRTS)) ? 1 : 0;
+}
+
+static void test_txerif_after_start(void)
+{
+	uint8_t frame[100];
+	sim_test_make_frame(frame, sizeof(frame), 1);
+
+	sim.hold_transmit = 1;
+	SIM_CHECK(enc28_write_packet(&dev, frame, sizeof(frame)) == ENC28_OK);
+	SIM_CHECK(sim_tx_busy());
+	// the flag raised by the transmit logic reset is cleared before the frame is started
+	SIM_CHECK((sim_eir() & (1 << ENC28_EIR_TXERIF)) == 0);
+
+	SIM_CHECK(enc28_service_interrupts(&dev, &handlers, NULL) == ENC28_OK);
+	SIM_CHECK(tx_done_count == 0);
+	SIM_CHECK(dev.tx_count == 1);
+
+	// a stray TXERIF while the frame is still on the wire
+	sim.regs[0][ENC28_CR_EIR] |= (1 << ENC28_EIR_TXERIF);
+	SIM_CHECK(enc28_service_interrupts(&dev, &handlers, NULL) == ENC28_OK);
+	SIM_CHECK(tx_done_count == 0);
+	SIM_CHECK(dev.tx_count == 1);
+	SIM_CHECK(dev.stats.tx_stray_errors == 1);
+	SIM_CHECK((sim_eir() & (1 << ENC28_EIR_TXERIF)) == 0);
+	SIM_CHECK(sim_tx_busy());
+	SIM_CHECK(enc28_check_outgoing_packet_status(&dev, NULL) == ENC28_NO_DATA);
+
+	SIM_CHECK(enc28_sim_complete_transmit(&sim) == 0);
+	SIM_CHECK(enc28_service_interrupts(&dev, &handlers, NULL) == ENC28_OK);
+	SIM_CHECK(tx_done_count == 1);
+	SIM_CHECK(last_tx_status == ENC28_OK);
+	SIM_CHECK(dev.tx_count == 0);
+	SIM_CHECK(sim.stats.frames_transmitted == 1);
+}
+
+static void test_queued_frames(void)
+{
+	uint8_t frame[200];
+	const uint8_t frame_count = dev.layout.tx_slot_count;
+	tx_done_count = 0;
+
+	for (uint8_t i = 0; i < frame_count; ++i)
+	{
+		sim_test_make_frame(frame, sizeof(frame), 10 + i);
+		SIM_CHECK(enc28_write_packet(&dev, frame, sizeof(frame)) == ENC28_OK);
+	}
+	SIM_CHECK(dev.tx_count == frame_count);
+
+	for (uint8_t i = 0; i < frame_count; ++i)
+	{
+		SIM_CHECK(enc28_service_interrupts(&dev, &handlers, NULL) == ENC28_OK);
+		SIM_CHECK(tx_done_count == i);
+
+		SIM_CHECK(enc28_sim_complete_transmit(&sim) == 0);
+		sim_test_make_frame(frame, sizeof(frame), 10 + i);
+		SIM_CHECK(memcmp(sim.tx_frame, frame, sizeof(frame)) == 0);
+
+		// completing the frame starts the next one, the reset must not leave TXERIF behind
+		SIM_CHECK(enc28_service_interrupts(&dev, &handlers, NULL) == ENC28_OK);
+		SIM_CHECK(tx_done_count == i + 1u);
+		SIM_CHECK(last_tx_status == ENC28_OK);
+		SIM_CHECK((sim_eir() & (1 << ENC28_EIR_TXERIF)) == 0);
+	}
+	SIM_CHECK(dev.tx_count == 0);
+	SIM_CHECK(dev.stats.tx_stray_errors == 1);
+}
+
+static void test_aborted_frame(void)
+{
+	uint8_t frame[80];
+	sim_test_make_frame(frame, sizeof(frame), 20);
+	tx_done_count = 0;
+
+	// an abort sets TXIF together with TXERIF, that one is a real error
+	sim.tx_late_collisions = 1;
+	SIM_CHECK(enc28_write_packet(&dev, frame, sizeof(frame)) == ENC28_OK);
+	SIM_CHECK(enc28_sim_complete_transmit(&sim) == 0);
+	SIM_CHECK((sim_eir() & ((1 << ENC28_EIR_TXIF) | (1 << ENC28_EIR_TXERIF))) == ((1 << ENC28_EIR_TXIF) | (1 << ENC28_EIR_TXERIF)));
+
+	// the frame is sent again and reported once the retry is done
+	SIM_CHECK(enc28_service_interrupts(&dev, &handlers, NULL) == ENC28_OK);
+	SIM_CHECK(tx_done_count == 0);
+	SIM_CHECK(dev.stats.tx_retries == 1);
+	SIM_CHECK(sim_tx_busy());
+	SIM_CHECK((sim_eir() & (1 << ENC28_EIR_TXERIF)) == 0);
+
+	SIM_CHECK(enc28_sim_complete_transmit(&sim) == 0);
+	SIM_CHECK(enc28_service_interrupts(&dev, &handlers, NULL) == ENC28_OK);
+	SIM_CHECK(tx_done_count == 1);
+	SIM_CHECK(last_tx_status == ENC28_OK);
+	SIM_CHECK(dev.stats.tx_stray_errors == 1);
+}
+
+static void test_stray_txif(void)
+{
+	tx_done_count = 0;
+	SIM_CHECK(dev.tx_count == 0);
+
+	// TXIF with nothing in flight completes no frame, but must not be left set either
+	sim.regs[0][ENC28_CR_EIR] |= (1 << ENC28_EIR_TXIF);
+	SIM_CHECK(enc28_service_interrupts(&dev, &handlers, NULL) == ENC28_OK);
+	SIM_CHECK(tx_done_count == 0);
+	SIM_CHECK(dev.stats.tx_stray_errors == 2);
+	SIM_CHECK((sim_eir() & ((1 << ENC28_EIR_TXIF) | (1 << ENC28_EIR_TXERIF))) == 0);
+	SIM_CHECK(!enc28_sim_irq_pending(&sim));
+}
+
+int main(void)
+{
+	sim_test_setup(&sim, &ctx, &dev, NULL);
+	test_txerif_after_start();
+	test_queued_frames();
+	test_aborted_frame();
+	test_stray_txif();
+	return sim_test_result("test_tx_errors");
+}
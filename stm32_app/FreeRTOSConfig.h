@@ -59,6 +59,7 @@
 #define configGENERATE_RUN_TIME_STATS	0
 #define configKERNEL_PROVIDED_STATIC_MEMORY 1
 #define configSUPPORT_STATIC_ALLOCATION 1
+#define configTASK_NOTIFICATION_ARRAY_ENTRIES	2
 
 #define configUSE_TIMERS				0
 #define configTIMER_TASK_PRIORITY		( 2 )
@@ -81,7 +81,10 @@ int32_t enc28_debug_handle_ping(const uint8_t *pkt_buf, uint16_t pkt_size, uint8
 		return -2;
 	}
 
-	memcpy(resp_buf, pkt_buf, resp_size);
+	if (resp_buf != pkt_buf)
+	{
+		memcpy(resp_buf, pkt_buf, resp_size);
+	}
 
 	src_eth_hdr = (struct enc28_eth_header *)pkt_buf;
 	dest_eth_hdr = (struct enc28_eth_header *)resp_buf;
@@ -89,10 +92,17 @@ int32_t enc28_debug_handle_ping(const uint8_t *pkt_buf, uint16_t pkt_size, uint8
 	dest_ipv4 = (struct enc28_ipv4_header *)(resp_buf + sizeof(*dest_eth_hdr));
 	dest_icmp = (struct enc28_icmp_ping_header *)(resp_buf + sizeof(*dest_eth_hdr) + sizeof(*dest_ipv4));
 
-	memcpy(dest_eth_hdr->mac_dest, src_eth_hdr->mac_src, sizeof(dest_eth_hdr->mac_dest));
-	memcpy(dest_eth_hdr->mac_src, src_eth_hdr->mac_dest, sizeof(dest_eth_hdr->mac_src));
-	memcpy(dest_ipv4->addr_dest, src_ipv4->addr_src, sizeof(dest_ipv4->addr_dest));
-	memcpy(dest_ipv4->addr_src, src_ipv4->addr_dest, sizeof(dest_ipv4->addr_src));
+	{
+		// the response can be built in place of the request, keep a copy of the overwritten addresses
+		uint8_t mac_addr[6];
+		uint8_t ip_addr[4];
+		memcpy(mac_addr, src_eth_hdr->mac_src, sizeof(mac_addr));
+		memcpy(ip_addr, src_ipv4->addr_src, sizeof(ip_addr));
+		memcpy(dest_eth_hdr->mac_src, src_eth_hdr->mac_dest, sizeof(dest_eth_hdr->mac_src));
+		memcpy(dest_eth_hdr->mac_dest, mac_addr, sizeof(dest_eth_hdr->mac_dest));
+		memcpy(dest_ipv4->addr_src, src_ipv4->addr_dest, sizeof(dest_ipv4->addr_src));
+		memcpy(dest_ipv4->addr_dest, ip_addr, sizeof(dest_ipv4->addr_dest));
+	}
 
 	dest_icmp->type = 0x0; // ping response
 	dest_icmp->checksum += 0x8; // adjust checksum
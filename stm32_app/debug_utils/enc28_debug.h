@@ -85,6 +85,7 @@ extern uint8_t enc28_debug_is_ping_request(const uint8_t *pkt_buf, uint16_t pkt_
 
 /*
  * @brief Creates a ping message reposnse
+ * @note @p resp_buf can be the same buffer as @p pkt_buf
  * */
 extern int32_t enc28_debug_handle_ping(const uint8_t *pkt_buf, uint16_t pkt_size, uint8_t *resp_buf, uint16_t resp_size);
 
@@ -0,0 +1,73 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Sebastian Baginski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * enc28_trace.c
+ *
+ * Implementation of the binary trace ring.
+ * */
+
+#include "enc28_trace.h"
+
+struct enc28_trace_entry_t enc28_trace_ring[ENC28_TRACE_RING_SIZE];
+volatile uint32_t enc28_trace_head;
+
+uint8_t enc28_trace_read(uint32_t *cursor, struct enc28_trace_entry_t *entry)
+{
+	const uint32_t head = __atomic_load_n(&enc28_trace_head, __ATOMIC_ACQUIRE);
+
+	if (*cursor == head)
+	{
+		return 0;
+	}
+
+	if (head - *cursor > ENC28_TRACE_RING_SIZE)
+	{
+		// the oldest entries were overwritten
+		*cursor = head - ENC28_TRACE_RING_SIZE;
+	}
+
+	*entry = enc28_trace_ring[*cursor & (ENC28_TRACE_RING_SIZE - 1)];
+	++(*cursor);
+	return 1;
+}
+
+const char *enc28_trace_event_name(uint16_t event)
+{
+	static const char *const names[ENC28_TRACE_EVENT_COUNT] = {
+		[ENC28_TRACE_IRQ] = "irq",
+		[ENC28_TRACE_RX_FRAME] = "rx_frame",
+		[ENC28_TRACE_RX_STALL] = "rx_stall",
+		[ENC28_TRACE_TX_QUEUED] = "tx_queued",
+		[ENC28_TRACE_TX_DONE] = "tx_done",
+		[ENC28_TRACE_LINK] = "link",
+	};
+
+	if ((event < ENC28_TRACE_EVENT_COUNT) && names[event])
+	{
+		return names[event];
+	}
+	return "unknown";
+}
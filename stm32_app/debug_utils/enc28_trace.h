@@ -0,0 +1,144 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Sebastian Baginski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * enc28_trace.h
+ *
+ * Compile-time log level and binary trace ring for the packet path.
+ * Trace entries are written without locking and decoded later, either by a
+ * low-priority task through enc28_trace_read or by a host tool reading
+ * enc28_trace_ring and enc28_trace_head from the target memory.
+ * */
+
+#ifndef ENC28_TRACE_H_
+#define ENC28_TRACE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define ENC28_LOG_LEVEL_NONE	(0)
+#define ENC28_LOG_LEVEL_ERROR	(1)
+#define ENC28_LOG_LEVEL_INFO	(2)
+#define ENC28_LOG_LEVEL_DEBUG	(3)
+
+/* Messages above this level are compiled out */
+#ifndef ENC28_LOG_LEVEL
+#define ENC28_LOG_LEVEL ENC28_LOG_LEVEL_INFO
+#endif
+
+#if ENC28_LOG_LEVEL >= ENC28_LOG_LEVEL_ERROR
+#define ENC28_LOG_ERROR(...) printf(__VA_ARGS__)
+#else
+#define ENC28_LOG_ERROR(...) do {} while (0)
+#endif
+
+#if ENC28_LOG_LEVEL >= ENC28_LOG_LEVEL_INFO
+#define ENC28_LOG_INFO(...) printf(__VA_ARGS__)
+#else
+#define ENC28_LOG_INFO(...) do {} while (0)
+#endif
+
+#if ENC28_LOG_LEVEL >= ENC28_LOG_LEVEL_DEBUG
+#define ENC28_LOG_DEBUG(...) printf(__VA_ARGS__)
+#else
+#define ENC28_LOG_DEBUG(...) do {} while (0)
+#endif
+
+/* Set to 0 to compile out the trace points */
+#ifndef ENC28_TRACE_ENABLED
+#define ENC28_TRACE_ENABLED (1)
+#endif
+
+/* Number of entries in the trace ring, has to be a power of 2 */
+#ifndef ENC28_TRACE_RING_SIZE
+#define ENC28_TRACE_RING_SIZE (128)
+#endif
+
+_Static_assert((ENC28_TRACE_RING_SIZE & (ENC28_TRACE_RING_SIZE - 1)) == 0, "ENC28_TRACE_RING_SIZE has to be a power of 2");
+
+/* Timestamp of the trace entries, has to be callable from interrupt handlers */
+#ifndef ENC28_TRACE_TIMESTAMP
+extern uint32_t HAL_GetTick(void);
+#define ENC28_TRACE_TIMESTAMP() HAL_GetTick()
+#endif
+
+/*
+ * Trace event IDs, the meaning of the argument is given for each event
+ * */
+enum enc28_trace_event_t
+{
+	ENC28_TRACE_IRQ = 1,		/* ENC28J60 interrupt, no argument */
+	ENC28_TRACE_RX_FRAME,		/* Frame read from the module, frame length */
+	ENC28_TRACE_RX_STALL,		/* Reception paused, no packet buffer free, no argument */
+	ENC28_TRACE_TX_QUEUED,		/* Frame queued by lwIP, frame length */
+	ENC28_TRACE_TX_DONE,		/* Transmission finished, ENC28_CommandStatus */
+	ENC28_TRACE_LINK,			/* Link status change, 1 = link up */
+	ENC28_TRACE_EVENT_COUNT
+};
+
+struct enc28_trace_entry_t
+{
+	uint32_t timestamp;
+	uint16_t event;			/* enc28_trace_event_t */
+	uint16_t arg;
+};
+
+extern struct enc28_trace_entry_t enc28_trace_ring[ENC28_TRACE_RING_SIZE];
+
+/* Number of entries written so far, the next entry goes to index (enc28_trace_head % ENC28_TRACE_RING_SIZE) */
+extern volatile uint32_t enc28_trace_head;
+
+/*
+ * @brief Records a trace entry. Safe to call from tasks and interrupt handlers.
+ * */
+static inline void enc28_trace(uint16_t event, uint16_t arg)
+{
+#if ENC28_TRACE_ENABLED
+	const uint32_t idx = __atomic_fetch_add(&enc28_trace_head, 1, __ATOMIC_RELAXED);
+	struct enc28_trace_entry_t *entry = &enc28_trace_ring[idx & (ENC28_TRACE_RING_SIZE - 1)];
+	entry->timestamp = ENC28_TRACE_TIMESTAMP();
+	entry->event = event;
+	entry->arg = arg;
+#else
+	(void)event;
+	(void)arg;
+#endif
+}
+
+/*
+ * @brief Reads the next trace entry
+ * @param cursor Number of entries consumed by the reader, start with 0. Moved past the overwritten entries if the reader fell behind.
+ * @param entry The output entry
+ * @return 1 if an entry was read, 0 if the reader is up to date
+ * @note An entry written while it is being read can be returned half-updated
+ * */
+extern uint8_t enc28_trace_read(uint32_t *cursor, struct enc28_trace_entry_t *entry);
+
+/*
+ * @brief Returns the name of the trace event ID
+ * */
+extern const char *enc28_trace_event_name(uint16_t event);
+
+#endif /* ENC28_TRACE_H_ */
@@ -32,14 +32,34 @@
 #ifndef ETH_PACKET_BUFF_H_
 #define ETH_PACKET_BUFF_H_
 
+#include "enc28j60.h"
+#include <lwip/pbuf.h>
 #include <stdint.h>
 
-#define MAX_ETH_PACKET_SIZE 1600
-
 struct eth_packet_buff_t
 {
-	uint8_t buf[MAX_ETH_PACKET_SIZE];
+	uint8_t *buf;				/* Storage of the size class, see eth_packet_pool.h */
+	uint16_t size;				/* Capacity of buf */
 	uint16_t used_bytes;
+	uint32_t irq_time;			/* ETH_STATS_TIMESTAMP of the interrupt that announced the frame */
+	struct pbuf_custom pbuf;	/* Descriptor of the frame while lwIP holds it, pbuf.enc28_eth_packet_ptr points back to this buffer */
+};
+
+#if ETH_RX_PBUF_POOL
+/* Received frame passed to the ip stack task, allocated from PBUF_POOL */
+typedef struct pbuf eth_rx_frame_t;
+#else
+/* Received frame passed to the ip stack task, allocated from eth_packet_pool.h */
+typedef struct eth_packet_buff_t eth_rx_frame_t;
+#endif
+
+struct eth_tx_request_t
+{
+	struct pbuf *p;				/* Frame to send, released after the transmission */
+	struct eth_packet_buff_t *buff;	/* Frame to send if p is NULL, reused by the packet handling task after the transmission */
+	ENC28_Tx_Checksum csum;		/* Checksum filled in by the ENC28J60, valid if use_csum is set */
+	uint8_t use_csum;
+	uint32_t queued_time;		/* ETH_STATS_TIMESTAMP of the request */
 };
 
 #endif /* ETH_PACKET_BUFF_H_ */
@@ -0,0 +1,148 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Sebastian Baginski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * eth_packet_pool.c
+ *
+ * Size-class pool of the packet buffers
+ * */
+
+#include "eth_packet_pool.h"
+#include "stm32_network_app.h"
+
+#include "debug_utils/enc28_trace.h"
+
+#include <FreeRTOS.h>
+#include <task.h>
+#include <lwip/memp.h>
+#include <string.h>
+
+#if ETH_RX_PBUF_POOL
+_Static_assert(PBUF_POOL_BUFSIZE >= ETH_PACKET_FULL_SIZE, "PBUF_POOL_BUFSIZE too small for a full-size frame");
+#else
+#if LWIP_TCP && TCP_QUEUE_OOSEQ
+#define ETH_OOSEQ_MAX_FRAMES (MEMP_NUM_TCP_PCB * TCP_OOSEQ_MAX_PBUFS)
+#else
+#define ETH_OOSEQ_MAX_FRAMES 0
+#endif
+#if IP_REASSEMBLY
+#define ETH_REASS_MAX_FRAMES IP_REASS_MAX_PBUFS
+#else
+#define ETH_REASS_MAX_FRAMES 0
+#endif
+/* Every queued frame may sit in a full-size buffer once the smaller classes are used up */
+_Static_assert(ETH_OOSEQ_MAX_FRAMES + ETH_REASS_MAX_FRAMES < ETH_PACKETS_FULL,
+		"lwIP can hold every full-size packet buffer, raise ETH_PACKETS_FULL");
+
+struct eth_packet_class_desc_t
+{
+	uint8_t *storage;
+	uint16_t size;
+	uint8_t count;
+	uint8_t free_count;
+	struct eth_packet_buff_t **free_bufs;	/* Stack of the free buffers */
+};
+
+static uint8_t small_storage[ETH_PACKETS_SMALL][ETH_PACKET_SMALL_SIZE] __attribute__ ((aligned(4)));
+static uint8_t medium_storage[ETH_PACKETS_MEDIUM][ETH_PACKET_MEDIUM_SIZE] __attribute__ ((aligned(4)));
+static uint8_t full_storage[ETH_PACKETS_FULL][ETH_PACKET_FULL_SIZE] __attribute__ ((aligned(4)));
+
+static struct eth_packet_buff_t eth_packets[MAX_ETH_PACKETS];
+static struct eth_packet_buff_t *free_bufs[MAX_ETH_PACKETS];
+
+static struct eth_packet_class_desc_t classes[ETH_PACKET_CLASS_COUNT] = {
+	{&small_storage[0][0], ETH_PACKET_SMALL_SIZE, ETH_PACKETS_SMALL, 0, &free_bufs[0]},
+	{&medium_storage[0][0], ETH_PACKET_MEDIUM_SIZE, ETH_PACKETS_MEDIUM, 0, &free_bufs[ETH_PACKETS_SMALL]},
+	{&full_storage[0][0], ETH_PACKET_FULL_SIZE, ETH_PACKETS_FULL, 0, &free_bufs[ETH_PACKETS_SMALL + ETH_PACKETS_MEDIUM]}
+};
+
+void eth_packet_pool_init(void)
+{
+	struct eth_packet_buff_t *packet = eth_packets;
+	for (uint8_t c = 0; c < ETH_PACKET_CLASS_COUNT; ++c)
+	{
+		classes[c].free_count = 0;
+		for (uint8_t i = 0; i < classes[c].count; ++i, ++packet)
+		{
+			memset(packet, 0, sizeof(*packet));
+			packet->buf = classes[c].storage + (uint32_t)i * classes[c].size;
+			packet->size = classes[c].size;
+			classes[c].free_bufs[classes[c].free_count++] = packet;
+		}
+	}
+}
+
+struct eth_packet_buff_t *eth_packet_pool_alloc(uint16_t len)
+{
+	for (uint8_t c = 0; c < ETH_PACKET_CLASS_COUNT; ++c)
+	{
+		if ((len <= classes[c].size) && (classes[c].free_count > 0))
+		{
+			return classes[c].free_bufs[--classes[c].free_count];
+		}
+	}
+	return NULL;
+}
+
+void eth_packet_pool_free(struct eth_packet_buff_t *packet)
+{
+	for (uint8_t c = 0; c < ETH_PACKET_CLASS_COUNT; ++c)
+	{
+		if (packet->size == classes[c].size)
+		{
+			configASSERT(classes[c].free_count < classes[c].count);
+			classes[c].free_bufs[classes[c].free_count++] = packet;
+			return;
+		}
+	}
+	configASSERT(0);
+}
+
+uint8_t eth_packet_pool_free_count(enum eth_packet_class_t size_class)
+{
+	return classes[size_class].free_count;
+}
+#endif
+
+void eth_packet_pool_report(void)
+{
+	// same element size as the LWIP_PBUF_MEMPOOL declaration in memp_std.h
+	const uint32_t pbuf_pool_bytes = (uint32_t)PBUF_POOL_SIZE *
+			(LWIP_MEM_ALIGN_SIZE(sizeof(struct pbuf)) + LWIP_MEM_ALIGN_SIZE(PBUF_POOL_BUFSIZE));
+#if ETH_RX_PBUF_POOL
+	const uint32_t rx_bytes = 0;
+	const uint32_t rx_frames = PBUF_POOL_SIZE;
+	const uint32_t rx_full_frames = PBUF_POOL_SIZE;
+#else
+	const uint32_t rx_bytes = sizeof(small_storage) + sizeof(medium_storage) + sizeof(full_storage) +
+			sizeof(eth_packets) + sizeof(free_bufs);
+	const uint32_t rx_frames = MAX_ETH_PACKETS;
+	const uint32_t rx_full_frames = ETH_PACKETS_FULL;
+#endif
+
+	ENC28_LOG_INFO("RX buffers: %u B, PBUF_POOL: %u B, heap: %u B\n",
+			(unsigned)rx_bytes, (unsigned)pbuf_pool_bytes, (unsigned)MEM_SIZE);
+	ENC28_LOG_INFO("Frames held at once: %u, full-size: %u\n", (unsigned)rx_frames, (unsigned)rx_full_frames);
+}
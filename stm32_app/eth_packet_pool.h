@@ -0,0 +1,81 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Sebastian Baginski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * eth_packet_pool.h
+ *
+ * Packet buffers in three size classes, frames go to the smallest free buffer they fit in.
+ * Owned by the packet handling task, buffers released elsewhere come back through the "free" ring.
+ * With ETH_RX_PBUF_POOL the frames are received into PBUF_POOL and only the RAM report is left.
+ * */
+
+#ifndef ETH_PACKET_POOL_H_
+#define ETH_PACKET_POOL_H_
+
+#include "eth_packet_buff.h"
+#include <stdint.h>
+
+/* Buffer size of each class, the frame length includes the CRC */
+#define ETH_PACKET_SMALL_SIZE 128						/* ARP, TCP ACK, ICMP echo with a short payload */
+#define ETH_PACKET_MEDIUM_SIZE 512
+#define ETH_PACKET_FULL_SIZE ENC28_CONF_MAX_FRAME_LEN	/* Longest frame accepted by the MAC (MAMXFL) */
+
+#if !ETH_RX_PBUF_POOL
+enum eth_packet_class_t
+{
+	ETH_PACKET_CLASS_SMALL,
+	ETH_PACKET_CLASS_MEDIUM,
+	ETH_PACKET_CLASS_FULL,
+	ETH_PACKET_CLASS_COUNT
+};
+
+/*
+ * @brief Puts every packet buffer in the free lists of its class
+ * */
+extern void eth_packet_pool_init(void);
+
+/*
+ * @brief Takes a buffer from the smallest class that fits @p len and has a free buffer
+ * @return NULL if no such buffer is free
+ * */
+extern struct eth_packet_buff_t *eth_packet_pool_alloc(uint16_t len);
+
+/*
+ * @brief Returns the buffer to the free list of its class
+ * */
+extern void eth_packet_pool_free(struct eth_packet_buff_t *packet);
+
+/*
+ * @brief Returns the number of free buffers of the class
+ * */
+extern uint8_t eth_packet_pool_free_count(enum eth_packet_class_t size_class);
+#endif
+
+/*
+ * @brief Logs the static RAM taken by the received frames and the lwIP pools, and how many frames can be held at once
+ * */
+extern void eth_packet_pool_report(void);
+
+#endif /* ETH_PACKET_POOL_H_ */
@@ -0,0 +1,71 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Sebastian Baginski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * eth_ring.c
+ *
+ * Implementation of the single-producer single-consumer ring.
+ * */
+
+#include "eth_ring.h"
+#include <string.h>
+
+uint8_t eth_ring_push(struct eth_ring_t *ring, const void *item, uint8_t *opt_notify)
+{
+	const uint16_t head = ring->head;
+	if ((uint16_t)(head - __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST)) > ring->mask)
+	{
+		return 0;
+	}
+
+	memcpy(ring->storage + (head & ring->mask) * ring->item_size, item, ring->item_size);
+	__atomic_store_n(&ring->head, (uint16_t)(head + 1), __ATOMIC_SEQ_CST);
+
+	if (opt_notify)
+	{
+		// tail is read after head is published: either the consumer sees the new item,
+		// or it has already drained the ring and is (about to be) waiting for the notification
+		*opt_notify = (__atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST) == head);
+	}
+	return 1;
+}
+
+uint8_t eth_ring_pop(struct eth_ring_t *ring, void *item)
+{
+	const uint16_t tail = ring->tail;
+	if (__atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) == tail)
+	{
+		return 0;
+	}
+
+	memcpy(item, ring->storage + (tail & ring->mask) * ring->item_size, ring->item_size);
+	__atomic_store_n(&ring->tail, (uint16_t)(tail + 1), __ATOMIC_SEQ_CST);
+	return 1;
+}
+
+uint16_t eth_ring_count(const struct eth_ring_t *ring)
+{
+	return (uint16_t)(__atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) - __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST));
+}
@@ -0,0 +1,71 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Sebastian Baginski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * eth_ring.h
+ *
+ * Single-producer single-consumer ring of fixed-size items, used to pass
+ * packet descriptors between the packet handling task and the ip stack task
+ * without entering a critical section.
+ * */
+
+#ifndef ETH_RING_H_
+#define ETH_RING_H_
+
+#include <stdint.h>
+
+struct eth_ring_t
+{
+	uint8_t *storage;
+	uint16_t item_size;
+	uint16_t mask;				/* Capacity - 1, the capacity is a power of 2 */
+	volatile uint16_t head;		/* Items pushed so far, written only by the producer */
+	volatile uint16_t tail;		/* Items popped so far, written only by the consumer */
+};
+
+/* Static initializer of a ring backed by @p storage_array, the number of elements has to be a power of 2 */
+#define ETH_RING_INIT(storage_array) \
+	{ (uint8_t *)(storage_array), sizeof((storage_array)[0]), (sizeof(storage_array) / sizeof((storage_array)[0])) - 1, 0, 0 }
+
+/*
+ * @brief Appends a copy of the item, called only by the producer
+ * @param opt_notify Set to 1 if the consumer may have found the ring empty and has to be woken up, can be NULL
+ * @return 1 on success, 0 if the ring is full
+ * */
+extern uint8_t eth_ring_push(struct eth_ring_t *ring, const void *item, uint8_t *opt_notify);
+
+/*
+ * @brief Removes the oldest item, called only by the consumer
+ * @return 1 on success, 0 if the ring is empty
+ * @note The consumer has to pop until the ring is empty before it waits for the notification
+ * */
+extern uint8_t eth_ring_pop(struct eth_ring_t *ring, void *item);
+
+/*
+ * @brief Returns the number of items in the ring, callable from either side
+ * */
+extern uint16_t eth_ring_count(const struct eth_ring_t *ring);
+
+#endif /* ETH_RING_H_ */
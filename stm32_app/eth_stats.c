@@ -0,0 +1,54 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Sebastian Baginski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * eth_stats.c
+ *
+ * Statistics of the ethernet packet path
+ * */
+
+#include "eth_stats.h"
+
+struct eth_stats_t eth_stats;
+volatile uint32_t eth_stats_irq_time;
+
+void eth_stats_record_latency(struct eth_latency_hist_t *hist, uint32_t latency)
+{
+	uint8_t bucket = 0;
+	if (latency > 0)
+	{
+		bucket = 32 - __builtin_clz(latency);
+		if (bucket >= ETH_STATS_HIST_BUCKETS)
+		{
+			bucket = ETH_STATS_HIST_BUCKETS - 1;
+		}
+	}
+
+	++hist->buckets[bucket];
+	if (latency > hist->max)
+	{
+		hist->max = latency;
+	}
+}
@@ -0,0 +1,99 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Sebastian Baginski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * eth_stats.h
+ *
+ * Statistics of the ethernet packet path, readable at any time without locking
+ * */
+
+#ifndef ETH_STATS_H_
+#define ETH_STATS_H_
+
+#include <stdint.h>
+
+/* Number of latency histogram buckets, bucket N > 0 counts the samples in [2^(N-1), 2^N), the last one everything above */
+#define ETH_STATS_HIST_BUCKETS 12
+
+/* Timestamp source of the latency histograms, has to be callable from interrupt handlers */
+#ifndef ETH_STATS_TIMESTAMP
+extern uint32_t HAL_GetTick(void);
+#define ETH_STATS_TIMESTAMP() HAL_GetTick()
+#endif
+
+struct eth_latency_hist_t
+{
+	uint32_t buckets[ETH_STATS_HIST_BUCKETS];
+	uint32_t max;		/* Largest sample seen */
+};
+
+/*
+ * Every counter has a single writer, noted per group. 32-bit stores are atomic on the target,
+ * so readers get consistent counters, though not a consistent snapshot of the whole block.
+ * */
+struct eth_stats_t
+{
+	/* packet handling task */
+	uint32_t rx_frames;			/* Frames passed to the ip stack task */
+	uint32_t rx_bytes;
+	uint32_t rx_pool_empty;		/* Times the reception stalled because no packet buffer was free */
+	uint32_t rx_too_long;		/* Frames dropped because they did not fit in a packet buffer */
+	uint32_t rx_errors;			/* Receive errors reported by the driver, including rx_too_long */
+	uint32_t tx_frames;			/* Frames reported sent by the ENC28J60 */
+	uint32_t tx_bytes;
+	uint32_t tx_aborted;		/* Frames dropped after an aborted transmission or a failed upload */
+	uint32_t spi_bytes;			/* Bytes clocked over the SPI bus, commands and register accesses included */
+	uint32_t ready_queue_hwm;	/* Largest number of frames waiting for the ip stack task */
+	struct eth_latency_hist_t tx_latency;	/* enc28_netif_output to EIR.TXIF */
+
+	/* ip stack task */
+	uint32_t tx_queue_hwm;		/* Largest number of frames waiting for the packet handling task */
+	uint32_t tx_queue_full;		/* Frames dropped because the transmit queue was full */
+	uint32_t rx_ooseq_freed;	/* TCP out-of-sequence queues released to free packet buffers */
+	struct eth_latency_hist_t rx_latency;	/* ENC28J60 interrupt to lwIP input */
+};
+
+extern struct eth_stats_t eth_stats;
+
+/* Time of the last ENC28J60 interrupt, written by the interrupt handler */
+extern volatile uint32_t eth_stats_irq_time;
+
+/*
+ * @brief Adds a latency sample, in ETH_STATS_TIMESTAMP units, to the histogram
+ * */
+extern void eth_stats_record_latency(struct eth_latency_hist_t *hist, uint32_t latency);
+
+/*
+ * @brief Raises the high-water mark @p hwm to @p value
+ * */
+static inline void eth_stats_update_hwm(uint32_t *hwm, uint32_t value)
+{
+	if (value > *hwm)
+	{
+		*hwm = value;
+	}
+}
+
+#endif /* ETH_STATS_H_ */
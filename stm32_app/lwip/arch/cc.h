@@ -33,7 +33,11 @@
 #define INC_ARCH_CC_H_
 
 #include "lwip/arch.h"
+#include <stdint.h>
 
 #define BYTE_ORDER LITTLE_ENDIAN
 
+/* Protection level type for SYS_LIGHTWEIGHT_PROT, no sys_arch.h in the NO_SYS build */
+typedef uint32_t sys_prot_t;
+
 #endif /* INC_ARCH_CC_H_ */
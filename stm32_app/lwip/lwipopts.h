@@ -41,13 +41,61 @@
 /* No netconn support */
 #define LWIP_NETCONN 0
 
-/* Disable OS layer inter-task protection feature */
-#define SYS_LIGHTWEIGHT_PROT 0
+/* Outgoing pbufs are released by the packet handling task, protect the pools and the heap */
+#define SYS_LIGHTWEIGHT_PROT 1
+
+/* Allow pbuf_free from the packet handling task */
+#define LWIP_ALLOW_MEM_FREE_FROM_OTHER_CONTEXT 1
+
+/* Heap for outgoing frames, they stay allocated until the ENC28J60 has sent them */
+#define MEM_SIZE (4 * 1600)
+
+/* Full-size TCP segments for the Ethernet MTU */
+#define TCP_MSS 1460
+
+/* Flag to receive the frames straight into PBUF_POOL instead of the packet buffers of eth_packet_pool.h,
+ * received frames, TCP queues and lwIP internals then share one pool */
+#ifndef ETH_RX_PBUF_POOL
+#define ETH_RX_PBUF_POOL 0
+#endif
+
+#if ETH_RX_PBUF_POOL
+/* Every pool pbuf holds a whole frame (ENC28_CONF_MAX_FRAME_LEN), the pool takes the place of the packet buffers */
+#define PBUF_POOL_SIZE 12
+#define PBUF_POOL_BUFSIZE 1536
+#else
+/* The driver receives into its own buffers, the pool is used only by lwIP internals */
+#define PBUF_POOL_SIZE 4
+#endif
+
+/* Received frames queued by lwIP keep their packet buffer. The out-of-sequence limit applies to each connection
+ * and PBUF_POOL_FREE_OOSEQ does not cover the packet buffers, so MEMP_NUM_TCP_PCB * TCP_OOSEQ_MAX_PBUFS
+ * + IP_REASS_MAX_PBUFS has to stay below ETH_PACKETS_FULL to leave a full-size buffer for the reception
+ * (checked in eth_packet_pool.c) */
+#define MEMP_NUM_TCP_PCB 2
+#define TCP_QUEUE_OOSEQ 1
+#define TCP_OOSEQ_MAX_PBUFS 1
+#define IP_REASS_MAX_PBUFS 2
+#define MEMP_NUM_REASSDATA 1
+
+/* TCP checksums of large segments are computed by the ENC28J60, see enc28_netif_output */
+#define LWIP_CHECKSUM_CTRL_PER_NETIF 1
+
+/* Multicast groups are filtered by the ENC28J60 hash table, see enc28_igmp_mac_filter */
+#define LWIP_IGMP 1
+
+/* Interface counters for the SNMP MIB2 agent, see enc28_sync_stats */
+#define LWIP_STATS 1
+#define MIB2_STATS 1
 
 /* Enable timers support */
 #define LWIP_TIMERS 1
 
 /* User data in the pbuf structure */
+#if ETH_RX_PBUF_POOL
+#define LWIP_PBUF_CUSTOM_DATA uint32_t enc28_irq_time;	/* ETH_STATS_TIMESTAMP of the interrupt that announced the frame */
+#else
 #define LWIP_PBUF_CUSTOM_DATA void *enc28_eth_packet_ptr;
+#endif
 
 #endif /* INC_LWIPOPTS_H_ */
@@ -0,0 +1,83 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Sebastian Baginski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * FreeRTOSConfig.h
+ *
+ * Configuration of the host build: the application's configuration with the
+ * idle hook driving the simulation, stack overflow checks, an assert that
+ * stops the program, and trace hooks counting the kernel calls.
+ * */
+
+#ifndef APP_SIM_FREERTOS_CONF_H_
+#define APP_SIM_FREERTOS_CONF_H_
+
+#include "../FreeRTOSConfig.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+extern void app_sim_assert_failed(const char *file, int line);
+extern int app_sim_printf(const char *fmt, ...);
+extern void app_sim_task_switched_in(void *tcb);
+extern uint32_t app_sim_queue_calls;
+extern uint32_t app_sim_notifications;
+
+#undef configASSERT
+#define configASSERT(x) if ((x) == 0) { app_sim_assert_failed(__FILE__, __LINE__); }
+
+/* The idle hook advances the tick and raises the ENC28J60 interrupt, see app_sim.c */
+#undef configUSE_IDLE_HOOK
+#define configUSE_IDLE_HOOK 1
+
+/* The simulation runs in the idle task, frames are built on its stack */
+#undef configMINIMAL_STACK_SIZE
+#define configMINIMAL_STACK_SIZE ((unsigned short)4096)
+
+#undef configTOTAL_HEAP_SIZE
+#define configTOTAL_HEAP_SIZE ((size_t)(256 * 1024))
+
+#undef configCHECK_FOR_STACK_OVERFLOW
+#define configCHECK_FOR_STACK_OVERFLOW 2
+
+#define INCLUDE_xTaskGetIdleTaskHandle 1
+
+/* Every source of the application includes this file, the console output goes through app_sim.c */
+#define printf app_sim_printf
+
+#define traceTASK_SWITCHED_IN() app_sim_task_switched_in(pxCurrentTCB)
+#define traceQUEUE_SEND(pxQueue) (++app_sim_queue_calls)
+#define traceQUEUE_SEND_FAILED(pxQueue) (++app_sim_queue_calls)
+#define traceQUEUE_SEND_FROM_ISR(pxQueue) (++app_sim_queue_calls)
+#define traceQUEUE_SEND_FROM_ISR_FAILED(pxQueue) (++app_sim_queue_calls)
+#define traceQUEUE_RECEIVE(pxQueue) (++app_sim_queue_calls)
+#define traceQUEUE_RECEIVE_FAILED(pxQueue) (++app_sim_queue_calls)
+#define traceQUEUE_RECEIVE_FROM_ISR(pxQueue) (++app_sim_queue_calls)
+#define traceQUEUE_RECEIVE_FROM_ISR_FAILED(pxQueue) (++app_sim_queue_calls)
+#define traceTASK_NOTIFY(uxIndexToNotify) (++app_sim_notifications)
+#define traceTASK_NOTIFY_FROM_ISR(uxIndexToNotify) (++app_sim_notifications)
+#define traceTASK_NOTIFY_GIVE_FROM_ISR(uxIndexToNotify) (++app_sim_notifications)
+
+#endif /* APP_SIM_FREERTOS_CONF_H_ */
@@ -0,0 +1,773 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Sebastian Baginski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * app_sim.c
+ *
+ * Host build of the test application: the unmodified tasks, lwIP and the
+ * FreeRTOS kernel run against the ENC28J60 simulator (enc28j60/sim). Time
+ * advances by one tick whenever every task is blocked, so the figures below
+ * do not depend on the speed of the host, apart from the echo times.
+ *
+ * The simulated host (MAC 02:11:22:33:44:55, 192.168.0.1) resolves the
+ * address of the application, pings it, sends UDP datagrams to an echo
+ * service and talks to a TCP service, both installed by the simulation.
+ * The report lists the replies, the kernel calls and the stack high-water
+ * marks; the program fails if a reply is missing or malformed. The console
+ * output of the application goes to stderr.
+ * */
+
+#include "stm32_network_app.h"
+#include "eth_stats.h"
+#include "enc28_sim.h"
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include <lwip/stats.h>
+#include <lwip/tcp.h>
+#include <lwip/priv/tcp_priv.h>
+#include <lwip/udp.h>
+
+#include <getopt.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* The report uses the C library, the tasks the console below */
+#undef printf
+
+#define HOST_IP_3				(1)
+#define ECHO_PORT				(7)
+#define HOST_PORT				(12345)
+#define HOST_ISN				(1000u)
+#define EVENT_PERIOD_TICKS		(5)
+#define ECHO_PAYLOAD_LEN		(56)
+#define TCP_SEGMENT_LEN			(100)
+#define ACK_PROBE_PHASES		(3)
+#define MAX_ECHOES				(64)
+#define TCP_TX_BYTES			(TCP_SND_BUF < 1400 ? TCP_SND_BUF : 1400)
+
+#define ETH_HDR_LEN		(14)
+#define IP_HDR_LEN		(20)
+#define UDP_HDR_LEN		(8)
+#define TCP_HDR_LEN		(20)
+#define TCP_FLAG_SYN	(0x02)
+#define TCP_FLAG_ACK	(0x10)
+
+uint32_t SystemCoreClock = 168000000;
+uint32_t app_sim_queue_calls = 0;
+uint32_t app_sim_notifications = 0;
+
+static const uint8_t host_mac[6] = {0x02, 0x11, 0x22, 0x33, 0x44, 0x55};
+static const uint8_t app_mac[6] = {MAC_ADDR_BYTE_0, MAC_ADDR_BYTE_1, MAC_ADDR_BYTE_2,
+		MAC_ADDR_BYTE_3, MAC_ADDR_BYTE_4, MAC_ADDR_BYTE_5};
+
+/* Scenario, set from the command line */
+struct app_sim_options_t
+{
+	uint16_t pings;
+	uint16_t udp_echoes;
+	uint16_t tcp_tx_bytes;		/* Bytes the TCP service sends after the connection is accepted */
+	uint8_t ooseq_segments;		/* Segments sent in reverse order, 0 = none */
+	uint8_t ack_probes;			/* Measure the ACK delay of a lone segment on an idle connection */
+	uint8_t dma;				/* Asynchronous buffer transfers */
+};
+
+/* Events of the run, timestamps in ticks */
+struct app_sim_schedule_t
+{
+	TickType_t pings_start;
+	TickType_t udp_start;
+	TickType_t tcp_start;
+	TickType_t ooseq_start;
+	TickType_t ack_probe_start;
+	TickType_t end;
+};
+
+/* Simulated host's side of the TCP connection */
+struct app_sim_tcp_peer_t
+{
+	uint8_t established;
+	uint32_t snd_nxt;			/* Next byte to send */
+	uint32_t snd_una;			/* Oldest byte not acknowledged by the application */
+	uint32_t rcv_nxt;			/* Next byte expected from the application */
+	uint32_t stream_start;		/* Sequence number of the first data byte */
+	uint8_t ack_pending;
+};
+
+/* Results */
+struct app_sim_results_t
+{
+	uint32_t arp_replies;
+	uint32_t icmp_sent, icmp_replies;
+	uint32_t udp_sent, udp_replies;
+	uint64_t icmp_echo_ns, udp_echo_ns;
+	uint32_t tcp_segments, tcp_bad_checksums, tcp_bytes_received;
+	uint32_t tcp_rx_bytes, tcp_rx_out_of_order;
+	uint32_t ack_delay[ACK_PROBE_PHASES];
+	uint32_t task_wakeups;
+	uint32_t interrupts;
+};
+
+static ENC28_Sim_Device sim;
+static ENC28_SPI_Context spi_ctx;
+static struct app_sim_options_t options = {20, 20, TCP_TX_BYTES, 0, 0, 0};
+static struct app_sim_schedule_t schedule;
+static struct app_sim_tcp_peer_t peer;
+static struct app_sim_results_t results;
+static uint64_t echo_sent_ns[MAX_ECHOES];
+static TickType_t ack_probe_sent[ACK_PROBE_PHASES];
+static uint32_t ack_probe_seq[ACK_PROBE_PHASES];
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+uint32_t HAL_GetTick(void)
+{
+	return xTaskGetTickCount();
+}
+
+/*
+ * Console of the application, stands in for the UART. A small formatter keeps the stack use of
+ * the tasks close to the target's, the C library printf alone takes more than 3 KB here
+ * */
+int app_sim_printf(const char *fmt, ...)
+{
+	char line[128];
+	size_t len = 0;
+	va_list args;
+
+	va_start(args, fmt);
+	for (const char *c = fmt; *c && (len < sizeof(line) - 24); ++c)
+	{
+		if (*c != '%')
+		{
+			line[len++] = *c;
+			continue;
+		}
+		uint8_t is_long = 0;
+		while ((*(++c) == 'l') || (*c == 'z'))
+		{
+			is_long = 1;
+		}
+		char digits[24];
+		uint8_t count = 0;
+		unsigned long value = 0;
+		unsigned base = 10;
+		switch (*c)
+		{
+		case 'd':
+		{
+			const long v = is_long ? va_arg(args, long) : va_arg(args, int);
+			if (v < 0)
+			{
+				line[len++] = '-';
+			}
+			value = (v < 0) ? (unsigned long)-v : (unsigned long)v;
+			break;
+		}
+		case 'u': value = is_long ? va_arg(args, unsigned long) : va_arg(args, unsigned); break;
+		case 'x': value = is_long ? va_arg(args, unsigned long) : va_arg(args, unsigned); base = 16; break;
+		case 's':
+			for (const char *str = va_arg(args, const char *); *str && (len < sizeof(line) - 24); ++str)
+			{
+				line[len++] = *str;
+			}
+			continue;
+		case '\0':
+			--c;
+			continue;
+		default:
+			line[len++] = *c;
+			continue;
+		}
+		do
+		{
+			digits[count++] = "0123456789abcdef"[value % base];
+			value /= base;
+		} while (value && (count < sizeof(digits)));
+		while (count)
+		{
+			line[len++] = digits[--count];
+		}
+	}
+	va_end(args);
+
+	fwrite(line, 1, len, stderr);
+	return (int)len;
+}
+
+void app_sim_assert_failed(const char *file, int line)
+{
+	fprintf(stderr, "assertion failed at %s:%d\n", file, line);
+	abort();
+}
+
+void vApplicationStackOverflowHook(TaskHandle_t task, char *name)
+{
+	(void)task;
+	fprintf(stderr, "stack overflow in task %s\n", name);
+	abort();
+}
+
+void app_sim_task_switched_in(void *tcb)
+{
+	static void *prev_tcb = NULL;
+	if ((tcb != prev_tcb) && (tcb != (void *)xTaskGetIdleTaskHandle()))
+	{
+		results.task_wakeups++;
+	}
+	prev_tcb = tcb;
+}
+
+/* Frame builders */
+
+static uint32_t sum_words(const uint8_t *data, uint16_t len, uint32_t sum)
+{
+	for (uint16_t i = 0; i + 1 < len; i += 2)
+	{
+		sum += ((uint32_t)data[i] << 8) | data[i + 1];
+	}
+	if (len & 0x1)
+	{
+		sum += (uint32_t)data[len - 1] << 8;
+	}
+	return sum;
+}
+
+static uint16_t fold(uint32_t sum)
+{
+	while (sum >> 16)
+	{
+		sum = (sum >> 16) + (sum & 0xFFFF);
+	}
+	return (uint16_t)sum;
+}
+
+static void put16(uint8_t *p, uint16_t v)
+{
+	p[0] = v >> 8;
+	p[1] = v & 0xFF;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+	put16(p, v >> 16);
+	put16(p + 2, v & 0xFFFF);
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void app_ip(uint8_t ip[4])
+{
+	const uint32_t addr = ENC28_IP_ADDR;
+	for (uint8_t i = 0; i < 4; ++i)
+	{
+		ip[i] = (addr >> (8 * i)) & 0xFF;
+	}
+}
+
+static void host_ip(uint8_t ip[4])
+{
+	app_ip(ip);
+	ip[3] = HOST_IP_3;
+}
+
+/* Ethernet and IPv4 headers of a frame from the host, @return the start of the IP payload */
+static uint8_t *build_ip_frame(uint8_t *frame, uint8_t protocol, uint16_t payload_len)
+{
+	memset(frame, 0, ETH_HDR_LEN + IP_HDR_LEN + payload_len);
+	memcpy(frame, app_mac, 6);
+	memcpy(frame + 6, host_mac, 6);
+	put16(frame + 12, 0x0800);
+
+	uint8_t *ip = frame + ETH_HDR_LEN;
+	ip[0] = 0x45;
+	put16(ip + 2, IP_HDR_LEN + payload_len);
+	ip[8] = 64;
+	ip[9] = protocol;
+	host_ip(ip + 12);
+	app_ip(ip + 16);
+	put16(ip + 10, ~fold(sum_words(ip, IP_HDR_LEN, 0)));
+	return ip + IP_HDR_LEN;
+}
+
+static uint32_t pseudo_header_sum(const uint8_t *ip, uint16_t l4_len)
+{
+	return sum_words(ip + 12, 8, ip[9] + (uint32_t)l4_len);
+}
+
+static void inject(const uint8_t *frame, uint16_t len)
+{
+	// a frame dropped by the receive filters or for lack of space is lost like on the wire
+	(void)enc28_sim_inject_frame(&sim, frame, len < 60 ? 60 : len);
+}
+
+static void send_arp_request(void)
+{
+	uint8_t frame[60] = {0};
+	memset(frame, 0xFF, 6);
+	memcpy(frame + 6, host_mac, 6);
+	put16(frame + 12, 0x0806);
+	put16(frame + 14, 1);
+	put16(frame + 16, 0x0800);
+	frame[18] = 6;
+	frame[19] = 4;
+	put16(frame + 20, 1);
+	memcpy(frame + 22, host_mac, 6);
+	host_ip(frame + 28);
+	app_ip(frame + 38);
+	inject(frame, sizeof(frame));
+}
+
+static void send_ping(uint16_t seq)
+{
+	uint8_t frame[ETH_HDR_LEN + IP_HDR_LEN + 8 + ECHO_PAYLOAD_LEN];
+	uint8_t *icmp = build_ip_frame(frame, 1, 8 + ECHO_PAYLOAD_LEN);
+	icmp[0] = 8;
+	put16(icmp + 6, seq);
+	for (uint16_t i = 0; i < ECHO_PAYLOAD_LEN; ++i)
+	{
+		icmp[8 + i] = (uint8_t)(i + seq);
+	}
+	put16(icmp + 2, ~fold(sum_words(icmp, 8 + ECHO_PAYLOAD_LEN, 0)));
+	echo_sent_ns[seq % MAX_ECHOES] = now_ns();
+	inject(frame, sizeof(frame));
+}
+
+static void send_udp(uint16_t seq)
+{
+	uint8_t frame[ETH_HDR_LEN + IP_HDR_LEN + UDP_HDR_LEN + ECHO_PAYLOAD_LEN];
+	uint8_t *udp = build_ip_frame(frame, 17, UDP_HDR_LEN + ECHO_PAYLOAD_LEN);
+	put16(udp, HOST_PORT);
+	put16(udp + 2, ECHO_PORT);
+	put16(udp + 4, UDP_HDR_LEN + ECHO_PAYLOAD_LEN);
+	put16(udp + 8, seq);
+	echo_sent_ns[seq % MAX_ECHOES] = now_ns();
+	inject(frame, sizeof(frame));
+}
+
+/* Segment from the host, the data byte at stream offset N is N & 0xFF */
+static void send_tcp(uint32_t seq, uint8_t flags, uint16_t data_len)
+{
+	uint8_t frame[ETH_HDR_LEN + IP_HDR_LEN + TCP_HDR_LEN + 4 + TCP_SEGMENT_LEN];
+	const uint8_t opt_len = (flags & TCP_FLAG_SYN) ? 4 : 0;
+	const uint16_t tcp_len = TCP_HDR_LEN + opt_len + data_len;
+	uint8_t *tcp = build_ip_frame(frame, 6, tcp_len);
+
+	put16(tcp, HOST_PORT);
+	put16(tcp + 2, ECHO_PORT);
+	put32(tcp + 4, seq);
+	put32(tcp + 8, (flags & TCP_FLAG_ACK) ? peer.rcv_nxt : 0);
+	tcp[12] = ((TCP_HDR_LEN + opt_len) / 4) << 4;
+	tcp[13] = flags;
+	put16(tcp + 14, 8192);
+	if (opt_len)
+	{
+		// MSS option
+		tcp[20] = 2;
+		tcp[21] = 4;
+		put16(tcp + 22, 1460);
+	}
+	for (uint16_t i = 0; i < data_len; ++i)
+	{
+		tcp[TCP_HDR_LEN + opt_len + i] = (uint8_t)(seq - peer.stream_start + i);
+	}
+	put16(tcp + 16, ~fold(sum_words(tcp, tcp_len, pseudo_header_sum(tcp - IP_HDR_LEN, tcp_len))));
+	inject(frame, ETH_HDR_LEN + IP_HDR_LEN + tcp_len);
+}
+
+/* Frames sent by the application */
+
+static void check_tcp_segment(const uint8_t *ip, uint16_t ip_len)
+{
+	const uint8_t *tcp = ip + IP_HDR_LEN;
+	const uint16_t tcp_len = ip_len - IP_HDR_LEN;
+	const uint16_t data_len = tcp_len - (tcp[12] >> 4) * 4;
+	const uint32_t seq = get32(tcp + 4);
+
+	results.tcp_segments++;
+	if (fold(sum_words(tcp, tcp_len, pseudo_header_sum(ip, tcp_len))) != 0xFFFF)
+	{
+		results.tcp_bad_checksums++;
+	}
+
+	if (tcp[13] & TCP_FLAG_SYN)
+	{
+		peer.rcv_nxt = seq + 1;
+	}
+	if ((data_len > 0) && (seq == peer.rcv_nxt))
+	{
+		peer.rcv_nxt += data_len;
+		results.tcp_bytes_received += data_len;
+		peer.ack_pending = 1;
+	}
+	if (tcp[13] & TCP_FLAG_ACK)
+	{
+		const uint32_t ack = get32(tcp + 8);
+		if ((int32_t)(ack - peer.snd_una) > 0)
+		{
+			peer.snd_una = ack;
+		}
+		for (uint8_t i = 0; i < ACK_PROBE_PHASES; ++i)
+		{
+			if (ack_probe_sent[i] && !results.ack_delay[i] && ((int32_t)(ack - ack_probe_seq[i]) >= 0))
+			{
+				results.ack_delay[i] = xTaskGetTickCount() - ack_probe_sent[i];
+			}
+		}
+	}
+}
+
+static void on_transmit(ENC28_Sim_Device *dev, const uint8_t *frame, uint16_t len, void *user)
+{
+	(void)dev;
+	(void)user;
+	(void)len;
+	const uint16_t type = (frame[12] << 8) | frame[13];
+
+	if ((type == 0x0806) && (frame[21] == 2))
+	{
+		results.arp_replies++;
+		return;
+	}
+	if (type != 0x0800)
+	{
+		return;
+	}
+
+	const uint8_t *ip = frame + ETH_HDR_LEN;
+	const uint16_t ip_len = (ip[2] << 8) | ip[3];
+	const uint8_t *l4 = ip + IP_HDR_LEN;
+	if ((fold(sum_words(ip, IP_HDR_LEN, 0)) != 0xFFFF) || memcmp(frame, host_mac, 6))
+	{
+		return;
+	}
+
+	if ((ip[9] == 1) && (l4[0] == 0) && (fold(sum_words(l4, ip_len - IP_HDR_LEN, 0)) == 0xFFFF))
+	{
+		results.icmp_replies++;
+		results.icmp_echo_ns += now_ns() - echo_sent_ns[((l4[6] << 8) | l4[7]) % MAX_ECHOES];
+	}
+	else if ((ip[9] == 17) && (((l4[0] << 8) | l4[1]) == ECHO_PORT))
+	{
+		results.udp_replies++;
+		results.udp_echo_ns += now_ns() - echo_sent_ns[((l4[8] << 8) | l4[9]) % MAX_ECHOES];
+	}
+	else if (ip[9] == 6)
+	{
+		check_tcp_segment(ip, ip_len);
+	}
+}
+
+/* Services installed by the simulation, they run in the lwIP context like the application would */
+
+static void udp_echo_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
+{
+	(void)arg;
+	udp_sendto(pcb, p, addr, port);
+	pbuf_free(p);
+}
+
+static err_t tcp_service_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err)
+{
+	(void)arg;
+	(void)err;
+	if (p == NULL)
+	{
+		return ERR_OK;
+	}
+	for (struct pbuf *q = p; q != NULL; q = q->next)
+	{
+		for (uint16_t i = 0; i < q->len; ++i)
+		{
+			if (((uint8_t *)q->payload)[i] != (uint8_t)results.tcp_rx_bytes)
+			{
+				results.tcp_rx_out_of_order++;
+			}
+			results.tcp_rx_bytes++;
+		}
+	}
+	tcp_recved(pcb, p->tot_len);
+	pbuf_free(p);
+	return ERR_OK;
+}
+
+static err_t tcp_service_accept(void *arg, struct tcp_pcb *pcb, err_t err)
+{
+	static uint8_t data[TCP_SND_BUF];
+	(void)arg;
+	(void)err;
+	for (uint16_t i = 0; i < sizeof(data); ++i)
+	{
+		data[i] = (uint8_t)i;
+	}
+	tcp_recv(pcb, tcp_service_recv);
+	if (options.tcp_tx_bytes)
+	{
+		tcp_write(pcb, data, options.tcp_tx_bytes, TCP_WRITE_FLAG_COPY);
+		tcp_output(pcb);
+	}
+	return ERR_OK;
+}
+
+static void start_services(void)
+{
+	struct udp_pcb *udp = udp_new();
+	configASSERT(udp != NULL);
+	udp_bind(udp, IP_ADDR_ANY, ECHO_PORT);
+	udp_recv(udp, udp_echo_recv, NULL);
+
+	struct tcp_pcb *tcp = tcp_new();
+	configASSERT(tcp != NULL);
+	tcp_bind(tcp, IP_ADDR_ANY, ECHO_PORT);
+	tcp = tcp_listen(tcp);
+	tcp_accept(tcp, tcp_service_accept);
+}
+
+/* Simulated host */
+
+static void tcp_peer_step(TickType_t t)
+{
+	if (t == schedule.tcp_start)
+	{
+		peer.stream_start = HOST_ISN + 1;
+		peer.snd_nxt = HOST_ISN;
+		peer.snd_una = HOST_ISN;
+		send_tcp(HOST_ISN, TCP_FLAG_SYN, 0);
+		peer.snd_nxt = HOST_ISN + 1;
+		return;
+	}
+	if (!peer.established && (peer.rcv_nxt != 0) && (t > schedule.tcp_start))
+	{
+		peer.established = 1;
+		peer.ack_pending = 1;
+	}
+	if (peer.ack_pending)
+	{
+		peer.ack_pending = 0;
+		send_tcp(peer.snd_nxt, TCP_FLAG_ACK, 0);
+	}
+	if (!peer.established)
+	{
+		return;
+	}
+
+	if (options.ooseq_segments && (t == schedule.ooseq_start))
+	{
+		// everything but the first segment, last one first
+		for (uint8_t i = options.ooseq_segments - 1; i >= 1; --i)
+		{
+			send_tcp(peer.snd_nxt + i * TCP_SEGMENT_LEN, TCP_FLAG_ACK, TCP_SEGMENT_LEN);
+		}
+	}
+	else if (options.ooseq_segments && (t == schedule.ooseq_start + 10))
+	{
+		send_tcp(peer.snd_nxt, TCP_FLAG_ACK, TCP_SEGMENT_LEN);
+		peer.snd_nxt += options.ooseq_segments * TCP_SEGMENT_LEN;
+	}
+	else if (options.ooseq_segments && (t > schedule.ooseq_start + 10) && (t < schedule.ack_probe_start) &&
+			(peer.snd_una != peer.snd_nxt) && ((t % 50) == 0))
+	{
+		// go back to the first byte not acknowledged, the segments dropped by the application are sent again
+		const uint32_t len = peer.snd_nxt - peer.snd_una;
+		send_tcp(peer.snd_una, TCP_FLAG_ACK, len < TCP_SEGMENT_LEN ? len : TCP_SEGMENT_LEN);
+	}
+
+	for (uint8_t i = 0; i < options.ack_probes && i < ACK_PROBE_PHASES; ++i)
+	{
+		// one lone segment per second, 1/3 of the TCP fast timer period apart
+		if (t == schedule.ack_probe_start + i * (1000 + TCP_TMR_INTERVAL / ACK_PROBE_PHASES))
+		{
+			ack_probe_sent[i] = t;
+			ack_probe_seq[i] = peer.snd_nxt + TCP_SEGMENT_LEN;
+			send_tcp(peer.snd_nxt, TCP_FLAG_ACK, TCP_SEGMENT_LEN);
+			peer.snd_nxt += TCP_SEGMENT_LEN;
+		}
+	}
+}
+
+static void host_step(TickType_t t)
+{
+	if (t == 2)
+	{
+		send_arp_request();
+	}
+	if ((t >= schedule.pings_start) && (results.icmp_sent < options.pings) && ((t - schedule.pings_start) % EVENT_PERIOD_TICKS == 0))
+	{
+		send_ping(results.icmp_sent++);
+	}
+	if (t == schedule.udp_start - 1)
+	{
+		start_services();
+	}
+	if ((t >= schedule.udp_start) && (results.udp_sent < options.udp_echoes) && ((t - schedule.udp_start) % EVENT_PERIOD_TICKS == 0))
+	{
+		send_udp(results.udp_sent++);
+	}
+	// no connection when there is nothing to exchange
+	if ((t >= schedule.tcp_start) && (options.tcp_tx_bytes || options.ooseq_segments || options.ack_probes))
+	{
+		tcp_peer_step(t);
+	}
+}
+
+/* Report */
+
+static void report_stacks(void)
+{
+	TaskStatus_t tasks[4];
+	const UBaseType_t count = uxTaskGetSystemState(tasks, 4, NULL);
+	for (UBaseType_t i = 0; i < count; ++i)
+	{
+		if (tasks[i].xHandle != xTaskGetIdleTaskHandle())
+		{
+			printf("stack %-16s %5u words never used\n", tasks[i].pcTaskName, (unsigned)tasks[i].usStackHighWaterMark);
+		}
+	}
+}
+
+static int finish(void)
+{
+	struct app_sim_results_t *r = &results;
+	int failed = 0;
+
+	printf("arp replies           %u\n", (unsigned)r->arp_replies);
+	printf("icmp echo             %u/%u replies, %.2f us average\n", (unsigned)r->icmp_replies, (unsigned)r->icmp_sent,
+			r->icmp_replies ? (double)r->icmp_echo_ns / r->icmp_replies / 1000.0 : 0.0);
+	printf("udp echo              %u/%u replies, %.2f us average\n", (unsigned)r->udp_replies, (unsigned)r->udp_sent,
+			r->udp_replies ? (double)r->udp_echo_ns / r->udp_replies / 1000.0 : 0.0);
+	printf("tcp                   %u segments, %u bad checksums, %u/%u bytes received by the host\n",
+			(unsigned)r->tcp_segments, (unsigned)r->tcp_bad_checksums, (unsigned)r->tcp_bytes_received, (unsigned)options.tcp_tx_bytes);
+	printf("tcp service           %u bytes received, %u out of order\n", (unsigned)r->tcp_rx_bytes, (unsigned)r->tcp_rx_out_of_order);
+	for (uint8_t i = 0; i < options.ack_probes && i < ACK_PROBE_PHASES; ++i)
+	{
+		if (r->ack_delay[i])
+		{
+			printf("ack delay %u           %u ms\n", (unsigned)i, (unsigned)r->ack_delay[i]);
+		}
+		else
+		{
+			printf("ack delay %u           no ACK\n", (unsigned)i);
+		}
+	}
+	printf("kernel                %u queue calls, %u notifications, %u task wakeups, %u interrupts\n",
+			(unsigned)app_sim_queue_calls, (unsigned)app_sim_notifications, (unsigned)r->task_wakeups, (unsigned)r->interrupts);
+	printf("spi                   %u transactions, %u bytes, %u counted by the driver\n",
+			(unsigned)sim.stats.spi_transactions, (unsigned)sim.stats.spi_bytes, (unsigned)eth_stats.spi_bytes);
+	printf("frames                %u received, %u filtered, %u dropped, %u transmitted\n",
+			(unsigned)sim.stats.frames_received, (unsigned)sim.stats.frames_filtered,
+			(unsigned)sim.stats.frames_dropped, (unsigned)sim.stats.frames_transmitted);
+	report_stacks();
+
+	failed |= (r->arp_replies != 1);
+	failed |= (r->icmp_replies != r->icmp_sent);
+	failed |= (r->udp_replies != r->udp_sent);
+	failed |= (r->tcp_bad_checksums != 0);
+	failed |= (r->tcp_bytes_received != options.tcp_tx_bytes);
+	failed |= (r->tcp_rx_out_of_order != 0);
+	failed |= (options.ooseq_segments && (r->tcp_rx_bytes < options.ooseq_segments * TCP_SEGMENT_LEN));
+	printf("%s\n", failed ? "FAILED" : "OK");
+	return failed;
+}
+
+/* Runs while every task is blocked: raises the interrupt or moves on to the next tick */
+void vApplicationIdleHook(void)
+{
+	if (enc28_sim_irq_pending(&sim))
+	{
+		// INT is level-triggered here, a cause left pending wakes the packet handling task again
+		results.interrupts++;
+		enc28_test_app_handle_packet_recv_interrupt();
+		return;
+	}
+
+	xTaskIncrementTick();
+	const TickType_t t = xTaskGetTickCount();
+	if (t >= schedule.end)
+	{
+		exit(finish());
+	}
+	host_step(t);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-p pings] [-u udp_echoes] [-t tcp_tx_bytes] [-o ooseq_segments] [-a] [-d]\n"
+			"  -a  measure the delay of the ACK for a lone segment, at %u phases of the TCP timer\n"
+			"  -d  asynchronous buffer transfers\n", prog, ACK_PROBE_PHASES);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	int opt;
+	while ((opt = getopt(argc, argv, "p:u:t:o:ad")) != -1)
+	{
+		switch (opt)
+		{
+		case 'p': options.pings = (uint16_t)atoi(optarg); break;
+		case 'u': options.udp_echoes = (uint16_t)atoi(optarg); break;
+		case 't': options.tcp_tx_bytes = (uint16_t)atoi(optarg); break;
+		case 'o': options.ooseq_segments = (uint8_t)atoi(optarg); break;
+		case 'a': options.ack_probes = ACK_PROBE_PHASES; break;
+		case 'd': options.dma = 1; break;
+		default: usage(argv[0]);
+		}
+	}
+	if ((options.tcp_tx_bytes > TCP_SND_BUF) || (options.ooseq_segments > 16))
+	{
+		usage(argv[0]);
+	}
+
+	schedule.pings_start = 10;
+	schedule.udp_start = schedule.pings_start + options.pings * EVENT_PERIOD_TICKS + 10;
+	schedule.tcp_start = schedule.udp_start + options.udp_echoes * EVENT_PERIOD_TICKS + 10;
+	schedule.ooseq_start = schedule.tcp_start + 20;
+	schedule.ack_probe_start = schedule.ooseq_start + 1000;
+	schedule.end = schedule.ack_probe_start + (options.ack_probes ? ACK_PROBE_PHASES * 1000 : 100);
+
+	enc28_sim_init(&sim);
+	sim.on_transmit = on_transmit;
+	if (options.dma)
+	{
+		enc28_sim_attach_dma(&sim, 0, &spi_ctx, 0, NULL, NULL);
+	}
+	else
+	{
+		enc28_sim_attach(&sim, 0, &spi_ctx);
+	}
+	enc28_test_app(&spi_ctx);
+}
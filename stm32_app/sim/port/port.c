@@ -0,0 +1,117 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Sebastian Baginski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * port.c
+ *
+ * Context switching of the host FreeRTOS port, see portmacro.h.
+ * */
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include <stdlib.h>
+#include <ucontext.h>
+
+/* Context of a task, the top word of its stack points to it */
+struct port_task_context_t
+{
+	ucontext_t uc;
+	TaskFunction_t code;
+	void *params;
+};
+
+/* The first member of the TCB is the top of stack returned by pxPortInitialiseStack */
+extern void * volatile pxCurrentTCB;
+
+static UBaseType_t critical_nesting = 0;
+
+static struct port_task_context_t *port_current_context(void)
+{
+	StackType_t *top_of_stack = *(StackType_t **)pxCurrentTCB;
+	return (struct port_task_context_t *)top_of_stack[0];
+}
+
+static void port_task_entry(void)
+{
+	struct port_task_context_t *context = port_current_context();
+	context->code(context->params);
+	// tasks must not return
+	abort();
+}
+
+StackType_t *pxPortInitialiseStack(StackType_t *pxTopOfStack, TaskFunction_t pxCode, void *pvParameters)
+{
+	struct port_task_context_t *context = malloc(sizeof(*context));
+	configASSERT(context != NULL);
+
+	context->code = pxCode;
+	context->params = pvParameters;
+	getcontext(&context->uc);
+	context->uc.uc_link = NULL;
+
+	// the task runs on its own FreeRTOS stack, below the word holding the context pointer.
+	// makecontext only uses the end of the given range
+	uint8_t *stack_top = (uint8_t *)((uintptr_t)pxTopOfStack & ~(uintptr_t)(portBYTE_ALIGNMENT - 1));
+	context->uc.uc_stack.ss_sp = stack_top - portBYTE_ALIGNMENT;
+	context->uc.uc_stack.ss_size = portBYTE_ALIGNMENT;
+	makecontext(&context->uc, port_task_entry, 0);
+
+	pxTopOfStack[0] = (StackType_t)context;
+	return pxTopOfStack;
+}
+
+BaseType_t xPortStartScheduler(void)
+{
+	setcontext(&port_current_context()->uc);
+	return pdFALSE;
+}
+
+void vPortEndScheduler(void)
+{
+	abort();
+}
+
+void vPortYield(void)
+{
+	struct port_task_context_t *prev = port_current_context();
+	vTaskSwitchContext();
+	struct port_task_context_t *next = port_current_context();
+	if (next != prev)
+	{
+		swapcontext(&prev->uc, &next->uc);
+	}
+}
+
+void vPortEnterCritical(void)
+{
+	++critical_nesting;
+}
+
+void vPortExitCritical(void)
+{
+	configASSERT(critical_nesting > 0);
+	--critical_nesting;
+}
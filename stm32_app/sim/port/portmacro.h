@@ -0,0 +1,86 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Sebastian Baginski
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * portmacro.h
+ *
+ * FreeRTOS port for the host build of the test application. The tasks are
+ * ucontext coroutines on a single thread, switched only when they block or
+ * yield (configUSE_PREEMPTION 0). The tick is advanced by the simulation from
+ * the idle hook, see app_sim.c.
+ * */
+
+#ifndef PORTMACRO_H
+#define PORTMACRO_H
+
+#include <stdint.h>
+
+#define portCHAR		char
+#define portFLOAT		float
+#define portDOUBLE		double
+#define portLONG		long
+#define portSHORT		short
+/* One stack word holds a pointer, like on the target, so the stack depths keep their meaning */
+#define portSTACK_TYPE	uintptr_t
+#define portBASE_TYPE	long
+
+typedef portSTACK_TYPE StackType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+
+typedef uint32_t TickType_t;
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portTICK_TYPE_IS_ATOMIC 1
+
+#define portSTACK_GROWTH		(-1)
+#define portTICK_PERIOD_MS		((TickType_t)1000 / configTICK_RATE_HZ)
+#define portBYTE_ALIGNMENT		16
+#define portPOINTER_SIZE_TYPE	uintptr_t
+#define portDONT_DISCARD		__attribute__((used))
+
+extern void vPortYield(void);
+#define portYIELD()		vPortYield()
+
+/* The "interrupts" are called from the idle hook, the switch happens when the idle task yields */
+#define portEND_SWITCHING_ISR(xSwitchRequired)	(void)(xSwitchRequired)
+#define portYIELD_FROM_ISR(x)					portEND_SWITCHING_ISR(x)
+
+/* There is no interrupt to mask, the critical sections only keep their nesting count */
+extern void vPortEnterCritical(void);
+extern void vPortExitCritical(void);
+#define portSET_INTERRUPT_MASK_FROM_ISR()		0
+#define portCLEAR_INTERRUPT_MASK_FROM_ISR(x)	(void)(x)
+#define portDISABLE_INTERRUPTS()
+#define portENABLE_INTERRUPTS()
+#define portENTER_CRITICAL()					vPortEnterCritical()
+#define portEXIT_CRITICAL()						vPortExitCritical()
+
+#define portTASK_FUNCTION_PROTO(vFunction, pvParameters)	void vFunction(void *pvParameters)
+#define portTASK_FUNCTION(vFunction, pvParameters)			void vFunction(void *pvParameters)
+
+#define portNOP()
+#define portMEMORY_BARRIER()	__asm volatile ("" ::: "memory")
+
+#endif /* PORTMACRO_H */
@@ -29,42 +29,108 @@
  * Implementation of the test application for the ENC28J60 driver.
  * */
 #include "stm32_network_app.h"
+#include "eth_packet_buff.h"
+#include "eth_packet_pool.h"
+#include "eth_ring.h"
+#include "eth_stats.h"
+#include "debug_utils/enc28_trace.h"
 
 #include <assert.h>
-#include <stdio.h>
 #include <string.h>
 
 #include <FreeRTOS.h>
 #include <task.h>
-#include <queue.h>
 
 #define ASSERT_STATUS(s) if ((s) != ENC28_OK) { for(;;); }
-#define PACKET_HANDLER_STACK_DEPTH_WORDS 600
 #define IP_STACK_TASK_DEPTH_WORDS 1000
+/* Sized from the uxTaskGetStackHighWaterMark peak in the host build (stm32_app/sim), with room for the exception
+ * frame with the FPU context and for the C library printf, which the host build replaces */
+#define PACKET_HANDLER_TASK_DEPTH_WORDS 320
+#if ETH_SINGLE_TASK
+#define PACKET_HANDLER_STACK_DEPTH_WORDS (PACKET_HANDLER_TASK_DEPTH_WORDS + IP_STACK_TASK_DEPTH_WORDS)
+#else
+#define PACKET_HANDLER_STACK_DEPTH_WORDS PACKET_HANDLER_TASK_DEPTH_WORDS
+#endif
 #define PACKET_HANDLER_TASK_PRIO 1
 #define IP_STACK_TASK_PRIO 2
+#define SPI_TRANSFER_NOTIFY_INDEX 1
 
-#define PACKET_PTR_SIZE (sizeof(void*))
-#define STATIC_PACKET_QUEUE_SIZE (MAX_ETH_PACKETS * PACKET_PTR_SIZE)
+/* Ring capacities are powers of 2, the "free" ring holds every packet buffer */
+#define FREE_RING_SIZE 32
+/* The "ready" ring also carries the link status events, see post_link_status */
+#define READY_RING_SIZE (2 * FREE_RING_SIZE)
+#define TRANSMIT_RING_SIZE 8
+
+_Static_assert(FREE_RING_SIZE >= MAX_ETH_PACKETS, "FREE_RING_SIZE too small for MAX_ETH_PACKETS");
 
 static volatile uint8_t exti_int_flag = 0;
-static TaskHandle_t packet_task_handle;
-static TaskHandle_t ip_task_handle;
-
-static StaticQueue_t free_packet_buffer_queue_mem;
-static StaticQueue_t ready_packet_buffer_queue_mem;
-static StaticQueue_t transmit_packet_queue_mem;
-static uint8_t free_packet_buff_storage[STATIC_PACKET_QUEUE_SIZE];
-static uint8_t ready_packet_buff_storage[STATIC_PACKET_QUEUE_SIZE];
-static uint8_t transmit_packet_storage[STATIC_PACKET_QUEUE_SIZE];
-QueueHandle_t free_packet_buffer_queue;
-QueueHandle_t ready_packet_buffer_queue;
-QueueHandle_t transmit_packet_queue;
+TaskHandle_t packet_task_handle;
+TaskHandle_t ip_task_handle;
+static ENC28_Device enc28_dev;
+
+#if !ETH_RX_PBUF_POOL
+static struct eth_packet_buff_t *free_packet_buff_storage[FREE_RING_SIZE];
+#endif
+static eth_rx_frame_t *ready_packet_buff_storage[READY_RING_SIZE];
+static struct eth_tx_request_t transmit_packet_storage[TRANSMIT_RING_SIZE];
+
+#if !ETH_RX_PBUF_POOL
+/* Packet buffers returned by the ip stack task to the packet handling task */
+struct eth_ring_t free_packet_buffer_ring = ETH_RING_INIT(free_packet_buff_storage);
+#endif
+/* Received frames passed from the packet handling task to the ip stack task */
+struct eth_ring_t ready_packet_buffer_ring = ETH_RING_INIT(ready_packet_buff_storage);
+/* Frames queued for transmission by the ip stack task */
+struct eth_ring_t transmit_packet_ring = ETH_RING_INIT(transmit_packet_storage);
 
 void enc28_test_app_handle_packet_recv_interrupt(void)
 {
-	vTaskNotifyGiveFromISR(packet_task_handle, NULL);
+	eth_stats_irq_time = ETH_STATS_TIMESTAMP();
+	enc28_trace(ENC28_TRACE_IRQ, 0);
+	xTaskNotifyFromISR(packet_task_handle, ETH_EVENT_INTERRUPT, eSetBits, NULL);
+}
+
+void enc28_test_app_handle_spi_transfer_complete(void)
+{
+	vTaskNotifyGiveIndexedFromISR(packet_task_handle, SPI_TRANSFER_NOTIFY_INDEX, NULL);
+}
+
+static void enc28_wait_spi_transfer(void)
+{
+	// buffer transfers are done only by the packet handling task
+	ulTaskNotifyTakeIndexed(SPI_TRANSFER_NOTIFY_INDEX, pdTRUE, portMAX_DELAY);
+}
+
+#if ETH_FILTER_BROADCAST_ARP
+static ENC28_CommandStatus enc28_filter_broadcast_arp(ENC28_Device *dev)
+{
+	// ARP request: EtherType 0x0806, opcode 1, target protocol address at offset 38
+	uint8_t template_frame[42] = {0};
+	uint8_t byte_mask[42] = {0};
+	const uint32_t ip_addr = ENC28_IP_ADDR;
+
+	template_frame[12] = 0x08;
+	template_frame[13] = 0x06;
+	template_frame[20] = 0x00;
+	template_frame[21] = 0x01;
+	for (uint8_t i = 0; i < 4; ++i)
+	{
+		template_frame[38 + i] = (ip_addr >> (8 * i)) & 0xFF;
+	}
+	memset(&byte_mask[12], 1, 2);
+	memset(&byte_mask[20], 1, 2);
+	memset(&byte_mask[38], 1, 4);
+
+	ENC28_Pattern_Match pm;
+	ENC28_CommandStatus status = enc28_build_pattern_match(template_frame, byte_mask, sizeof(template_frame), &pm);
+	if (status != ENC28_OK)
+	{
+		return status;
+	}
+	// MCEN accepts the broadcast frames too, multicast groups come in through the hash table filter instead (enc28_igmp_mac_filter)
+	return enc28_write_pattern_match(dev, &pm, ENC28_ERXFCON_BCAST | ENC28_ERXFCON_MULTI);
 }
+#endif
 
 extern void ip_stack_task(void *arg);
 extern void packet_handling_task(void * arg);
@@ -74,12 +140,21 @@ void enc28_test_app(ENC28_SPI_Context *ctx)
 {
   ctx->nss_pin_op(1);
 
-  printf("Soft reset\n");
+  if ((ctx->spi_out_async_op || ctx->spi_in_async_op) && (!ctx->spi_async_wait_op))
+  {
+	  ctx->spi_async_wait_op = enc28_wait_spi_transfer;
+  }
 
-  ENC28_CommandStatus status = enc28_do_soft_reset(ctx);
+  ENC28_CommandStatus status = enc28_init_device(&enc28_dev, ctx);
   ASSERT_STATUS(status);
 
-  printf("Initializing...\n");
+  ENC28_LOG_INFO("Soft reset\n");
+
+  status = enc28_do_soft_reset(&enc28_dev);
+  ASSERT_STATUS(status);
+
+  ENC28_LOG_INFO("Initializing...\n");
+  eth_packet_pool_report();
 
   ENC28_MAC_Address mac;
   mac.addr[0] = MAC_ADDR_BYTE_0;
@@ -88,31 +163,37 @@ void enc28_test_app(ENC28_SPI_Context *ctx)
   mac.addr[3] = MAC_ADDR_BYTE_3;
   mac.addr[4] = MAC_ADDR_BYTE_4;
   mac.addr[5] = MAC_ADDR_BYTE_5;
-  status = enc28_do_init(mac, ctx);
+  status = enc28_do_init(mac, NULL, &enc28_dev);
   ASSERT_STATUS(status);
 
   {
 	  ENC28_HW_Rev hw_rev;
-	  status = enc28_do_read_hw_rev(ctx, &hw_rev);
+	  status = enc28_do_read_hw_rev(&enc28_dev, &hw_rev);
 	  ASSERT_STATUS(status);
 
-	  printf("PHID1: 0x%x\n", hw_rev.phid1);
-	  printf("PHID2: 0x%x\n", hw_rev.phid2);
-	  printf("REV ID: %d\n", (int)hw_rev.ethrev);
+	  ENC28_LOG_INFO("PHID1: 0x%x\n", hw_rev.phid1);
+	  ENC28_LOG_INFO("PHID2: 0x%x\n", hw_rev.phid2);
+	  ENC28_LOG_INFO("REV ID: %d\n", (int)hw_rev.ethrev);
   }
 
-  status = enc28_begin_packet_transfer(ctx);
+  status = enc28_begin_packet_transfer(&enc28_dev);
+  ASSERT_STATUS(status);
+
+#if ETH_FILTER_BROADCAST_ARP
+  status = enc28_filter_broadcast_arp(&enc28_dev);
   ASSERT_STATUS(status);
+#endif
 
   BaseType_t task_status = xTaskCreate(
 		  packet_handling_task,
 		  "packet_handler",
 		  PACKET_HANDLER_STACK_DEPTH_WORDS,
-		  ctx,
+		  &enc28_dev,
 		  PACKET_HANDLER_TASK_PRIO,
 		  &packet_task_handle);
   configASSERT(task_status == pdPASS);
 
+#if !ETH_SINGLE_TASK
   task_status = xTaskCreate(ip_stack_task,
 		  "ip_stack",
 		  IP_STACK_TASK_DEPTH_WORDS,
@@ -120,30 +201,7 @@ void enc28_test_app(ENC28_SPI_Context *ctx)
 		  IP_STACK_TASK_PRIO,
 		  &ip_task_handle);
   configASSERT(task_status == pdPASS);
-
-  free_packet_buffer_queue = xQueueCreateStatic(
-		  MAX_ETH_PACKETS,
-		  PACKET_PTR_SIZE,
-		  free_packet_buff_storage,
-		  &free_packet_buffer_queue_mem);
-  configASSERT(free_packet_buffer_queue);
-
-  ready_packet_buffer_queue = xQueueCreateStatic(
-		  MAX_ETH_PACKETS,
-		  PACKET_PTR_SIZE,
-		  ready_packet_buff_storage,
-		  &ready_packet_buffer_queue_mem);
-  configASSERT(ready_packet_buffer_queue);
-
-  transmit_packet_queue = xQueueCreateStatic(
-		  MAX_ETH_PACKETS,
-		  PACKET_PTR_SIZE,
-		  transmit_packet_storage,
-		  &transmit_packet_queue_mem);
-
-  vQueueAddToRegistry(ready_packet_buffer_queue, "ready_packets");
-  vQueueAddToRegistry(free_packet_buffer_queue, "free_packets");
-  vQueueAddToRegistry(transmit_packet_queue, "transmit_queue");
+#endif
 
   vTaskStartScheduler();
 
@@ -36,8 +36,43 @@
 /* Flag to control the use of lwIP library for the IP stack */
 #define USE_LWIP (1)
 
+/* Flag to run the driver and the IP stack in the packet handling task, each frame is processed to completion
+ * without passing it to the ip stack task */
+#ifndef ETH_SINGLE_TASK
+#define ETH_SINGLE_TASK (0)
+#endif
+
+/* Number of packet buffers in each size class, see eth_packet_pool.h.
+ * ETH_PACKETS_FULL has to exceed the frames lwIP can queue, see the TCP_OOSEQ_MAX_PBUFS comment in lwipopts.h */
+#define ETH_PACKETS_SMALL 16
+#define ETH_PACKETS_MEDIUM 6
+#define ETH_PACKETS_FULL 5
+
 /* Maximum number of ethernet packets in use */
-#define MAX_ETH_PACKETS 8
+#define MAX_ETH_PACKETS (ETH_PACKETS_SMALL + ETH_PACKETS_MEDIUM + ETH_PACKETS_FULL)
+
+/* Maximum number of ethernet packets read from the ENC28J60 in one burst */
+#define ETH_RX_BURST_PACKETS 4
+
+/* Maximum number of pbuf segments sent without flattening the chain */
+#define ETH_TX_MAX_SEGMENTS 8
+
+/* Smallest TCP segment (header + data) checksummed by the ENC28J60 DMA engine instead of the CPU */
+#define ETH_TX_CHECKSUM_OFFLOAD_MIN_LEN 1024
+
+/* Flag to drop broadcast frames other than the ARP requests for ENC28_IP_ADDR in the ENC28J60 pattern match filter,
+ * an example of the filter API. Only for networks where the device needs no other broadcast: DHCP, NetBIOS
+ * and the other UDP broadcasts are dropped too */
+#ifndef ETH_FILTER_BROADCAST_ARP
+#define ETH_FILTER_BROADCAST_ARP (0)
+#endif
+
+/* Events signalled to the packet handling task through its notification value */
+#define ETH_EVENT_INTERRUPT			(1 << 0)	/* The INT pin of the ENC28J60 has asserted */
+#define ETH_EVENT_TX_REQUEST		(1 << 1)	/* A frame was added to the empty transmit ring */
+#define ETH_EVENT_RX_BUFFER_FREE	(1 << 2)	/* A packet buffer was returned to the empty free ring */
+#define ETH_EVENT_FILTER_UPDATE		(1 << 3)	/* The multicast hash table has changed */
+#define ETH_EVENT_ALL				(ETH_EVENT_INTERRUPT | ETH_EVENT_TX_REQUEST | ETH_EVENT_RX_BUFFER_FREE | ETH_EVENT_FILTER_UPDATE)
 
 /* MAC address for the ENC28J60 interface, byte 0 */
 #define MAC_ADDR_BYTE_0 0xDE
@@ -60,8 +95,15 @@
  * */
 extern void enc28_test_app_handle_packet_recv_interrupt(void);
 
+/*
+ * @brief Handles the end of an asynchronous SPI transfer. Should be called in the SPI DMA completion interrupt handler.
+ * */
+extern void enc28_test_app_handle_spi_transfer_complete(void);
+
 /*
  * @brief Entry point for the ENC28J60 driver test application. Does not return.
+ * @note When the context provides the asynchronous SPI callbacks without spi_async_wait_op,
+ * the packet handling task blocks on a task notification until enc28_test_app_handle_spi_transfer_complete is called.
  * */
 extern void enc28_test_app(ENC28_SPI_Context *ctx) __attribute__ ((noreturn));
 
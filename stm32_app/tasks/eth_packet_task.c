@@ -31,79 +31,387 @@
 
 #include "enc28j60.h"
 #include "eth_packet_buff.h"
+#include "eth_packet_pool.h"
+#include "eth_ring.h"
+#include "eth_stats.h"
+#include "debug_utils/enc28_trace.h"
 #include "stm32_network_app.h"
 #include <FreeRTOS.h>
-#include <queue.h>
+#include <task.h>
+#include <lwip/pbuf.h>
 #include <string.h>
-#include <stdio.h>
 
-extern QueueHandle_t free_packet_buffer_queue;
-extern QueueHandle_t ready_packet_buffer_queue;
-extern QueueHandle_t transmit_packet_queue;
+#if !ETH_RX_PBUF_POOL
+extern struct eth_ring_t free_packet_buffer_ring;
+#endif
+extern struct eth_ring_t ready_packet_buffer_ring;
+extern struct eth_ring_t transmit_packet_ring;
+extern TaskHandle_t ip_task_handle;
+extern uint8_t eth_multicast_hash_table[ENC28_HASH_TABLE_SIZE];
+#if ETH_SINGLE_TASK
+extern void ip_stack_init(void);
+extern void ip_stack_input(eth_rx_frame_t *packet);
+extern TickType_t ip_stack_poll(void);
+#endif
 
-static struct eth_packet_buff_t eth_packets[MAX_ETH_PACKETS];
+/* Link status published to the ip stack task, see post_link_status */
+volatile uint8_t eth_link_up = 0;
 
-void packet_handling_task(void * arg)
+/* EIE.PKTIE is disabled until a packet buffer is returned. The ip stack task checks it after freeing pbufs with ETH_RX_PBUF_POOL,
+ * otherwise to release the TCP out-of-sequence queues.
+ * Set before the last allocation attempt and cleared by resume_rx, accessed with the __atomic builtins. */
+volatile uint8_t eth_rx_stalled = 0;
+
+/* State of the packet handling task, shared with the interrupt handlers */
+struct packet_task_state_t
 {
-	ENC28_SPI_Context *ctx = (ENC28_SPI_Context*)arg;
-	uint8_t pkt_buf[MAX_ETH_PACKET_SIZE];
-	UBaseType_t stack_high_watermark = 0;
-	ENC28_Receive_Status_Vector status_vec;
-	ENC28_CommandStatus rcv_stat;
+	eth_rx_frame_t *rx_slots[ETH_RX_BURST_PACKETS];
+	ENC28_Receive_Status_Vector status_vecs[ETH_RX_BURST_PACKETS];
+	uint8_t rx_slot_count;
+	uint8_t rx_no_buffer;		/* The last burst stopped at a frame no free packet buffer fits */
+	struct eth_tx_request_t tx_in_flight[ENC28_CONF_TX_MAX_SLOTS];
+	uint8_t tx_in_flight_head;
+	uint8_t tx_in_flight_count;
+};
+
+#if !ETH_RX_PBUF_POOL
+/*
+ * Takes back a packet buffer released in the context of this task
+ * */
+void eth_packet_task_reclaim_buffer(struct eth_packet_buff_t *packet)
+{
+	eth_packet_pool_free(packet);
+}
+#endif
 
-	for (size_t i = 0; i < sizeof(eth_packets) / sizeof(eth_packets[0]); ++i)
+static void pass_to_ip_task(eth_rx_frame_t *packet)
+{
+	// the ring holds every packet buffer and the link events, it cannot overflow
+	uint8_t notify = 0;
+	uint8_t pushed = eth_ring_push(&ready_packet_buffer_ring, &packet, &notify);
+	configASSERT(pushed);
+#if ETH_SINGLE_TASK
+	// drained by this task after the interrupts are serviced
+	(void)notify;
+#else
+	if (notify)
 	{
-		struct eth_packet_buff_t *item = &eth_packets[i];
-		BaseType_t status = xQueueSend(free_packet_buffer_queue, &item, 0);
-		configASSERT(status == pdPASS);
-		memset(&eth_packets[i], 0xFF, sizeof(eth_packets[i]));
+		xTaskNotifyGive(ip_task_handle);
 	}
+#endif
+	eth_stats_update_hwm(&eth_stats.ready_queue_hwm, eth_ring_count(&ready_packet_buffer_ring));
+}
 
-	while (1)
+/*
+ * Picks the packet buffer for the next frame, called by the driver once the frame length is known
+ * */
+static uint8_t *alloc_rx_buffer(uint16_t packet_len, void *user)
+{
+	struct packet_task_state_t *state = (struct packet_task_state_t *)user;
+#if ETH_RX_PBUF_POOL
+	// a pool pbuf holds the whole frame, lwIP returns it to the pool
+	struct pbuf *packet = pbuf_alloc(PBUF_RAW, packet_len, PBUF_POOL);
+#else
+	struct eth_packet_buff_t *packet = eth_packet_pool_alloc(packet_len);
+#endif
+	if (!packet)
 	{
-		rcv_stat = enc28_read_packet(ctx, pkt_buf, sizeof(pkt_buf), &status_vec);
+		state->rx_no_buffer = 1;
+		return NULL;
+	}
+
+	configASSERT(state->rx_slot_count < ETH_RX_BURST_PACKETS);
+	state->rx_slots[state->rx_slot_count++] = packet;
+#if ETH_RX_PBUF_POOL
+	configASSERT(packet->next == NULL);
+	return (uint8_t *)packet->payload;
+#else
+	packet->used_bytes = packet_len;
+	return packet->buf;
+#endif
+}
 
-		while (rcv_stat == ENC28_OK)
+static void resume_rx(ENC28_Device *dev)
+{
+	if (__atomic_exchange_n(&eth_rx_stalled, 0, __ATOMIC_SEQ_CST))
+	{
+		// PKTIF is still pending, INT asserts again right away
+		ENC28_CommandStatus status = enc28_do_set_bits_ctl_reg(dev, ENC28_CR_EIE, (1 << ENC28_EIE_PKTIE));
+		configASSERT(status == ENC28_OK);
+	}
+}
+
+static void handle_packet_pending(ENC28_Device *dev, void *user)
+{
+	struct packet_task_state_t *state = (struct packet_task_state_t *)user;
+	const ENC28_Rx_Buffer_Provider provider = {alloc_rx_buffer, ETH_PACKET_FULL_SIZE, state};
+	ENC28_CommandStatus rcv_stat = ENC28_OK;
+	uint8_t stall_published = 0;
+
+	while (rcv_stat == ENC28_OK)
+	{
+		uint8_t packets_read = 0;
+#if !ETH_RX_PBUF_POOL
+		struct eth_packet_buff_t *free_buf = NULL;
+
+		// take back the buffers released by the ip stack task
+		while (eth_ring_pop(&free_packet_buffer_ring, &free_buf))
 		{
-			const uint16_t packet_len = (status_vec.packet_len_hi << 8) | status_vec.packet_len_lo;
-			printf("GOT PACKET, LEN= %d\n", packet_len);
+			eth_packet_pool_free(free_buf);
+		}
+#endif
 
-			{
-				struct eth_packet_buff_t *free_buf = NULL;
-				BaseType_t status = xQueueReceive(free_packet_buffer_queue, &free_buf, portMAX_DELAY);
+		// frames are read straight into the smallest packet buffer they fit in
+		state->rx_slot_count = 0;
+		state->rx_no_buffer = 0;
+		rcv_stat = enc28_read_packets_sized(dev, &provider, state->status_vecs, ETH_RX_BURST_PACKETS, &packets_read);
+		configASSERT(state->rx_slot_count == packets_read);
 
-				configASSERT(status == pdPASS);
-				configASSERT(free_buf);
+		for (uint8_t i = 0; i < packets_read; ++i)
+		{
+#if ETH_RX_PBUF_POOL
+			const uint16_t packet_len = state->rx_slots[i]->tot_len;
+			state->rx_slots[i]->enc28_irq_time = eth_stats_irq_time;
+#else
+			const uint16_t packet_len = state->rx_slots[i]->used_bytes;
+			state->rx_slots[i]->irq_time = eth_stats_irq_time;
+#endif
+			enc28_trace(ENC28_TRACE_RX_FRAME, packet_len);
+			ENC28_LOG_DEBUG("GOT PACKET, LEN= %d\n", packet_len);
 
-				free_buf->used_bytes = packet_len;
-				memcpy(free_buf->buf, pkt_buf, packet_len);
+			pass_to_ip_task(state->rx_slots[i]);
+			eth_stats.rx_frames++;
+			eth_stats.rx_bytes += packet_len;
+		}
 
-				status = xQueueSend(ready_packet_buffer_queue, &free_buf, portMAX_DELAY);
-				configASSERT(status == pdPASS);
-			}
+		const uint8_t out_of_buffers = state->rx_no_buffer && (packets_read == 0);
+		if (stall_published && !out_of_buffers)
+		{
+			// the second attempt found a buffer
+			resume_rx(dev);
+			stall_published = 0;
+		}
 
-			rcv_stat = enc28_read_packet(ctx, pkt_buf, sizeof(pkt_buf), &status_vec);
-			stack_high_watermark = uxTaskGetStackHighWaterMark(NULL);
-			configASSERT(stack_high_watermark > 0); // stack exhausted !
+		if (out_of_buffers)
+		{
+			if (!stall_published)
+			{
+				// PKTIF stays set, mask it so INT does not fire again before a buffer is free
+				ENC28_CommandStatus status = enc28_do_clear_bits_ctl_reg(dev, ENC28_CR_EIE, (1 << ENC28_EIE_PKTIE));
+				configASSERT(status == ENC28_OK);
+				__atomic_store_n(&eth_rx_stalled, 1, __ATOMIC_SEQ_CST);
+				// a buffer released between the failed allocation and the store did not see the flag, try once more
+				stall_published = 1;
+				rcv_stat = ENC28_OK;
+				continue;
+			}
+			eth_stats.rx_pool_empty++;
+			enc28_trace(ENC28_TRACE_RX_STALL, 0);
+			break;
 		}
+	}
+}
+
+static void post_link_status(uint8_t link_up)
+{
+	// a NULL packet in the "ready" ring tells the ip stack task to pick up the new link status
+	enc28_trace(ENC28_TRACE_LINK, link_up);
+	eth_link_up = link_up;
+	pass_to_ip_task(NULL);
+}
+
+static void handle_link_changed(ENC28_Device *dev, uint8_t link_up, void *user)
+{
+	(void)dev;
+	(void)user;
+	post_link_status(link_up);
+}
+
+static void release_tx_request(ENC28_Device *dev, const struct eth_tx_request_t *request)
+{
+	if (request->p)
+	{
+		// the last reference to a received frame hands its buffer back through eth_packet_task_reclaim_buffer
+		pbuf_free(request->p);
+		resume_rx(dev);
+	}
+	else
+	{
+#if ETH_RX_PBUF_POOL
+		// frames are queued only as pbufs
+		configASSERT(0);
+#else
+		eth_packet_pool_free(request->buff);
+		resume_rx(dev);
+#endif
+	}
+}
+
+static void handle_transmit_done(ENC28_Device *dev, ENC28_CommandStatus tx_status,
+		const ENC28_Transmit_Status_Vector *status_vec, void *user)
+{
+	struct packet_task_state_t *state = (struct packet_task_state_t *)user;
 
+	// frames stay referenced until the module reports the end of the transmission, in upload order
+	configASSERT(state->tx_in_flight_count > 0);
+	struct eth_tx_request_t *done = &state->tx_in_flight[state->tx_in_flight_head];
+	enc28_trace(ENC28_TRACE_TX_DONE, tx_status);
+	if (tx_status == ENC28_OK)
+	{
+		eth_stats.tx_frames++;
+		eth_stats.tx_bytes += (status_vec->byte_count_hi << 8) | status_vec->byte_count_lo;
+	}
+	else
+	{
+		eth_stats.tx_aborted++;
+	}
+	eth_stats_record_latency(&eth_stats.tx_latency, ETH_STATS_TIMESTAMP() - done->queued_time);
+
+	release_tx_request(dev, done);
+	state->tx_in_flight_head = (state->tx_in_flight_head + 1) % ENC28_CONF_TX_MAX_SLOTS;
+	--state->tx_in_flight_count;
+}
+
+static void update_multicast_filter(ENC28_Device *dev)
+{
+	uint8_t table[ENC28_HASH_TABLE_SIZE];
+
+	// the table is updated by the ip stack task
+	taskENTER_CRITICAL();
+	memcpy(table, eth_multicast_hash_table, sizeof(table));
+	taskEXIT_CRITICAL();
+
+	ENC28_CommandStatus status = enc28_write_hash_table(dev, table);
+	configASSERT(status == ENC28_OK);
+}
 
+static void upload_pending_frames(ENC28_Device *dev, struct packet_task_state_t *state)
+{
+	// upload the next frames while the previous one is on the wire
+	while (state->tx_in_flight_count < dev->layout.tx_slot_count)
+	{
+		struct eth_tx_request_t request;
+		if (!eth_ring_pop(&transmit_packet_ring, &request))
 		{
+			break;
+		}
+
+		ENC28_Packet_Segment segments[ETH_TX_MAX_SEGMENTS];
+		uint8_t segment_count = 0;
+		ENC28_CommandStatus send_stat = ENC28_OK;
+		if (request.p)
+		{
+			for (struct pbuf *q = request.p; q != NULL; q = q->next)
 			{
-				struct eth_packet_buff_t *to_send = NULL;
-				BaseType_t status = xQueueReceive(transmit_packet_queue, &to_send, 0);
-				if (status == pdPASS)
+				if (segment_count == ETH_TX_MAX_SEGMENTS)
 				{
-					ENC28_CommandStatus send_stat = enc28_write_packet(ctx, to_send->buf, to_send->used_bytes);
-					configASSERT(send_stat == ENC28_OK);
-					xQueueSend(free_packet_buffer_queue, &to_send, 0);
+					send_stat = ENC28_INVALID_PARAM;
+					break;
 				}
+				segments[segment_count].data = (const uint8_t *)q->payload;
+				segments[segment_count].len = q->len;
+				++segment_count;
 			}
+		}
+		else
+		{
+			segments[0].data = request.buff->buf;
+			segments[0].len = request.buff->used_bytes;
+			segment_count = 1;
+		}
 
-			stack_high_watermark = uxTaskGetStackHighWaterMark(NULL);
-			configASSERT(stack_high_watermark > 0); // stack exhausted !
+		if (send_stat == ENC28_OK)
+		{
+			send_stat = enc28_write_packet_chain(dev, segments, segment_count,
+					request.use_csum ? &request.csum : NULL);
 		}
+		if (send_stat != ENC28_OK)
+		{
+			// a malformed or oversized frame from the ip stack task is dropped, the slot stays free for the next one
+			enc28_trace(ENC28_TRACE_TX_DONE, send_stat);
+			eth_stats.tx_aborted++;
+			release_tx_request(dev, &request);
+			continue;
+		}
+		state->tx_in_flight[(state->tx_in_flight_head + state->tx_in_flight_count) % ENC28_CONF_TX_MAX_SLOTS] = request;
+		++state->tx_in_flight_count;
+	}
+}
+
+void packet_handling_task(void * arg)
+{
+	ENC28_Device *dev = (ENC28_Device*)arg;
+	UBaseType_t stack_high_watermark = 0;
+	TickType_t sleep_ticks = portMAX_DELAY;
+	static struct packet_task_state_t state;
+	const ENC28_Interrupt_Handlers handlers = {
+		.packet_pending = handle_packet_pending,
+		.transmit_done = handle_transmit_done,
+		.receive_error = NULL,
+		.link_changed = handle_link_changed,
+		.user = &state
+	};
+
+#if !ETH_RX_PBUF_POOL
+	eth_packet_pool_init();
+#endif
+
+#if ETH_SINGLE_TASK
+	ip_stack_init();
+#endif
+
+	{
+		uint8_t link_up = 0;
+		ENC28_CommandStatus status = enc28_update_link_status(dev, &link_up);
+		configASSERT(status == ENC28_OK);
+		post_link_status(link_up);
+	}
+
+	// service whatever was pending before the task started
+	uint32_t events = ETH_EVENT_INTERRUPT;
+
+	while (1)
+	{
+		if (events & ETH_EVENT_INTERRUPT)
+		{
+			ENC28_CommandStatus status = enc28_service_interrupts(dev, &handlers, NULL);
+			configASSERT(status == ENC28_OK);
+		}
+
+		if (events & ETH_EVENT_RX_BUFFER_FREE)
+		{
+			resume_rx(dev);
+		}
+
+		if (events & ETH_EVENT_FILTER_UPDATE)
+		{
+			update_multicast_filter(dev);
+		}
+
+#if ETH_SINGLE_TASK
+		{
+			// run to completion: lwIP consumes the frames read above, replies are uploaded right after
+			eth_rx_frame_t *ready_packet = NULL;
+			while (eth_ring_pop(&ready_packet_buffer_ring, &ready_packet))
+			{
+				ip_stack_input(ready_packet);
+			}
+			sleep_ticks = ip_stack_poll();
+			// buffers released by lwIP are already back in the pool
+			resume_rx(dev);
+		}
+#endif
+
+		upload_pending_frames(dev, &state);
+
+		eth_stats.rx_errors = dev->stats.rx_errors;
+		eth_stats.rx_too_long = dev->stats.rx_too_long;
+		eth_stats.spi_bytes = dev->stats.spi_bytes;
+
+		stack_high_watermark = uxTaskGetStackHighWaterMark(NULL);
+		configASSERT(stack_high_watermark > 0); // stack exhausted !
 
-		ulTaskNotifyTake(pdTRUE, 10);
+		events = 0;
+		xTaskNotifyWait(0, ETH_EVENT_ALL, &events, sleep_ticks);
 	}
 }
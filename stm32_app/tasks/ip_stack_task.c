@@ -31,51 +31,353 @@
 
 #include "stm32_network_app.h"
 #include "eth_packet_buff.h"
+#include "eth_ring.h"
+#include "eth_stats.h"
 #include "debug_utils/enc28_debug.h"
+#include "debug_utils/enc28_trace.h"
 #include <FreeRTOS.h>
-#include <queue.h>
+#include <task.h>
 #include <lwip/init.h>
 #include <lwip/netif.h>
 #include <lwip/sys.h>
 #include <lwip/etharp.h>
 #include <lwip/timeouts.h>
+#include <lwip/inet_chksum.h>
+#include <lwip/snmp.h>
+#include <lwip/stats.h>
+#include <lwip/ip.h>
+#include <lwip/prot/tcp.h>
+#include <lwip/priv/tcp_priv.h>
 #include <string.h>
 
-extern QueueHandle_t free_packet_buffer_queue;
-extern QueueHandle_t ready_packet_buffer_queue;
-extern QueueHandle_t transmit_packet_queue;
+#if ETH_RX_PBUF_POOL && (USE_LWIP == 0)
+#error "ETH_RX_PBUF_POOL requires USE_LWIP"
+#endif
+
+extern struct eth_ring_t ready_packet_buffer_ring;
+extern struct eth_ring_t transmit_packet_ring;
+extern TaskHandle_t packet_task_handle;
+extern volatile uint8_t eth_link_up;
+extern volatile uint8_t eth_rx_stalled;
+#if !ETH_RX_PBUF_POOL
+extern struct eth_ring_t free_packet_buffer_ring;
+extern void eth_packet_task_reclaim_buffer(struct eth_packet_buff_t *packet);
+#endif
 
 extern uint32_t HAL_GetTick(void);
 
+/* Multicast hash table, written to the ENC28J60 by the packet handling task */
+uint8_t eth_multicast_hash_table[ENC28_HASH_TABLE_SIZE];
+
+/* Number of joined groups per hash table bit, groups can share a bit */
+static uint8_t multicast_hash_refs[ENC28_HASH_TABLE_SIZE * 8];
+
+static struct netif net_ifc;
+
+/*
+ * Fills in the TCP checksum left out by lwIP.
+ * Large segments are summed by the ENC28J60 DMA engine after the upload, the pseudo-header sum goes to the driver
+ * as the seed: the pbuf can still be on the unacked queue and is shared with the packet handling task, its checksum
+ * field stays 0. Smaller ones are cheaper to sum on the CPU than the SPI round trips, the result is stored like lwIP
+ * stores its own checksums (tcp_output_segment clears the field before each transmission).
+ * @return 1 if @p csum has to be passed to the driver
+ * */
+static uint8_t enc28_prepare_tx_checksum(struct pbuf *p, ENC28_Tx_Checksum *csum)
+{
+	if ((p->len < SIZEOF_ETH_HDR + IP_HLEN) || (((struct eth_hdr *)p->payload)->type != PP_HTONS(ETHTYPE_IP)))
+	{
+		return 0;
+	}
+	struct ip_hdr *iph = (struct ip_hdr *)((uint8_t *)p->payload + SIZEOF_ETH_HDR);
+	const uint16_t ip_hlen = IPH_HL_BYTES(iph);
+	if ((IPH_PROTO(iph) != IP_PROTO_TCP) || (p->len < SIZEOF_ETH_HDR + ip_hlen + TCP_HLEN))
+	{
+		return 0;
+	}
+	const uint16_t tcp_len = lwip_ntohs(IPH_LEN(iph)) - ip_hlen;
+	struct tcp_hdr *tcph = (struct tcp_hdr *)((uint8_t *)iph + ip_hlen);
+
+	if (tcp_len < ETH_TX_CHECKSUM_OFFLOAD_MIN_LEN)
+	{
+		ip4_addr_t src, dest;
+		ip4_addr_copy(src, iph->src);
+		ip4_addr_copy(dest, iph->dest);
+		pbuf_remove_header(p, SIZEOF_ETH_HDR + ip_hlen);
+		tcph->chksum = inet_chksum_pseudo(p, IP_PROTO_TCP, tcp_len, &src, &dest);
+		pbuf_add_header(p, SIZEOF_ETH_HDR + ip_hlen);
+		return 0;
+	}
+
+	// source and destination addresses, protocol and length, folded but not complemented
+	const uint8_t *addr = (const uint8_t *)&iph->src;
+	uint32_t sum = IP_PROTO_TCP + tcp_len;
+	for (uint8_t i = 0; i < 8; i += 2)
+	{
+		sum += ((uint32_t)addr[i] << 8) | addr[i + 1];
+	}
+	sum = (sum >> 16) + (sum & 0xFFFF);
+	sum += (sum >> 16);
+
+	csum->start = SIZEOF_ETH_HDR + ip_hlen;
+	csum->len = tcp_len;
+	csum->field = csum->start + 16;
+	csum->seed = (uint16_t)sum;
+	return 1;
+}
+
+/*
+ * Passes the frame to the packet handling task, which is woken up only if it has already drained the ring
+ * @return 1 on success, 0 if the ring is full
+ * */
+static uint8_t enc28_queue_tx_request(const struct eth_tx_request_t *request)
+{
+	uint8_t notify = 0;
+	if (!eth_ring_push(&transmit_packet_ring, request, &notify))
+	{
+		eth_stats.tx_queue_full++;
+		return 0;
+	}
+#if ETH_SINGLE_TASK
+	// the packet handling task uploads the frame once lwIP returns
+	(void)notify;
+#else
+	if (notify)
+	{
+		xTaskNotify(packet_task_handle, ETH_EVENT_TX_REQUEST, eSetBits);
+	}
+#endif
+	eth_stats_update_hwm(&eth_stats.tx_queue_hwm, eth_ring_count(&transmit_packet_ring));
+	return 1;
+}
+
+#if !ETH_RX_PBUF_POOL
+static void enc28_return_packet_buffer(struct eth_packet_buff_t *packet)
+{
+	if (xTaskGetCurrentTaskHandle() == packet_task_handle)
+	{
+		// reply built in place of a received frame released after the transmission, or ETH_SINGLE_TASK
+		eth_packet_task_reclaim_buffer(packet);
+		return;
+	}
+
+	// the ring has room for every packet buffer
+	uint8_t notify = 0;
+	uint8_t pushed = eth_ring_push(&free_packet_buffer_ring, &packet, &notify);
+	configASSERT(pushed);
+	if (notify)
+	{
+		xTaskNotify(packet_task_handle, ETH_EVENT_RX_BUFFER_FREE, eSetBits);
+	}
+}
+#endif
+
 static err_t enc28_netif_output(struct netif *netif, struct pbuf *p)
 {
-	struct eth_packet_buff_t *ip_resp = NULL;
-	BaseType_t status = xQueueReceive(free_packet_buffer_queue, &ip_resp, 0);
-	if (status == pdPASS)
+	struct pbuf *to_send = p;
+	if (pbuf_clen(p) > ETH_TX_MAX_SEGMENTS)
+	{
+		to_send = pbuf_clone(PBUF_RAW, PBUF_RAM, p);
+		if (!to_send)
+		{
+			return ERR_MEM;
+		}
+	}
+	else
+	{
+		// the packet handling task releases the reference after the transmission
+		pbuf_ref(to_send);
+	}
+
+	struct eth_tx_request_t request;
+	request.p = to_send;
+	request.buff = NULL;
+	request.use_csum = enc28_prepare_tx_checksum(to_send, &request.csum);
+	request.queued_time = ETH_STATS_TIMESTAMP();
+
+	if (!enc28_queue_tx_request(&request))
+	{
+		pbuf_free(to_send);
+		return ERR_MEM;
+	}
+	enc28_trace(ENC28_TRACE_TX_QUEUED, p->tot_len);
+
+	LINK_STATS_INC(link.xmit);
+	MIB2_STATS_NETIF_ADD(netif, ifoutoctets, p->tot_len);
+	if (((const uint8_t *)p->payload)[0] & 0x1)
+	{
+		MIB2_STATS_NETIF_INC(netif, ifoutnucastpkts);
+	}
+	else
+	{
+		MIB2_STATS_NETIF_INC(netif, ifoutucastpkts);
+	}
+	return ERR_OK;
+}
+
+static err_t enc28_update_multicast_filter(const uint8_t mac_addr[6], enum netif_mac_filter_action action)
+{
+	const uint8_t index = enc28_hash_table_index(mac_addr);
+	const uint8_t bit = (1 << (index & 0x7));
+
+	if (action == NETIF_ADD_MAC_FILTER)
 	{
-		ip_resp->used_bytes = p->len;
-		memcpy(ip_resp->buf, p->payload, p->len);
-		xQueueSend(transmit_packet_queue, &ip_resp, 0);
+		if (multicast_hash_refs[index] == UINT8_MAX)
+		{
+			return ERR_MEM;
+		}
+		++multicast_hash_refs[index];
+	}
+	else if (multicast_hash_refs[index] > 0)
+	{
+		--multicast_hash_refs[index];
+	}
+
+	{
+		const uint8_t old_value = eth_multicast_hash_table[index >> 3];
+		taskENTER_CRITICAL();
+		if (multicast_hash_refs[index] > 0)
+		{
+			eth_multicast_hash_table[index >> 3] |= bit;
+		}
+		else
+		{
+			eth_multicast_hash_table[index >> 3] &= ~bit;
+		}
+		taskEXIT_CRITICAL();
+
+		if (eth_multicast_hash_table[index >> 3] != old_value)
+		{
+			xTaskNotify(packet_task_handle, ETH_EVENT_FILTER_UPDATE, eSetBits);
+		}
 	}
 	return ERR_OK;
 }
 
+#if LWIP_IGMP
+static err_t enc28_igmp_mac_filter(struct netif *netif, const ip4_addr_t *group, enum netif_mac_filter_action action)
+{
+	// RFC 1112: 01:00:5E followed by the low 23 bits of the group address
+	const uint8_t mac_addr[6] = {0x01, 0x00, 0x5E, ip4_addr2(group) & 0x7F, ip4_addr3(group), ip4_addr4(group)};
+	(void)netif;
+	return enc28_update_multicast_filter(mac_addr, action);
+}
+#endif
+
+#if LWIP_IPV6 && LWIP_IPV6_MLD
+static err_t enc28_mld_mac_filter(struct netif *netif, const ip6_addr_t *group, enum netif_mac_filter_action action)
+{
+	// RFC 2464: 33:33 followed by the low 32 bits of the group address
+	const uint8_t *group_bytes = (const uint8_t *)&group->addr[3];
+	const uint8_t mac_addr[6] = {0x33, 0x33, group_bytes[0], group_bytes[1], group_bytes[2], group_bytes[3]};
+	(void)netif;
+	return enc28_update_multicast_filter(mac_addr, action);
+}
+#endif
+
 u32_t sys_now(void)
 {
 	return HAL_GetTick();
 }
 
+/*
+ * Time until the next lwIP timer expires, the ip stack task does not sleep longer than that
+ * */
+static TickType_t enc28_timeouts_sleep_ticks(void)
+{
+	const u32_t sleep_ms = sys_timeouts_sleeptime();
+	if (sleep_ms == SYS_TIMEOUTS_SLEEPTIME_INFINITE)
+	{
+		return portMAX_DELAY;
+	}
+	// round up, waking up before the deadline would only spin
+	return (TickType_t)(((uint64_t)sleep_ms * configTICK_RATE_HZ + 999) / 1000);
+}
+
+sys_prot_t sys_arch_protect(void)
+{
+	taskENTER_CRITICAL();
+	return 0;
+}
+
+void sys_arch_unprotect(sys_prot_t pval)
+{
+	(void)pval;
+	taskEXIT_CRITICAL();
+}
+
+/* Publishes the counters kept by the packet handling task through the lwIP statistics */
+static void enc28_sync_stats(struct netif *n_if)
+{
+	(void)n_if;
+#if LINK_STATS
+	lwip_stats.link.err = (STAT_COUNTER)(eth_stats.rx_errors + eth_stats.tx_aborted);
+	lwip_stats.link.lenerr = (STAT_COUNTER)eth_stats.rx_too_long;
+	lwip_stats.link.drop = (STAT_COUNTER)eth_stats.tx_queue_full;
+#endif
+#if MIB2_STATS
+	n_if->mib2_counters.ifinerrors = eth_stats.rx_errors;
+	n_if->mib2_counters.ifouterrors = eth_stats.tx_aborted;
+	n_if->mib2_counters.ifoutdiscards = eth_stats.tx_queue_full;
+#endif
+}
+
+#if ETH_RX_PBUF_POOL
+/* The packet handling task stops reading when PBUF_POOL runs out, wake it up once lwIP has released pbufs */
+static void enc28_resume_rx(void)
+{
+	// pairs with the store in handle_packet_pending: either this load sees the flag or the packet task's retry sees the freed pbufs
+	if (__atomic_load_n(&eth_rx_stalled, __ATOMIC_SEQ_CST) && (xTaskGetCurrentTaskHandle() != packet_task_handle))
+	{
+		xTaskNotify(packet_task_handle, ETH_EVENT_RX_BUFFER_FREE, eSetBits);
+	}
+}
+#else
 static void enc28_pbuf_free(struct pbuf* p)
 {
-	xQueueSend(free_packet_buffer_queue, &p->enc28_eth_packet_ptr, portMAX_DELAY);
+	enc28_return_packet_buffer(p->enc28_eth_packet_ptr);
 }
 
+/*
+ * Releases the TCP out-of-sequence queues once the packet handling task has run out of packet buffers.
+ * lwIP does this only for PBUF_POOL (PBUF_POOL_FREE_OOSEQ), not for the custom pbufs of the received frames,
+ * which would otherwise stay queued until the missing segment or the connection timeout.
+ * */
+static void enc28_free_ooseq(void)
+{
+#if LWIP_TCP && TCP_QUEUE_OOSEQ
+	// frames still in the "ready" ring are released once lwIP has processed them
+	if (!__atomic_load_n(&eth_rx_stalled, __ATOMIC_SEQ_CST) || (eth_ring_count(&ready_packet_buffer_ring) != 0))
+	{
+		return;
+	}
+
+	for (struct tcp_pcb *pcb = tcp_active_pcbs; pcb != NULL; pcb = pcb->next)
+	{
+		if (pcb->ooseq != NULL)
+		{
+			// the buffers go back through enc28_pbuf_free, which wakes up the packet handling task
+			tcp_free_ooseq(pcb);
+			eth_stats.rx_ooseq_freed++;
+		}
+	}
+#endif
+}
+#endif
+
 static err_t enc28_ip_init_callback(struct netif *n_if)
 {
 	n_if->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_ETHERNET | NETIF_FLAG_IGMP | NETIF_FLAG_MLD6;;
 	n_if->linkoutput = enc28_netif_output;
 	n_if->output = etharp_output;
 	n_if->mtu = 1518;
+	NETIF_SET_CHECKSUM_CTRL(n_if, NETIF_CHECKSUM_ENABLE_ALL & ~NETIF_CHECKSUM_GEN_TCP);
+	MIB2_INIT_NETIF(n_if, snmp_ifType_ethernet_csmacd, 10000000);
+#if LWIP_IGMP
+	netif_set_igmp_mac_filter(n_if, enc28_igmp_mac_filter);
+#endif
+#if LWIP_IPV6 && LWIP_IPV6_MLD
+	netif_set_mld_mac_filter(n_if, enc28_mld_mac_filter);
+#endif
 
 	n_if->hwaddr[0] = MAC_ADDR_BYTE_0;
 	n_if->hwaddr[1] = MAC_ADDR_BYTE_1;
@@ -87,17 +389,13 @@ static err_t enc28_ip_init_callback(struct netif *n_if)
 	return ERR_OK;
 }
 
-void ip_stack_task(void *arg)
+/*
+ * Initializes lwIP and the ENC28J60 interface
+ * */
+void ip_stack_init(void)
 {
-	UBaseType_t stack_high_watermark = 0;
-	struct netif net_ifc;
 	struct ip4_addr my_addr;
 
-	struct pbuf *input_buf;
-	struct pbuf_custom pbuf_cst;
-
-	pbuf_cst.custom_free_function = enc28_pbuf_free;
-
 	my_addr.addr = ENC28_IP_ADDR;
 	net_ifc.name[0] = 'e';
 	net_ifc.name[1] = '1';
@@ -110,59 +408,115 @@ void ip_stack_task(void *arg)
 		netif_set_default(&net_ifc);
 		netif_set_up(&net_ifc);
 	}
+}
 
-	while (1)
+/*
+ * Passes a frame from the "ready" ring to the stack, NULL picks up the link status
+ * */
+void ip_stack_input(eth_rx_frame_t *ready_packet)
+{
+	if (!ready_packet)
 	{
-		struct eth_packet_buff_t * ready_packet = NULL;
-		BaseType_t status = xQueueReceive(ready_packet_buffer_queue, &ready_packet, portMAX_DELAY);
-
-		configASSERT(status == pdPASS);
-		configASSERT(ready_packet);
-
+		// link status change posted by the packet handling task
+		if (eth_link_up)
+		{
+			netif_set_link_up(&net_ifc);
+		}
+		else
 		{
+			netif_set_link_down(&net_ifc);
+		}
+	}
+	else
+	{
 #if USE_LWIP == 0
-			if (enc28_debug_is_ping_request(ready_packet->buf, ready_packet->used_bytes))
-			{
-				struct eth_packet_buff_t *ping_resp = NULL;
-				status = xQueueReceive(free_packet_buffer_queue, &ping_resp, 0);
-				if (status == pdPASS)
-				{
-					ping_resp->used_bytes = ready_packet->used_bytes;
-					int32_t resp_status = enc28_debug_handle_ping(ready_packet->buf,
-							ready_packet->used_bytes,
-							ping_resp->buf,
-							ping_resp->used_bytes);
-					if (resp_status == 0)
-					{
-						xQueueSend(transmit_packet_queue, &ping_resp, 0);
-					}
-					else
-					{
-						xQueueSend(free_packet_buffer_queue, &ping_resp, 0);
-					}
-				}
-			}
-			// put the packet back to the "free" queue
-			xQueueSend(free_packet_buffer_queue, &ready_packet, 0);
+		struct eth_tx_request_t request = {NULL, ready_packet, {0, 0, 0}, 0, ETH_STATS_TIMESTAMP()};
+		// the response is built in place, the packet handling task keeps the buffer after the transmission
+		if (!enc28_debug_is_ping_request(ready_packet->buf, ready_packet->used_bytes) ||
+				(enc28_debug_handle_ping(ready_packet->buf, ready_packet->used_bytes, ready_packet->buf, ready_packet->used_bytes) != 0) ||
+				!enc28_queue_tx_request(&request))
+		{
+			// put the packet back to the "free" ring
+			enc28_return_packet_buffer(ready_packet);
+		}
+#else
+		// push the ETH packet to the lwIP stack
+#if ETH_RX_PBUF_POOL
+		// received straight into a PBUF_POOL pbuf, lwIP returns it to the pool
+		struct pbuf *input_buf = ready_packet;
+		const uint32_t irq_time = ready_packet->enc28_irq_time;
+#else
+		// every packet buffer has its own descriptor, lwIP can keep several frames queued
+		ready_packet->pbuf.custom_free_function = enc28_pbuf_free;
+		struct pbuf *input_buf = pbuf_alloced_custom(PBUF_RAW,
+				ready_packet->used_bytes,
+				PBUF_REF,
+				&ready_packet->pbuf,
+				ready_packet->buf,
+				ready_packet->used_bytes);
+		configASSERT(input_buf);
+		// packet buffer is returned to "free" ring in enc28_pbuf_free function
+		input_buf->enc28_eth_packet_ptr = ready_packet;
+		const uint32_t irq_time = ready_packet->irq_time;
+#endif
+		eth_stats_record_latency(&eth_stats.rx_latency, ETH_STATS_TIMESTAMP() - irq_time);
+		LINK_STATS_INC(link.recv);
+		MIB2_STATS_NETIF_ADD(&net_ifc, ifinoctets, input_buf->tot_len);
+		if (((const uint8_t *)input_buf->payload)[0] & 0x1)
+		{
+			MIB2_STATS_NETIF_INC(&net_ifc, ifinnucastpkts);
+		}
+		else
+		{
+			MIB2_STATS_NETIF_INC(&net_ifc, ifinucastpkts);
+		}
+		{
+			err_t input_status = net_ifc.input(input_buf, &net_ifc);
+			configASSERT(input_status == ERR_OK);
+		}
+#endif
+	}
+}
+
+/*
+ * Runs the expired lwIP timers
+ * @return Time until the next timer expires
+ * */
+TickType_t ip_stack_poll(void)
+{
+	// also releases the TCP out-of-sequence queues if PBUF_POOL ran out
+	sys_check_timeouts();
+	enc28_sync_stats(&net_ifc);
+#if ETH_RX_PBUF_POOL
+	enc28_resume_rx();
 #else
-			// push the ETH packet to the lwIP stack
-			input_buf = pbuf_alloced_custom(PBUF_RAW,
-					ready_packet->used_bytes,
-					PBUF_REF,
-					&pbuf_cst,
-					ready_packet->buf,
-					ready_packet->used_bytes);
-			configASSERT(input_buf);
-			{
-				// packet buffer is returned to "free" queue in enc28_pbuf_free function
-				pbuf_cst.pbuf.enc28_eth_packet_ptr = ready_packet;
-				err_t input_status = net_ifc.input(input_buf, &net_ifc);
-				configASSERT(input_status == ERR_OK);
-			}
+	enc28_free_ooseq();
 #endif
+	return enc28_timeouts_sleep_ticks();
+}
+
+void ip_stack_task(void *arg)
+{
+	UBaseType_t stack_high_watermark = 0;
+	TickType_t sleep_ticks = 0;
+
+	ip_stack_init();
+
+	while (1)
+	{
+		eth_rx_frame_t * ready_packet = NULL;
+		if (!eth_ring_pop(&ready_packet_buffer_ring, &ready_packet))
+		{
+			// the packet handling task notifies only after the ring was drained,
+			// lwIP timers fire on schedule even if no frame arrives
+			ulTaskNotifyTake(pdTRUE, sleep_ticks);
+		}
+		else
+		{
+			ip_stack_input(ready_packet);
 		}
 
-		sys_check_timeouts();
+		sleep_ticks = ip_stack_poll();
 
 		stack_high_watermark = uxTaskGetStackHighWaterMark(NULL);
 		configASSERT(stack_high_watermark > 0); // stack exhausted !